@@ -9,24 +9,82 @@
 #define AEECLSID_CPOSDETAPP 0x00C5188D
 
 #define SPD_CONFIG_FILE             "config.txt"
-#define SPD_CONFIG_OPT_STRING       "GPS_OPTIMIZATION_MODE = "
-#define SPD_CONFIG_QOS_STRING       "GPS_QOS = "
-#define SPD_CONFIG_SVR_TYPE_STRING  "GPS_SERVER_TYPE = "
-#define SPD_CONFIG_SVR_IP_STRING    "GPS_SERVER_IP = "
-#define SPD_CONFIG_SVR_PORT_STRING  "GPS_SERVER_PORT = "
+#define SPD_CONFIG_OPT_STRING       "GPS_OPTIMIZATION_MODE"
+#define SPD_CONFIG_QOS_STRING       "GPS_QOS"
+#define SPD_CONFIG_SVR_TYPE_STRING  "GPS_SERVER_TYPE"
+#define SPD_CONFIG_SVR_IP_STRING    "GPS_SERVER_IP"
+#define SPD_CONFIG_SVR_PORT_STRING  "GPS_SERVER_PORT"
 #define SPD_QOS_DEFAULT       127
-#define SPD_CONFIG_UPLOAD_SVR_IP    "server-ip = "
-#define SPD_CONFIG_UPLOAD_SVR_PORT  "server-port = "
-#define SPD_CONFIG_CONNECT_MAX_TRY  "connect-max-try = "
-#define SPD_CONFIG_GET_GPS_INTERVAL "gps-interval = "
-#define SPD_CONFIG_GPS_MODE         "gps-mode = "
-#define SPD_CONFIG_LOCAL_PORT       "local-port = "
+#define SPD_CONFIG_UPLOAD_SVR_IP    "server-ip"
+#define SPD_CONFIG_UPLOAD_SVR_PORT  "server-port"
+#define SPD_CONFIG_CONNECT_MAX_TRY  "connect-max-try"
+#define SPD_CONFIG_GET_GPS_INTERVAL "gps-interval"
+#define SPD_CONFIG_GPS_MODE         "gps-mode"
+#define SPD_CONFIG_GPS_INTERVAL_MIN "gps-interval-min"
+#define SPD_CONFIG_GPS_INTERVAL_MAX "gps-interval-max"
+#define SPD_CONFIG_LOCAL_PORT       "local-port"
+#define SPD_CONFIG_BATCH_SIZE       "batch-size"
+#define SPD_CONFIG_BATCH_AGE        "batch-age"
+#define SPD_CONFIG_ENCODING         "report-encoding"
+#define SPD_CONFIG_KEY_INTERVAL     "keyframe-interval"
+#define SPD_CONFIG_SIMPLIFY_TOL     "simplify-tolerance"
+#define SPD_CONFIG_SIMPLIFY_GAP     "simplify-max-gap"
+#define SPD_CONFIG_LOG_FILES        "log-files"
+#define SPD_CONFIG_LOG_FILE_SIZE    "log-file-size"
+#define SPD_CONFIG_RECONN_BASE      "reconnect-base"
+#define SPD_CONFIG_RECONN_CAP       "reconnect-cap"
+#define SPD_CONFIG_RECONN_MULT      "reconnect-multiplier"
+#define SPD_CONFIG_RECONN_JITTER    "reconnect-jitter"
+#define SPD_CONFIG_ACK_TIMEOUT      "ack-timeout"
+#define SPD_CONFIG_SERVER_LIST      "server-list"
+#define SPD_CONFIG_CONNECT_TIMEOUT  "connect-timeout"
+#define SPD_CONFIG_PRIMARY_RETURN   "primary-return"
+#define SPD_CONFIG_TRANSPORT        "transport"
+#define SPD_CONFIG_UDP_MAX_LOST     "udp-max-lost"
+#define SPD_CONFIG_DORMANT_HOLD     "dormant-hold"
+#define SPD_CONFIG_STATS_INTERVAL   "stats-interval"
 
 #define GPSCBACK_INTERVAL     5    // seconds
 #define REPORT_STR_BUF_SIZE   256
-#define SOCK_BUF_SIZE         REPORT_STR_BUF_SIZE
+#define SOCK_BUF_SIZE         REPORT_STR_BUF_SIZE // max bytes of a report
+#define BATCH_MAX_REPORTS     8    // max reports sent in one write
+// a batch of framed reports, plus the hello frame opening a connection
+#define SEND_BUF_SIZE         ((SOCK_BUF_SIZE + 8) * (BATCH_MAX_REPORTS + 1))
+#define RX_BUF_SIZE           256  // bytes of frames from the server
+#define UDP_MAX_DATAGRAM      1400 // bytes, stay below the path MTU
+#define ACK_WINDOW            32   // reports sent but not acknowledged, max
 
-#define SPD_LOG_FILE    "log.txt"
+// Speed adaptive GPS interval, see PosDetApp_AdaptInterval()
+#define ADAPT_STOP_SPEED      100  // 0.01 m/s, slower is standing still
+#define ADAPT_FAST_SPEED      800  // 0.01 m/s, faster needs the min interval
+#define ADAPT_TURN_ANGLE      3000 // 0.01 degree, a turn needs the min interval
+#define ADAPT_SLOWER_FIXES    3    // fixes to confirm a slower band
+
+// GetGPSInfo timeout, retry delay and accuracy adapted to the fix latency,
+// see PosDetApp_AdaptRequest()
+#define GPSREQ_MIN_SAMPLES    4     // latencies needed before adapting
+#define GPSREQ_TIMEOUT_MIN    5000  // ms, on top of the tracking interval
+#define GPSREQ_TIMEOUT_MAX    60000 // ms
+#define GPSREQ_DELAY_MIN      1000  // ms, before retrying a failed request
+#define GPSREQ_DELAY_MAX      30000 // ms
+#define GPSREQ_ACC_MIN        AEEGPS_ACCURACY_LEVEL1
+#define GPSREQ_ACC_MAX        AEEGPS_ACCURACY_LEVEL6
+#define GPSREQ_ACC_UP_FIXES   5     // fixes in a row to try a finer level
+#define GPSREQ_ACC_DOWN_FAILS 2     // failures in a row to take a coarser one
+
+// log0.txt, log0.idx, log1.txt, ..., see PosDetLog.h
+#define SPD_LOG_NAME          "log"
+#define LOG_FLUSH_INTERVAL    30   // seconds
+
+// store-and-forward queue of reports not yet sent to the server
+#define SPD_QUEUE_FILE        "queue.dat"
+#define QUEUE_SLOT_SIZE       REPORT_STR_BUF_SIZE
+#define QUEUE_SLOT_COUNT      256
+
+// ring of the last events, written on stop or on the "trace" message,
+// see PosDetTrace.h
+#define SPD_TRACE_FILE        "trace.bin"
+#define SPD_TRACE_MSG         "trace"
 
 // Only for test
 #define TERMINAL_ID     "13800000000"
@@ -39,12 +97,30 @@
 // define port number and IP address of the server
 #define SERVER_PORT          1212
 #define SERVER_ADDR          "127.0.0.1"
-#define CONNECT_MAX_TRY      5
-#define CONNECT_SHORT_DELAY  1000 /* milliseconds */
-#define CONNECT_LONG_DELAY   3000 /* milliseconds */
-#define GETGPSINFO_ERR_DELAY 3000 /* milliseconds */
-#define GETGPSINFO_TIMEOUT   20000
+#define CONNECT_MAX_TRY      2    /* tries on a server before the next one */
+#define CONNECT_RETRY_DELAY  1000 /* milliseconds, between tries in a round */
+#define DEFAULT_CONNECT_TIMEOUT 10 /* seconds */
+#define DEFAULT_PRIMARY_RETURN 600 /* seconds, 0 stays on the backup */
+#define DEFAULT_TRANSPORT    TRANSPORT_TCP
+#define DEFAULT_UDP_MAX_LOST 3  /* ACK timeouts in a row before using TCP */
+#define DEFAULT_DORMANT_HOLD 300 /* seconds, 0 never waits for the radio */
+#define GETGPSINFO_ERR_DELAY 3000  /* milliseconds, until adapted */
+#define GETGPSINFO_TIMEOUT   20000 /* milliseconds, until adapted */
 #define DEFAULT_LOCAL_PORT   0
+#define DEFAULT_BATCH_SIZE   1  /* reports, 1 means no batching */
+#define DEFAULT_BATCH_AGE    60 /* seconds */
+#define DEFAULT_ENCODING     ENCODING_ASCII
+#define DEFAULT_KEY_INTERVAL 30 /* fixes between delta stream keyframes */
+#define DEFAULT_SIMPLIFY_TOL 0  /* metre, 0 reports every fix */
+#define DEFAULT_SIMPLIFY_GAP 120 /* seconds */
+#define DEFAULT_LOG_FILES    4
+#define DEFAULT_LOG_FILE_SIZE 64 /* KB */
+#define DEFAULT_RECONN_BASE  1000   /* milliseconds */
+#define DEFAULT_RECONN_CAP   300000 /* milliseconds */
+#define DEFAULT_RECONN_MULT  200    /* percent */
+#define DEFAULT_RECONN_JITTER 50    /* percent */
+#define DEFAULT_ACK_TIMEOUT  30 /* seconds, 0 if the server sends no ACK */
+#define DEFAULT_STATS_INTERVAL 900 /* seconds, 0 sends no stats frame */
 
 #define NO_USER_CONFIG       -1
 
@@ -55,6 +131,29 @@ enum {
     MULTIPLE_REQUESTS
 };
 
+typedef uint8 GPSBand;
+
+enum {
+    GPS_BAND_FAST,      // moving fast or turning, min interval
+    GPS_BAND_SLOW,      // moving slowly
+    GPS_BAND_STOPPED    // standing still, max interval
+};
+
+typedef uint8 ReportEncoding;
+
+enum {
+    ENCODING_ASCII,     // "{EHL,A,02,...,EHL}"
+    ENCODING_BINARY,    // PosDetCodec binary report
+    ENCODING_DELTA      // PosDetCodec keyframe and delta stream
+};
+
+typedef uint8 Transport;
+
+enum {
+    TRANSPORT_TCP,      // a stream of frames
+    TRANSPORT_UDP       // each datagram holds hello and whole frames
+};
+
 typedef struct _CSettings
 {
     AEEGPSServer server;
@@ -17,6 +17,16 @@
 
 #include "CPosDetApp.h"
 #include "RyanUtils.h"
+#include "PosDetQueue.h"
+#include "PosDetCodec.h"
+#include "PosDetSimplify.h"
+#include "PosDetLog.h"
+#include "PosDetBackoff.h"
+#include "PosDetServers.h"
+#include "PosDetLatency.h"
+#include "PosDetView.h"
+#include "PosDetStats.h"
+#include "PosDetTrace.h"
 #include "PosDetApp_res.h"
 
 typedef struct _PosDetApp {
@@ -24,7 +34,6 @@ typedef struct _PosDetApp {
     AEEDeviceInfo       deviceInfo;
     IPosDet            *pIPosDet;
     IFileMgr           *pIFileMgr;
-    IFile              *pLogFile;
     ISockPort          *pISockPort;
     INetwork           *pINetwork;
     AEECallback         cbTryBind;
@@ -33,24 +42,92 @@ typedef struct _PosDetApp {
     AEECallback         cbGetGPSInfo;
     AEECallback         cbReqInterval;
     AEECallback         cbReqTimeout;
+    AEECallback         cbDrain;
+    AEECallback         cbBatchAge;
+    AEECallback         cbLogFlush;
+    AEECallback         cbRead;
+    AEECallback         cbAckTimeout;
+    AEECallback         cbConnTimeout;
+    AEECallback         cbPrimary;
+    AEECallback         cbDormant;
     AEESockAddrStorage  localAddr;
-    AEESockAddrStorage  svrAddr;
+    AEESockAddrStorage  svrAddr;   // server-ip and server-port
+    PosDetServers       servers;   // servers to connect to, in order
+    uint16              nConnTimeout;   // seconds
+    uint16              nPrimaryReturn; // seconds on a backup server
+    Transport           transport;
+    uint8               nUdpMaxLost; // ACK timeouts in a row before TCP
+    uint8               nUdpLost;
     IPAddr             *pMyIPs;
     uint32              uBytesSent;
+    uint32              uSendLen;  // bytes in sendBuf to be written
+    uint16              nSendCnt;  // reports in sendBuf
+    uint32              dwNextSeq; // sequence number of the next report to send
+    uint16              nAckTimeout; // seconds, 0 if the server sends no ACK
+    byte                rxBuf[RX_BUF_SIZE]; // frames read from the server
+    uint16              nRxLen;    // bytes in rxBuf
+    uint16              nBatchSize; // reports to accumulate before a write
+    uint16              nBatchAge;  // seconds a report may wait for a batch
+    ReportEncoding      encoding;   // wire format of new reports
+    uint16              nKeyInterval; // fixes between delta keyframes
+    PosDetDeltaCtx      deltaCtx;   // delta stream state of the connection
     AEEGPSInfo          gpsInfo;
     AEEPositionInfoEx   posInfoEx;
+    PosDetFix           fix; // posInfoEx in fixed point
     CSettings           gpsSettings;
     AEEGPSMode          gpsModeCache;
     uint16              nIntervalCache;
+    uint16              nIntervalMin; // adaptive interval if < nIntervalMax
+    uint16              nIntervalMax;
+    uint16              nIntervalCur; // interval of the tracking session
+    GPSBand             gpsBand;
+    uint8               nSlowerCnt;   // fixes in a row asking for a slower band
+    uint16              wLastHeading; // 0.01 degree, valid if bLastHeading
+    boolean             bLastHeading;
     char                reportStr[REPORT_STR_BUF_SIZE];
+    uint16              nReportLen; // chars in reportStr
+    char                sendBuf[SEND_BUF_SIZE]; // the reports being sent
+    PosDetQueue         fixQueue; // reports waiting to be sent
+    PosDetLog           posLog;   // local log of the reports
+    uint8               nLogFiles;
+    uint16              nLogFileSize; // KB
+    int                 nConfigErrors; // unknown keys and bad values
+    boolean             bRemoteConfig; // parsing a config frame
+    PosDetSimplify      simplify; // drops fixes not needed to draw the track
+    uint16              nSimplifyTol; // metre
+    uint16              nSimplifyGap; // seconds
+    PosDetLatency       gpsLatency; // of the last GetGPSInfo requests
+    uint32              dwReqTime;  // uptime ms of the pending request
+    uint32              dwTrackStart; // uptime ms tracking started at
+    boolean             bTTFFDue;   // no fix since tracking started
+    uint32              dwConnStart; // uptime ms the connect try began at
+    uint32              dwWriteStart; // uptime ms the batch write began at
+    PosDetStats         stats;      // since the last stats frame
+    PosDetTrace         trace;
+    uint16              nStatsInterval; // seconds between stats frames
+    uint32              nReqTimeout;    // ms
+    uint32              nReqRetryDelay; // ms
+    AEEGPSAccuracy      gpsAccuracy;    // of the next request
+    uint8               nFixesInRow;
+    uint8               nFailsInRow;
     int                 gpsRespCnt;
     int                 gpsReqCnt; // to track how many GPS requests are sent
-    int                 tcpTryCnt;
-    int                 tcpConnMaxTry; // max times to try connecting to server
+    int                 tcpConnMaxTry; // tries on a server before the next
+    PosDetBackoff       reconnect; // delay before the next connect try
+    uint32              nReconnBase; // ms
+    uint32              nReconnCap;  // ms
+    uint16              nReconnMult; // percent
+    uint8               nReconnJitter; // percent
     boolean             bWaitingForResp;
     boolean             bConnected; // is connected to server
     boolean             bSending;
     boolean             bSendSucceeds;
+    boolean             bFlushDue; // send a partial batch
+    AEENetStatus        netStatus; // of the data session
+    uint16              nDormantHold; // seconds reports may wait for the radio
+    boolean             bWakeDue;  // waited nDormantHold, wake the radio
+    boolean             bHelloDue; // the connection has not sent hello yet
+    PosDetView          view;        // status screen
 } PosDetApp;
 
 /*-----------------------------------------------------------------------------
@@ -61,19 +138,17 @@ void PosDetApp_FreeAppData(PosDetApp *pMe);
 
 static boolean PosDetApp_HandleEvent(PosDetApp *pMe, AEEEvent eCode,
                                      uint16 wParam, uint32 dwParam);
-static boolean PosDetApp_Start(PosDetApp *pMe);
+static boolean PosDetApp_Start(PosDetApp *pMe, boolean bForeground);
 static void PosDetApp_Stop(PosDetApp *pMe);
 
 /*
  * utility functions
  */
-static uint32 PosDetApp_InitGPSSettings(PosDetApp *pMe);
-static uint32 PosDetApp_ReadGPSSettings(PosDetApp *pMe, IFile *pIFile);
 //static uint32 PosDetApp_WriteGPSSettings(PosDetApp *pMe, IFile *pIFile);
 //static uint32 PosDetApp_SaveGPSSettings(PosDetApp *pMe);
 static int PosDetApp_DecodePosInfo(PosDetApp *pMe);
-static void PosDetApp_MakeReportStr(PosDetApp *pMe);
-static boolean PosDetApp_StartTCPClient(PosDetApp *pMe);
+static void PosDetApp_MakeReportStr(PosDetApp *pMe, const PosDetFix *pFix);
+static boolean PosDetApp_StartClient(PosDetApp *pMe);
 static void PosDetApp_CBGetGPSInfo_SingleReq(void *pd);
 static void PosDetApp_CBGetGPSInfo_MultiReq(void *pd);
 static boolean PosDetApp_SingleRequest(PosDetApp *pMe);
@@ -81,26 +156,46 @@ static boolean PosDetApp_MultipleRequests(PosDetApp *pMe);
 static void PosDetApp_TryBind(void *po);
 static void PosDetApp_TryConnect(void *po);
 static void PosDetApp_TryWriteToSvr(void *po);
+static void PosDetApp_TryReadFromSvr(void *po);
+static boolean PosDetApp_ProcessRx(PosDetApp *pMe);
+static void PosDetApp_OnAck(PosDetApp *pMe, uint32 dwSeq);
+static void PosDetApp_OnAckTimeout(void *po);
+static void PosDetApp_ReleaseBefore(PosDetApp *pMe, uint32 dwSeq);
 static void PosDetApp_ProcessGPSData(PosDetApp *pMe);
 static boolean PosDetApp_RequestAFix(PosDetApp *pMe);
 static void PosDetApp_CnfgTrack(PosDetApp *pMe);
+static void PosDetApp_AdaptInterval(PosDetApp *pMe);
+static void PosDetApp_AdaptRequest(PosDetApp *pMe, boolean bFix,
+                                   uint32 nLatency);
+static uint32 PosDetApp_ReqTimeoutMin(const PosDetApp *pMe);
 static void PosDetApp_OnGetGpsInfoTimeout(void *po);
 static int PosDetApp_ReadUserConfig(PosDetApp *pMe);
 static void PosDetApp_ApplyDefaultConfig(PosDetApp *pMe);
+static void PosDetApp_ApplyRemoteConfig(PosDetApp *pMe, const byte *pText,
+                                        uint16 nLen);
+static void PosDetApp_ResetInterval(PosDetApp *pMe);
 static void PosDetApp_OnBadConn(PosDetApp *pMe);
 static void PosDetApp_OnNetEvtState(void *po, int evt);
 static void PosDetApp_OnNetEvtIP(void *po, int evt);
 static void PosDetApp_ProcessNetEvtState(PosDetApp *pMe);
 static void PosDetApp_ProcessNetEvtIP(PosDetApp *pMe);
 static void PosDetApp_ProcessBadConn(void *po);
-
-/*
- * test
- */
-static void PosDetApp_Printf(PosDetApp *pMe, int nLine, int nCol, AEEFont fnt,
-                             uint32 dwFlags, const char *szFormat, ...);
-static int PosDetApp_GetLogFile(PosDetApp *pMe);
-static void PosDetApp_LogPos(PosDetApp *pMe);
+static void PosDetApp_RetryConnect(PosDetApp *pMe);
+static void PosDetApp_CloseConn(PosDetApp *pMe);
+static void PosDetApp_OnConnTimeout(void *po);
+static void PosDetApp_OnPrimaryReturn(void *po);
+static void PosDetApp_EnqueueReport(PosDetApp *pMe, const PosDetFix *pFix);
+static void PosDetApp_ReportFix(PosDetApp *pMe, const PosDetFix *pFix);
+static uint16 PosDetApp_EncodeForWire(PosDetApp *pMe, byte *pRecord,
+                                      uint16 nLen);
+static void PosDetApp_DrainQueue(void *po);
+static void PosDetApp_OnBatchAge(void *po);
+static void PosDetApp_OnDormantHold(void *po);
+static boolean PosDetApp_IsDormant(PosDetApp *pMe);
+static void PosDetApp_ConnectNow(PosDetApp *pMe);
+
+static void PosDetApp_LogPos(PosDetApp *pMe, const PosDetFix *pFix);
+static void PosDetApp_OnLogFlush(void *po);
 static void PosDetApp_ShowGPSInfo(PosDetApp *pMe);
 
 
@@ -152,6 +247,8 @@ PosDetApp_InitAppData(PosDetApp * pMe)
     /* Get device info. */
     pMe->deviceInfo.wStructSize = sizeof(pMe->deviceInfo);
     ISHELL_GetDeviceInfo(pMe->applet.m_pIShell,&pMe->deviceInfo);
+    PosDetView_Init(&pMe->view, pMe->applet.m_pIDisplay,
+                    pMe->deviceInfo.cxScreen, pMe->deviceInfo.cyScreen);
 
     /* Create IPosDet. */
     err = ISHELL_CreateInstance(pMe->applet.m_pIShell, AEECLSID_POSDET,
@@ -169,12 +266,18 @@ PosDetApp_InitAppData(PosDetApp * pMe)
         return FALSE;
     }
 
-    /* Clear report string buffer. */
-    MEMSET(pMe->reportStr, 0, REPORT_STR_BUF_SIZE);
-
-    if (PosDetApp_InitGPSSettings(pMe) != SUCCESS) {
+    /* Open the queue of unsent reports, left over ones are kept. */
+    err = PosDetQueue_Open(&pMe->fixQueue, pMe->pIFileMgr, SPD_QUEUE_FILE,
+                           QUEUE_SLOT_SIZE, QUEUE_SLOT_COUNT);
+    if (SUCCESS != err) {
+        DBGPRINTF("Failed to open " SPD_QUEUE_FILE " err = %d", err);
         return FALSE;
     }
+    DBGPRINTF("Queued reports: %d", PosDetQueue_Count(&pMe->fixQueue));
+
+    /* Clear report string buffer. */
+    MEMSET(pMe->reportStr, 0, REPORT_STR_BUF_SIZE);
+    pMe->nReportLen = 0;
 
     /* Load default config */
     PosDetApp_ApplyDefaultConfig(pMe);
@@ -185,16 +288,41 @@ PosDetApp_InitAppData(PosDetApp * pMe)
         return FALSE;
     }
 
+    PosDetApp_ResetInterval(pMe);
+
+    /* server-list, or else server-ip and server-port. */
+    if (0 == pMe->servers.nServers) {
+        (void)PosDetServers_Add(&pMe->servers, &pMe->svrAddr);
+    }
+    pMe->servers.nMaxTry = (uint8)pMe->tcpConnMaxTry;
+
+    PosDetSimplify_Init(&pMe->simplify, pMe->nSimplifyTol, pMe->nSimplifyGap);
+
+    PosDetLatency_Init(&pMe->gpsLatency);
+    PosDetStats_Reset(&pMe->stats);
+    PosDetTrace_Init(&pMe->trace);
+    pMe->nReqTimeout = MAX(GETGPSINFO_TIMEOUT, PosDetApp_ReqTimeoutMin(pMe));
+    pMe->nReqRetryDelay = GETGPSINFO_ERR_DELAY;
+    pMe->gpsAccuracy = GPSREQ_ACC_MIN;
+    pMe->nFixesInRow = 0;
+    pMe->nFailsInRow = 0;
+
     pMe->bWaitingForResp = FALSE;
     pMe->bConnected = FALSE;
     pMe->uBytesSent = 0;
     pMe->bSending = FALSE;
     pMe->bSendSucceeds = FALSE;
-    pMe->tcpTryCnt = 0;
+    pMe->bFlushDue = FALSE;
+    pMe->uSendLen = 0;
+    pMe->nSendCnt = 0;
+    pMe->dwNextSeq = PosDetQueue_HeadSeq(&pMe->fixQueue);
+    pMe->nRxLen = 0;
+    PosDetBackoff_Init(&pMe->reconnect, pMe->nReconnBase, pMe->nReconnCap,
+                       pMe->nReconnMult, pMe->nReconnJitter);
     pMe->pMyIPs = NULL;
 
     /* Create ISockPort. */
-    if (!PosDetApp_StartTCPClient(pMe)) {
+    if (!PosDetApp_StartClient(pMe)) {
         return FALSE;
     }
 
@@ -206,13 +334,14 @@ PosDetApp_InitAppData(PosDetApp * pMe)
         return FALSE;
     }
 
-    /* test: Create log file. */
-    err = PosDetApp_GetLogFile(pMe);
+    /* test: Open log files. */
+    err = PosDetLog_Open(&pMe->posLog, pMe->pIFileMgr, SPD_LOG_NAME,
+                         pMe->nLogFiles, (uint32)pMe->nLogFileSize * 1024);
     if (err != SUCCESS) {
-        DBGPRINTF("Failed to create file " SPD_LOG_FILE " err = %d", err);
+        DBGPRINTF("Failed to open log " SPD_LOG_NAME " err = %d", err);
         return FALSE;
     }
-    (void)IFILE_Write(pMe->pLogFile, "\r\n", STRLEN("\r\n"));
+    CALLBACK_Init(&pMe->cbLogFlush, PosDetApp_OnLogFlush, pMe);
 
     return TRUE;
 }
@@ -220,8 +349,19 @@ PosDetApp_InitAppData(PosDetApp * pMe)
 void
 PosDetApp_FreeAppData(PosDetApp * pMe)
 {
+    PosDetFix fix;
+
+    /* The last fix seen may still wait for the simplifier, keep it so the
+     * track ends where the vehicle is. */
+    if (pMe->fixQueue.pFile && PosDetSimplify_Flush(&pMe->simplify, &fix)) {
+        PosDetApp_ReportFix(pMe, &fix);
+    }
+
+    CALLBACK_Cancel(&pMe->cbLogFlush);
+    PosDetLog_Close(&pMe->posLog);
+
     FREEIF(pMe->pMyIPs);
-    IQI_RELEASEIF(pMe->pLogFile);
+    PosDetQueue_Close(&pMe->fixQueue);
     IQI_RELEASEIF(pMe->pINetwork);
     IQI_RELEASEIF(pMe->pISockPort);
     IQI_RELEASEIF(pMe->pIFileMgr);
@@ -236,16 +376,17 @@ PosDetApp_HandleEvent(PosDetApp* pMe, AEEEvent eCode,
         // Event to inform app to start, so start-up code is here:
     case EVT_APP_START:
         DBGPRINTF("******** EVT_APP_START");
-        if (!PosDetApp_Start(pMe)) {
-            PosDetApp_Printf(pMe, 1, 2, AEE_FONT_BOLD,
-                             IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
-                             "Something goes wrong!");
+        if (!PosDetApp_Start(pMe, TRUE)) {
+            PosDetView_Printf(&pMe->view, 1, 2, AEE_FONT_BOLD,
+                              IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
+                              "Something goes wrong!");
+            PosDetView_Update(&pMe->view);
             ISHELL_CloseApplet(pMe->applet.m_pIShell, FALSE);
         }
         return TRUE;
     case EVT_APP_START_BACKGROUND:
         DBGPRINTF("******** EVT_APP_START_BACKGROUND");
-        if (!PosDetApp_Start(pMe)) {
+        if (!PosDetApp_Start(pMe, FALSE)) {
             DBGPRINTF("Something goes wrong!");
             ISHELL_CloseApplet(pMe->applet.m_pIShell, FALSE);
         }
@@ -259,10 +400,14 @@ PosDetApp_HandleEvent(PosDetApp* pMe, AEEEvent eCode,
 
         // Event to inform app to suspend, so suspend code is here:
     case EVT_APP_SUSPEND:
+        PosDetView_Show(&pMe->view, FALSE);
         return TRUE;
 
         // Event to inform app to resume, so resume code is here:
+        // also sent when the background app is brought to the foreground.
     case EVT_APP_RESUME:
+        PosDetView_Show(&pMe->view, TRUE);
+        PosDetApp_ShowGPSInfo(pMe);
         return TRUE;
 
     case EVT_NOTIFY:
@@ -282,6 +427,10 @@ PosDetApp_HandleEvent(PosDetApp* pMe, AEEEvent eCode,
         // sender simply uses this format "//BREW:ClassId:Message",
         // example //BREW:0x00000001:Hello World
     case EVT_APP_MESSAGE:
+        if (dwParam && STRCMP((const char*)dwParam, SPD_TRACE_MSG) == 0) {
+            (void)PosDetTrace_Dump(&pMe->trace, pMe->pIFileMgr,
+                                   SPD_TRACE_FILE);
+        }
         return TRUE;
 
         // A key was pressed:
@@ -306,11 +455,14 @@ PosDetApp_HandleEvent(PosDetApp* pMe, AEEEvent eCode,
     return FALSE; // Event wasn't handled.
 }
 
+/* Start tracking and reporting. In the background nothing is drawn at
+ * all, the status screen is shown once the app comes to the foreground. */
 static boolean
-PosDetApp_Start(PosDetApp *pMe)
+PosDetApp_Start(PosDetApp *pMe, boolean bForeground)
 {
     int err = 0;
-    IDISPLAY_ClearScreen(pMe->applet.m_pIDisplay);
+
+    PosDetView_Show(&pMe->view, bForeground);
 
     err = INetwork_OnEvent(pMe->pINetwork, NETWORK_EVENT_IP,
                            PosDetApp_OnNetEvtIP, pMe, TRUE);
@@ -325,8 +477,32 @@ PosDetApp_Start(PosDetApp *pMe)
         return FALSE;
     }
 
+    CALLBACK_Cancel(&pMe->cbDrain);
+    CALLBACK_Init(&pMe->cbDrain, PosDetApp_DrainQueue, pMe);
+    CALLBACK_Cancel(&pMe->cbBatchAge);
+    CALLBACK_Init(&pMe->cbBatchAge, PosDetApp_OnBatchAge, pMe);
+    CALLBACK_Cancel(&pMe->cbReqTimeout);
+    CALLBACK_Init(&pMe->cbReqTimeout, PosDetApp_OnGetGpsInfoTimeout, pMe);
+    CALLBACK_Cancel(&pMe->cbAckTimeout);
+    CALLBACK_Init(&pMe->cbAckTimeout, PosDetApp_OnAckTimeout, pMe);
+    CALLBACK_Cancel(&pMe->cbConnTimeout);
+    CALLBACK_Init(&pMe->cbConnTimeout, PosDetApp_OnConnTimeout, pMe);
+    CALLBACK_Cancel(&pMe->cbPrimary);
+    CALLBACK_Init(&pMe->cbPrimary, PosDetApp_OnPrimaryReturn, pMe);
+    CALLBACK_Cancel(&pMe->cbDormant);
+    CALLBACK_Init(&pMe->cbDormant, PosDetApp_OnDormantHold, pMe);
+
+    /* Positioning runs on its own, whatever the connection does. Fixes are
+     * queued and sent whenever the server can be reached. */
+    pMe->dwTrackStart = GETUPTIMEMS();
+    pMe->bTTFFDue = TRUE;
+    if (!PosDetApp_RequestAFix(pMe)) {
+        DBGPRINTF("Start GPS failed, retry later");
+    }
+
     /* Try to get My IPs, may fail, but never mind. */
     PosDetApp_ProcessNetEvtIP(pMe);
+    PosDetApp_ProcessNetEvtState(pMe);
 
     if (0 != pMe->localAddr.inet.port) {
         // If there is user defined local port, bind to it.
@@ -339,8 +515,6 @@ PosDetApp_Start(PosDetApp *pMe)
     else {
         CALLBACK_Cancel(&pMe->cbTryConn);
         CALLBACK_Init(&pMe->cbTryConn, PosDetApp_TryConnect, pMe);
-        CALLBACK_Cancel(&pMe->cbReqTimeout);
-        CALLBACK_Init(&pMe->cbReqTimeout, PosDetApp_OnGetGpsInfoTimeout, pMe);
         PosDetApp_TryConnect(pMe);
     }
 
@@ -356,125 +530,23 @@ PosDetApp_Stop(PosDetApp *pMe)
     CALLBACK_Cancel(&pMe->cbReqInterval);
     CALLBACK_Cancel(&pMe->cbGetGPSInfo);
     CALLBACK_Cancel(&pMe->cbTryBind);
+    CALLBACK_Cancel(&pMe->cbDrain);
+    CALLBACK_Cancel(&pMe->cbBatchAge);
+    CALLBACK_Cancel(&pMe->cbRead);
+    CALLBACK_Cancel(&pMe->cbAckTimeout);
+    CALLBACK_Cancel(&pMe->cbConnTimeout);
+    CALLBACK_Cancel(&pMe->cbPrimary);
+    CALLBACK_Cancel(&pMe->cbDormant);
+    CALLBACK_Cancel(&pMe->cbLogFlush);
+    (void)INetwork_OnEvent(pMe->pINetwork, NETWORK_EVENT_IP,
+                           PosDetApp_OnNetEvtIP, pMe, FALSE);
+    (void)INetwork_OnEvent(pMe->pINetwork, NETWORK_EVENT_STATE,
+                           PosDetApp_OnNetEvtState, pMe, FALSE);
+    (void)PosDetLog_Flush(&pMe->posLog);
+    (void)PosDetTrace_Dump(&pMe->trace, pMe->pIFileMgr, SPD_TRACE_FILE);
     (void)ISockPort_Close(pMe->pISockPort);
 }
 
-static uint32
-PosDetApp_InitGPSSettings(PosDetApp *pMe)
-{
-    IFile *pCnfgFile = NULL;
-    uint32 nResult = SUCCESS;
-
-    pMe->gpsSettings.reqType = MULTIPLE_REQUESTS;
-
-    // If the config file exists, open it and read the settings.
-    pCnfgFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_CONFIG_FILE, _OFM_READ);
-    if (NULL == pCnfgFile) {
-        nResult = EFAILED;
-        DBGPRINTF("Failed to Open File " SPD_CONFIG_FILE);
-        pCnfgFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_CONFIG_FILE,
-                                      _OFM_CREATE);
-        if (NULL == pCnfgFile) {
-            int err = IFILEMGR_GetLastError(pMe->pIFileMgr);
-            DBGPRINTF("Failed to Create File " SPD_CONFIG_FILE " err = %d",
-                      err);
-            nResult = EFAILED;
-        }
-        else {
-            pMe->gpsSettings.optim = AEEGPS_OPT_DEFAULT;
-            pMe->gpsSettings.qos = SPD_QOS_DEFAULT;
-            pMe->gpsSettings.server.svrType = AEEGPS_SERVER_DEFAULT;
-            //nResult = PosDetApp_WriteGPSSettings(pMe, pCnfgFile);
-        }
-    }
-    else {
-        nResult = PosDetApp_ReadGPSSettings(pMe, pCnfgFile);
-    }
-
-    // Free the IFileMgr and IFile instances
-    if (pCnfgFile) {
-        (void)IFILE_Release(pCnfgFile);
-    }
-
-    return nResult;
-}
-
-uint32
-PosDetApp_ReadGPSSettings(PosDetApp *pMe, IFile *pIFile)
-{
-    char *pBuf = NULL;
-    char *pszTok = NULL;
-    char *pszSvr = NULL;
-    char *pszDelimiter = ";";
-    int32 nResult = 0;
-    AEEFileInfo fileInfo;
-    int nRead = 0;
-
-    (void)IFILE_GetInfo(pIFile, &fileInfo);
-    // Allocate enough memory to read the full text into memory
-    pBuf = MALLOC(fileInfo.dwSize);
-    if (NULL == pBuf) {
-        return ENOMEMORY;
-    }
-
-    nRead = IFILE_Read(pIFile, (void*)pBuf, fileInfo.dwSize);
-    if ((uint32)nRead != fileInfo.dwSize) {
-        FREEIF(pBuf);
-        return EFAILED;
-    }
-
-    // Check for an optimization mode setting in the file:
-    pszTok = STRSTR(pBuf, SPD_CONFIG_OPT_STRING);
-    if (pszTok) {
-        pszTok = pszTok + STRLEN(SPD_CONFIG_OPT_STRING);
-        pMe->gpsSettings.optim = (AEEGPSOpt)STRTOUL(pszTok, &pszDelimiter, 10);
-    }
-
-    // Check for a QoS setting in the file:
-    pszTok = STRSTR(pBuf, SPD_CONFIG_QOS_STRING);
-    if (pszTok) {
-        pszTok = pszTok + STRLEN(SPD_CONFIG_QOS_STRING);
-        pMe->gpsSettings.qos = (AEEGPSQos)STRTOUL(pszTok, &pszDelimiter, 10);
-    }
-
-    // Check for a server type setting in the file:
-    pszTok = STRSTR(pBuf, SPD_CONFIG_SVR_TYPE_STRING);
-    if (pszTok) {
-        pszTok = pszTok + STRLEN(SPD_CONFIG_SVR_TYPE_STRING);
-        pMe->gpsSettings.server.svrType = STRTOUL(pszTok, &pszDelimiter, 10);
-
-        // If the server type is IP, we need to find the IP address and the
-        // port number
-        if (AEEGPS_SERVER_IP == pMe->gpsSettings.server.svrType) {
-            pszTok = STRSTR(pBuf, SPD_CONFIG_SVR_IP_STRING);
-            if (pszTok) {
-                pszTok = pszTok + STRLEN(SPD_CONFIG_SVR_IP_STRING);
-                nResult = DistToSemi(pszTok);
-                pszSvr = MALLOC(nResult+1);
-                STRLCPY(pszSvr, pszTok, nResult + 1);
-                if (!INET_PTON(AEE_AF_INET, pszSvr,
-                               &pMe->gpsSettings.server.svr.ipsvr.addr)) {
-                    FREE(pszSvr);
-                    FREEIF(pBuf);
-                    return EFAILED;
-                }
-                FREE(pszSvr);
-            }
-            pszTok = STRSTR(pBuf, SPD_CONFIG_SVR_PORT_STRING);
-            if (pszTok) {
-                INPort temp;
-                pszTok = pszTok + STRLEN(SPD_CONFIG_SVR_PORT_STRING);
-                temp = (INPort)STRTOUL(pszTok, &pszDelimiter, 10);
-                pMe->gpsSettings.server.svr.ipsvr.port = AEE_htons(temp);
-            }
-        }
-    }
-
-    FREEIF(pBuf);
-
-    return SUCCESS;
-}
-
 //uint32
 //PosDetApp_WriteGPSSettings(PosDetApp *pMe, IFile *pIFile)
 //{
@@ -595,18 +667,6 @@ PosDetApp_ReadGPSSettings(PosDetApp *pMe, IFile *pIFile)
 //    return nResult;
 //}
 
-static void
-PosDetApp_Printf(PosDetApp *pMe, int nLine, int nCol, AEEFont fnt,
-                 uint32 dwFlags, const char *szFormat, ...)
-{
-    char szBuf[64];
-    va_list args;
-    va_start(args, szFormat);
-    VSNPRINTF(szBuf, 64, szFormat, args);
-    va_end(args);
-    xDisplay((AEEApplet*)pMe, nLine, nCol, fnt, dwFlags, szBuf);
-}
-
 static void
 PosDetApp_CnfgTrack(PosDetApp *pMe)
 {
@@ -622,7 +682,7 @@ PosDetApp_CnfgTrack(PosDetApp *pMe)
 
     gpsConfig.mode = pMe->gpsModeCache;
     gpsConfig.nFixes = 0;
-    gpsConfig.nInterval = pMe->nIntervalCache;
+    gpsConfig.nInterval = pMe->nIntervalCur;
     gpsConfig.optim = AEEGPS_OPT_SPEED;
     gpsConfig.qos = pMe->gpsSettings.qos;
     gpsConfig.server.svrType = AEEGPS_SERVER_DEFAULT;
@@ -632,6 +692,158 @@ PosDetApp_CnfgTrack(PosDetApp *pMe)
     if (err != SUCCESS) {
         DBGPRINTF("PosDetApp: Configuration could not be set! err = %d", err);
     }
+
+    /* A longer interval is answered later, don't wait for the latencies
+     * to tell. */
+    pMe->nReqTimeout = MAX(pMe->nReqTimeout, PosDetApp_ReqTimeoutMin(pMe));
+}
+
+/* Start tracking at the configured interval, or the min one if it is
+ * adaptive, until the next fixes tell how the vehicle moves. */
+static void
+PosDetApp_ResetInterval(PosDetApp *pMe)
+{
+    if (pMe->nIntervalMin > 0 && pMe->nIntervalMin < pMe->nIntervalMax) {
+        pMe->nIntervalCur = pMe->nIntervalMin;
+    }
+    else {
+        pMe->nIntervalMin = 0;
+        pMe->nIntervalMax = 0;
+        pMe->nIntervalCur = pMe->nIntervalCache;
+    }
+    pMe->gpsBand = GPS_BAND_FAST;
+    pMe->nSlowerCnt = 0;
+    pMe->bLastHeading = FALSE;
+}
+
+/* Pick the GPS interval from how the vehicle moves, so that a parked
+ * vehicle is sampled every nIntervalMax seconds and one on a curve every
+ * nIntervalMin seconds. The tracking session is only reconfigured when the
+ * band changes. A faster band is taken at once, a slower one only after
+ * ADAPT_SLOWER_FIXES fixes in a row, so a short stop at lights does not
+ * flap the configuration. */
+static void
+PosDetApp_AdaptInterval(PosDetApp *pMe)
+{
+    GPSBand band = GPS_BAND_SLOW;
+    int32 dHeading = 0;
+    uint16 nInterval = 0;
+
+    if (pMe->nIntervalMin >= pMe->nIntervalMax) {
+        return;
+    }
+
+    if (!(pMe->fix.flags & PDC_HAS_SPEED)) {
+        /* Nothing known about the motion, sample as often as allowed. */
+        band = GPS_BAND_FAST;
+    }
+    else if (pMe->fix.wSpeed < ADAPT_STOP_SPEED) {
+        band = GPS_BAND_STOPPED;
+    }
+    else if (pMe->fix.wSpeed >= ADAPT_FAST_SPEED) {
+        band = GPS_BAND_FAST;
+    }
+
+    /* Heading is noise when standing still. */
+    if (band != GPS_BAND_STOPPED && (pMe->fix.flags & PDC_HAS_HEADING)) {
+        if (pMe->bLastHeading) {
+            dHeading = (int32)pMe->fix.wHeading - (int32)pMe->wLastHeading;
+            if (dHeading < 0) {
+                dHeading = -dHeading;
+            }
+            if (dHeading > 18000) {
+                dHeading = 36000 - dHeading;
+            }
+            if (dHeading >= ADAPT_TURN_ANGLE) {
+                band = GPS_BAND_FAST;
+            }
+        }
+        pMe->wLastHeading = pMe->fix.wHeading;
+        pMe->bLastHeading = TRUE;
+    }
+
+    if (band == pMe->gpsBand) {
+        pMe->nSlowerCnt = 0;
+        return;
+    }
+    if (band > pMe->gpsBand && ++pMe->nSlowerCnt < ADAPT_SLOWER_FIXES) {
+        return;
+    }
+    pMe->nSlowerCnt = 0;
+    pMe->gpsBand = band;
+
+    if (GPS_BAND_FAST == band) {
+        nInterval = pMe->nIntervalMin;
+    }
+    else if (GPS_BAND_STOPPED == band) {
+        nInterval = pMe->nIntervalMax;
+    }
+    else {
+        nInterval = (uint16)((3 * pMe->nIntervalMin + pMe->nIntervalMax) / 4);
+    }
+
+    if (nInterval != pMe->nIntervalCur) {
+        DBGPRINTF("GPS band %d, interval %d s", band, nInterval);
+        pMe->nIntervalCur = nInterval;
+        PosDetApp_CnfgTrack(pMe);
+    }
+}
+
+/* Shortest timeout of a request, the tracking interval and some. It wins
+ * over GPSREQ_TIMEOUT_MAX, a fix can't come before it is due. */
+static uint32
+PosDetApp_ReqTimeoutMin(const PosDetApp *pMe)
+{
+    return (uint32)pMe->nIntervalCur * 1000 + GPSREQ_TIMEOUT_MIN;
+}
+
+/* Learn from how a GetGPSInfo request ended, after nLatency ms, with a fix
+ * if bFix.
+ *
+ * The timeout is half as long again as the 90th percentile of the recent
+ * latencies, a timed out request counting as its timeout, so it grows back
+ * when fixes get slow. A failed request is retried after the median
+ * latency. The accuracy level goes one finer after GPSREQ_ACC_UP_FIXES
+ * fixes in a row and one coarser after GPSREQ_ACC_DOWN_FAILS failures. */
+static void
+PosDetApp_AdaptRequest(PosDetApp *pMe, boolean bFix, uint32 nLatency)
+{
+    uint32 n = 0;
+
+    PosDetLatency_Add(&pMe->gpsLatency, nLatency);
+
+    if (bFix) {
+        pMe->nFailsInRow = 0;
+        if (++pMe->nFixesInRow >= GPSREQ_ACC_UP_FIXES) {
+            pMe->nFixesInRow = 0;
+            if (pMe->gpsAccuracy < GPSREQ_ACC_MAX) {
+                pMe->gpsAccuracy++;
+            }
+        }
+    }
+    else {
+        pMe->nFixesInRow = 0;
+        if (++pMe->nFailsInRow >= GPSREQ_ACC_DOWN_FAILS) {
+            pMe->nFailsInRow = 0;
+            if (pMe->gpsAccuracy > GPSREQ_ACC_MIN) {
+                pMe->gpsAccuracy--;
+            }
+        }
+    }
+
+    if (pMe->gpsLatency.nCount < GPSREQ_MIN_SAMPLES) {
+        return;
+    }
+
+    n = PosDetLatency_Percentile(&pMe->gpsLatency, 90);
+    pMe->nReqTimeout = MAX(MIN(n + n / 2, GPSREQ_TIMEOUT_MAX),
+                           PosDetApp_ReqTimeoutMin(pMe));
+
+    n = PosDetLatency_Percentile(&pMe->gpsLatency, 50);
+    pMe->nReqRetryDelay = MIN(MAX(n, GPSREQ_DELAY_MIN), GPSREQ_DELAY_MAX);
+
+    PDT_DEBUG(&pMe->trace, PDT_EV_GPS_ADAPT, pMe->nReqTimeout,
+              PDT_SPLIT(pMe->nReqRetryDelay, pMe->gpsAccuracy));
 }
 
 static void
@@ -642,11 +854,13 @@ PosDetApp_CBGetGPSInfo_SingleReq(void *pd)
         PosDetApp_ProcessGPSData(pMe);
     }
     else {
+        PosDetStats_GPSError(&pMe->stats, pMe->gpsInfo.status);
         DBGPRINTF("GetGPSInfo err = 0x%x",
                   pMe->gpsInfo.status);
-        PosDetApp_Printf(pMe, 1, 2, AEE_FONT_BOLD, IDF_ALIGN_CENTER,
-                         "GetGPSInfo err=0x%x",
-                         pMe->gpsInfo.status);
+        PosDetView_Printf(&pMe->view, 1, 2, AEE_FONT_BOLD, IDF_ALIGN_CENTER,
+                          "GetGPSInfo err=0x%x",
+                          pMe->gpsInfo.status);
+        PosDetView_Update(&pMe->view);
     }
 }
 
@@ -654,7 +868,9 @@ static void
 PosDetApp_CBGetGPSInfo_MultiReq(void *pd)
 {
     PosDetApp *pMe = (PosDetApp*)pd;
+    uint32 nLatency = GETUPTIMEMS() - pMe->dwReqTime;
     pMe->gpsRespCnt++;
+    PosDetStats_Sample(&pMe->stats, PDST_HIST_FIX, nLatency);
 
     pMe->bWaitingForResp = FALSE;
     CALLBACK_Cancel(&pMe->cbReqTimeout);
@@ -663,17 +879,25 @@ PosDetApp_CBGetGPSInfo_MultiReq(void *pd)
         || (pMe->gpsInfo.status == AEEGPS_ERR_INFO_UNAVAIL
             && pMe->gpsInfo.fValid)) {
 
+        PosDetApp_AdaptRequest(pMe, TRUE, nLatency);
         PosDetApp_ProcessGPSData(pMe);
 
         /* Initiate next request for GPS fix. */
         ISHELL_SetTimerEx(pMe->applet.m_pIShell, 0, &pMe->cbReqInterval);
     }
     else {
-        DBGPRINTF("GetGPSInfo err = 0x%x", pMe->gpsInfo.status);
-        PosDetApp_Printf(pMe, 1, 2, AEE_FONT_BOLD, IDF_ALIGN_CENTER,
-                         "GetGPSInfo err=0x%x", pMe->gpsInfo.status);
+        PosDetStats_GPSError(&pMe->stats, pMe->gpsInfo.status);
+        PDT_ERROR(&pMe->trace, PDT_EV_GPS_ERR, pMe->gpsInfo.status, nLatency);
+        PosDetView_Printf(&pMe->view, 1, 2, AEE_FONT_BOLD, IDF_ALIGN_CENTER,
+                          "GetGPSInfo err=0x%x", pMe->gpsInfo.status);
+        PosDetView_Update(&pMe->view);
+        /* The level asked for can't be had now, don't insist. */
+        if (AEEGPS_ERR_ACCURACY_UNAVAIL == pMe->gpsInfo.status) {
+            pMe->nFailsInRow = GPSREQ_ACC_DOWN_FAILS - 1;
+        }
+        PosDetApp_AdaptRequest(pMe, FALSE, nLatency);
         /* Delay and retry get GPS fix. */
-        ISHELL_SetTimerEx(pMe->applet.m_pIShell, GETGPSINFO_ERR_DELAY,
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, (int32)pMe->nReqRetryDelay,
                           &pMe->cbReqInterval);
     }
 }
@@ -710,29 +934,35 @@ PosDetApp_MultipleRequests(PosDetApp *pMe)
     ret = IPOSDET_GetGPSInfo(pMe->pIPosDet,
                              AEEGPS_GETINFO_LOCATION | AEEGPS_GETINFO_ALTITUDE
                              | AEEGPS_GETINFO_VELOCITY,
-                             AEEGPS_ACCURACY_LEVEL1,
+                             pMe->gpsAccuracy,
                              &pMe->gpsInfo, &pMe->cbGetGPSInfo);
     if (SUCCESS == ret) {
         /* continue */
         pMe->bWaitingForResp = TRUE;
+        pMe->dwReqTime = GETUPTIMEMS();
     }
     else if (EUNSUPPORTED == ret) {
-        DBGPRINTF("PosDetApp: GetGPSInfo request isn't supported.");
+        PDT_ERROR(&pMe->trace, PDT_EV_GPS_REQ_FAIL, ret, 0);
         return FALSE;
     }
     else {
-        DBGPRINTF("PosDetApp: GetGPSInfo failed: err = %d", ret);
+        PDT_ERROR(&pMe->trace, PDT_EV_GPS_REQ_FAIL, ret, 0);
+        /* Delay and retry, the tracking must not stop for good. */
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, (int32)pMe->nReqRetryDelay,
+                          &pMe->cbReqInterval);
         return FALSE;
     }
 
     pMe->gpsReqCnt++;
-    DBGPRINTF("req : %d", pMe->gpsReqCnt);
-    PosDetApp_Printf(pMe, 0, 2, AEE_FONT_BOLD,
-                     IDF_ALIGN_LEFT | IDF_RECT_FILL,
-                     "req : %d", pMe->gpsReqCnt);
+    PosDetStats_Count(&pMe->stats, PDST_CTR_GPS_REQS, 1);
+    PDT_DEBUG(&pMe->trace, PDT_EV_GPS_REQ, pMe->gpsReqCnt, pMe->gpsAccuracy);
+    PosDetView_Printf(&pMe->view, 0, 2, AEE_FONT_BOLD,
+                      IDF_ALIGN_LEFT | IDF_RECT_FILL,
+                      "req : %d", pMe->gpsReqCnt);
+    PosDetView_Update(&pMe->view);
 
     /* Set timer watching out of time out */
-    ISHELL_SetTimerEx(pMe->applet.m_pIShell, GETGPSINFO_TIMEOUT,
+    ISHELL_SetTimerEx(pMe->applet.m_pIShell, (int32)pMe->nReqTimeout,
                       &pMe->cbReqTimeout);
 
     return TRUE;
@@ -745,60 +975,75 @@ PosDetApp_ShowGPSInfo(PosDetApp *pMe)
     JulianType jd;
 
 #define MAXTEXTLEN   22
-    AECHAR wcText[MAXTEXTLEN];
     char szStr[MAXTEXTLEN];
+    StrWriter w;
+
+    if (!pMe->view.bShown) {
+        return;
+    }
 
-    IDISPLAY_ClearScreen(pMe->applet.m_pIDisplay);
+    PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_BOLD,
+                     IDF_ALIGN_LEFT, "req : %d", pMe->gpsReqCnt);
 
-    PosDetApp_Printf(pMe, line++, 2, AEE_FONT_BOLD, IDF_ALIGN_LEFT,
-                     "req : %d", pMe->gpsReqCnt);
+    PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_BOLD,
+                     IDF_ALIGN_LEFT, "resp : %d, acc %d", pMe->gpsRespCnt,
+                     pMe->gpsAccuracy);
 
-    PosDetApp_Printf(pMe, line++, 2, AEE_FONT_BOLD, IDF_ALIGN_LEFT,
-                     "resp : %d", pMe->gpsRespCnt);
+    if (pMe->bConnected) {
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "conn : up %d, queued %d",
+                         pMe->servers.nCur, PosDetQueue_Count(&pMe->fixQueue));
+    }
+    else {
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "conn : retry %d, %d s",
+                         pMe->reconnect.nFailures, pMe->reconnect.nLast / 1000);
+    }
 
     GETJULIANDATE(pMe->gpsInfo.dwTimeStamp, &jd);
-    PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                     "Time = %02d-%02d-%02d %02d:%02d:%02d GMT+8", jd.wYear,
-                     jd.wMonth, jd.wDay, jd.wHour + 8, jd.wMinute, jd.wSecond);
-    if (pMe->posInfoEx.fLatitude) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Latitude, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szStr, MAXTEXTLEN);
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "Latitude = %s d", szStr);
-    }
-    if (pMe->posInfoEx.fLongitude) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Longitude, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szStr, MAXTEXTLEN);
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "Longitude = %s d", szStr);
+    PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                     IDF_ALIGN_LEFT, "Time = %02d-%02d-%02d %02d:%02d:%02d GMT+8",
+                     jd.wYear, jd.wMonth, jd.wDay, jd.wHour + 8, jd.wMinute,
+                     jd.wSecond);
+    if (pMe->fix.flags & PDC_HAS_POS) {
+        StrWriter_Init(&w, szStr, MAXTEXTLEN);
+        StrWriter_Fixed(&w, pMe->fix.nLat, 7);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "Latitude = %s d", szStr);
+
+        StrWriter_Init(&w, szStr, MAXTEXTLEN);
+        StrWriter_Fixed(&w, pMe->fix.nLon, 7);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "Longitude = %s d", szStr);
     }
     if (pMe->posInfoEx.fAltitude) {
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "Altitude = %d m", pMe->posInfoEx.nAltitude);
-    }
-    if (pMe->posInfoEx.fHeading) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Heading, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szStr, MAXTEXTLEN);
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "Heading = %s d", szStr);
-    }
-    if (pMe->posInfoEx.fHorVelocity) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.HorVelocity, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szStr, MAXTEXTLEN);
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "HorVelocity = %s m/s", szStr);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "Altitude = %d m",
+                         pMe->posInfoEx.nAltitude);
+    }
+    if (pMe->fix.flags & PDC_HAS_HEADING) {
+        StrWriter_Init(&w, szStr, MAXTEXTLEN);
+        StrWriter_Fixed(&w, pMe->fix.wHeading, 2);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "Heading = %s d", szStr);
+    }
+    if (pMe->fix.flags & PDC_HAS_SPEED) {
+        StrWriter_Init(&w, szStr, MAXTEXTLEN);
+        StrWriter_Fixed(&w, pMe->fix.wSpeed, 2);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "HorVelocity = %s m/s", szStr);
     }
     if (pMe->posInfoEx.fVerVelocity) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.VerVelocity, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szStr, MAXTEXTLEN);
-        PosDetApp_Printf(pMe, line++, 2, AEE_FONT_NORMAL, IDF_ALIGN_LEFT,
-                         "VerVelocity = %s m/s", szStr);
+        StrWriter_Init(&w, szStr, MAXTEXTLEN);
+        StrWriter_Fixed(&w, PosDetCodec_ToFixed(pMe->posInfoEx.VerVelocity,
+                                                100.0), 2);
+        PosDetView_Printf(&pMe->view, line++, 2, AEE_FONT_NORMAL,
+                         IDF_ALIGN_LEFT, "VerVelocity = %s m/s", szStr);
     }
+
+    /* Blank the fields not known any more, draw what changed. */
+    PosDetView_ClearFrom(&pMe->view, line);
+    PosDetView_Update(&pMe->view);
 }
 
 /************************************
@@ -824,203 +1069,114 @@ PosDetApp_DecodePosInfo(PosDetApp *pMe)
 }
 
 /* After this function, pMe->reportStr contains the whole piece of GPS data
- * to be reported to the server.*/
+ * of pFix to be reported to the server, and pMe->nReportLen its length. */
 void
-PosDetApp_MakeReportStr(PosDetApp *pMe)
+PosDetApp_MakeReportStr(PosDetApp *pMe, const PosDetFix *pFix)
 {
-    /* Fill the string buffer part by part, each part from the temp string. */
-
-    char *pTmp = pMe->reportStr;         /* points to the temp buffer */
-    int tmpBufSize = REPORT_STR_BUF_SIZE; /* size of temp buffer at pTmp */
-#define MAXTEXTLEN 22
-    AECHAR wcText[MAXTEXTLEN];  /* used to hold the float number string */
-    char szTmpStr[MAXTEXTLEN];  /* snprintf this temp string to tmp buffer */
-    int tmpStrLen = 0;          /* string length in bytes of the temp string */
+    StrWriter w;
     JulianType jd;
-    char szIP[AEE_INET_ADDRSTRLEN];
 
-    /* Clear the report string buffer */
-    MEMSET(pMe->reportStr, 0, REPORT_STR_BUF_SIZE);
+    StrWriter_Init(&w, pMe->reportStr, REPORT_STR_BUF_SIZE);
 
     /* local IP if any, only show the first IP */
-    if (pMe->pMyIPs
-        && INET_NTOP(AEE_AF_INET, &pMe->pMyIPs->addr.v4, szIP,
-                     AEE_INET_ADDRSTRLEN)) {
-        SNPRINTF(pTmp, tmpBufSize, "%s", szIP);
-
-        /* temp buffer head moves forward */
-        tmpStrLen = STRLEN(pTmp);
-        pTmp += tmpStrLen;
-        tmpBufSize -= tmpStrLen;
+    if (pMe->pMyIPs) {
+        StrWriter_IPv4(&w, &pMe->pMyIPs->addr.v4);
     }
 
     /* local port if any */
     if (pMe->localAddr.inet.port != 0) {
-        SNPRINTF(pTmp, tmpBufSize, ":%d ", NTOHS(pMe->localAddr.inet.port));
-
-        /* temp buffer head moves forward */
-        tmpStrLen = STRLEN(pTmp);
-        pTmp += tmpStrLen;
-        tmpBufSize -= tmpStrLen;
+        StrWriter_Char(&w, ':');
+        StrWriter_UInt(&w, NTOHS(pMe->localAddr.inet.port), 1);
+        StrWriter_Char(&w, ' ');
     }
 
     /* message_header + terminal_id + time */
-    GETJULIANDATE(pMe->gpsInfo.dwTimeStamp, &jd);
-    SNPRINTF(pTmp, tmpBufSize,
-             "{EHL,A,02,%s,%02d-%02d-%02d %02d:%02d:%02d,",
-             TERMINAL_ID,
-             jd.wYear, jd.wMonth, jd.wDay, jd.wHour + 8, jd.wMinute,
-             jd.wSecond);
-
-    /* temp buffer head moves forward */
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
-
-    /* latitude */
-    if (pMe->posInfoEx.fLatitude) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Latitude, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szTmpStr, MAXTEXTLEN);
-    }
-    /* If no valid latitude value, the following code sprintf only "," */
-    SNPRINTF(pTmp, tmpBufSize, "%s,", szTmpStr);
-    /* Clear temp text buffers */
-    MEMSET(wcText, 0, MAXTEXTLEN * sizeof(AECHAR));
-    MEMSET(szTmpStr, 0, MAXTEXTLEN);
-
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
-
-    /* longitude */
-    if (pMe->posInfoEx.fLongitude) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Longitude, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szTmpStr, MAXTEXTLEN);
-    }
-    SNPRINTF(pTmp, tmpBufSize, "%s,", szTmpStr);
-    MEMSET(wcText, 0, MAXTEXTLEN * sizeof(AECHAR));
-    MEMSET(szTmpStr, 0, MAXTEXTLEN);
-
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
+    GETJULIANDATE(pFix->dwTime - PDC_GPS_TO_UNIX_SECS, &jd);
+    StrWriter_Str(&w, "{EHL,A,02," TERMINAL_ID ",");
+    StrWriter_UInt(&w, jd.wYear, 2);
+    StrWriter_Char(&w, '-');
+    StrWriter_UInt(&w, jd.wMonth, 2);
+    StrWriter_Char(&w, '-');
+    StrWriter_UInt(&w, jd.wDay, 2);
+    StrWriter_Char(&w, ' ');
+    StrWriter_UInt(&w, jd.wHour + 8, 2);
+    StrWriter_Char(&w, ':');
+    StrWriter_UInt(&w, jd.wMinute, 2);
+    StrWriter_Char(&w, ':');
+    StrWriter_UInt(&w, jd.wSecond, 2);
+    StrWriter_Char(&w, ',');
+
+    /* latitude, longitude. If no valid value, only "," is written. */
+    if (pFix->flags & PDC_HAS_POS) {
+        StrWriter_Fixed(&w, pFix->nLat, 7);
+    }
+    StrWriter_Char(&w, ',');
+    if (pFix->flags & PDC_HAS_POS) {
+        StrWriter_Fixed(&w, pFix->nLon, 7);
+    }
+    StrWriter_Char(&w, ',');
 
     /* altitude */
-    if (pMe->posInfoEx.fAltitude) {
-        SNPRINTF(pTmp, tmpBufSize, "%d,", pMe->posInfoEx.nAltitude);
-    }
-    else {
-        SNPRINTF(pTmp, tmpBufSize, ",");
+    if (pFix->flags & PDC_HAS_ALT) {
+        StrWriter_Int(&w, pFix->nAlt);
     }
-
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
+    StrWriter_Char(&w, ',');
 
     /* velocity */
-    if (pMe->posInfoEx.fHorVelocity) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.HorVelocity, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szTmpStr, MAXTEXTLEN);
+    if (pFix->flags & PDC_HAS_SPEED) {
+        StrWriter_Fixed(&w, pFix->wSpeed, 2);
     }
-    SNPRINTF(pTmp, tmpStrLen, "%s,", szTmpStr);
-    MEMSET(wcText, 0, MAXTEXTLEN * sizeof(AECHAR));
-    MEMSET(szTmpStr, 0, MAXTEXTLEN);
-
-    /* TODO */
-/*
-    if (pMe->posInfoEx.fVerVelocity) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.VerVelocity, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szTmpStr, MAXTEXTLEN);
-        SNPRINTF(pTmp, tmpBufSize, "%s,", szTmpStr)
-    }
-    MEMSET(wcText, 0, MAXTEXTLEN * sizeof(AECHAR));
-    MEMSET(szTmpStr, 0, MAXTEXTLEN);
-
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
-*/
+    StrWriter_Char(&w, ',');
 
     /* heading */
-    if (pMe->posInfoEx.fHeading) {
-        (void)FLOATTOWSTR(pMe->posInfoEx.Heading, wcText,
-                          MAXTEXTLEN * sizeof(AECHAR));
-        WSTR_TO_STR(wcText, szTmpStr, MAXTEXTLEN);
+    if (pFix->flags & PDC_HAS_HEADING) {
+        StrWriter_Fixed(&w, pFix->wHeading, 2);
     }
-    SNPRINTF(pTmp, tmpBufSize, "%s,", szTmpStr);
-    MEMSET(wcText, 0, MAXTEXTLEN * sizeof(AECHAR));
-    MEMSET(szTmpStr, 0, MAXTEXTLEN);
-
-    tmpStrLen = STRLEN(pTmp);
-    pTmp += tmpStrLen;
-    tmpBufSize -= tmpStrLen;
+    StrWriter_Char(&w, ',');
 
     /* mileage + terminal_status + terminal_alarm + satellite_num +
        policeman_id + message_tail */
-    SNPRINTF(pTmp, tmpBufSize, "%s,%s,%s,%s,%s,EHL}",
-             MILEAGE, TERMINAL_STATUS, TERMINAL_ALARM, SATELLITE_NUM,
-             POLICEMAN_ID);
+    StrWriter_Str(&w, MILEAGE "," TERMINAL_STATUS "," TERMINAL_ALARM ","
+                  SATELLITE_NUM "," POLICEMAN_ID ",EHL}");
+
+    pMe->nReportLen = (uint16)w.nLen;
 }
 
-/* If create log file successfully, return SUCCESS, otherwise return fail
- * code. */
-static int
-PosDetApp_GetLogFile(PosDetApp *pMe)
+/* Log the report just made for pFix. The log is written to flash every
+ * LOG_FLUSH_INTERVAL seconds, or sooner when its buffer is full. */
+static void
+PosDetApp_LogPos(PosDetApp *pMe, const PosDetFix *pFix)
 {
     int err = 0;
 
-    if (IFILEMGR_Test(pMe->pIFileMgr, SPD_LOG_FILE) != SUCCESS) {
-        pMe->pLogFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_LOG_FILE,
-                                          _OFM_CREATE);
-        if (NULL == pMe->pLogFile) {
-            err = IFILEMGR_GetLastError(pMe->pIFileMgr);
-            return err;
-        }
+    err = PosDetLog_Write(&pMe->posLog, pFix->dwTime, pMe->reportStr,
+                          pMe->nReportLen);
+    if (SUCCESS != err) {
+        DBGPRINTF("Write log file failed: err = %d", err);
+        PosDetStats_Count(&pMe->stats, PDST_CTR_LOG_ERRORS, 1);
     }
 
-    /* The file has existed. */
-    if (NULL == pMe->pLogFile) {
-        pMe->pLogFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_LOG_FILE,
-                                          _OFM_APPEND);
-        if (NULL == pMe->pLogFile) {
-            err = IFILEMGR_GetLastError(pMe->pIFileMgr);
-            return err;
-        }
+    if (!CALLBACK_IsQueued(&pMe->cbLogFlush)) {
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, LOG_FLUSH_INTERVAL * 1000,
+                          &pMe->cbLogFlush);
     }
-
-    return SUCCESS;
 }
 
 static void
-PosDetApp_LogPos(PosDetApp *pMe)
+PosDetApp_OnLogFlush(void *po)
 {
-#define NEWLINE "\r\n"
-
+    PosDetApp *pMe = (PosDetApp*)po;
     int err = 0;
-    uint32 wroteBytes;
 
-    wroteBytes = IFILE_Write(pMe->pLogFile, pMe->reportStr,
-                             STRLEN(pMe->reportStr));
-    if (0 == wroteBytes) {
-        err = IFILEMGR_GetLastError(pMe->pIFileMgr);
-        DBGPRINTF("Write log file failed: err = %d", err);
-        return;
-    }
-
-    /* Write the Newline character */
-    wroteBytes = IFILE_Write(pMe->pLogFile, NEWLINE, STRLEN(NEWLINE));
-    if (wroteBytes != STRLEN(NEWLINE)) {
-        err = IFILEMGR_GetLastError(pMe->pIFileMgr);
+    err = PosDetLog_Flush(&pMe->posLog);
+    if (SUCCESS != err) {
         DBGPRINTF("Write log file failed: err = %d", err);
+        PosDetStats_Count(&pMe->stats, PDST_CTR_LOG_ERRORS, 1);
     }
 }
 
 static boolean
-PosDetApp_StartTCPClient(PosDetApp *pMe)
+PosDetApp_StartClient(PosDetApp *pMe)
 {
     int ret = 0;
 
@@ -1035,7 +1191,8 @@ PosDetApp_StartTCPClient(PosDetApp *pMe)
     // Open the SockPort.
     ret = ISockPort_OpenEx(pMe->pISockPort,      // ISockPort pointer
         AEE_AF_INET,                             // wFamily     = IPv4
-        AEE_SOCKPORT_STREAM,                     // socket type = TCP
+        TRANSPORT_UDP == pMe->transport ?        // socket type
+            AEE_SOCKPORT_DGRAM : AEE_SOCKPORT_STREAM,
         0                                        // Protocol type:
                                 // Use 0 (recommended) to let the system
                                 // select its default
@@ -1056,74 +1213,104 @@ PosDetApp_TryConnect(void *po)
     int ret;
     PosDetApp *pMe = (PosDetApp*)po;
 
-    if (pMe->tcpTryCnt >= pMe->tcpConnMaxTry) {
-        DBGPRINTF("Cannot connect to server after %d tries.",
-                  pMe->tcpTryCnt);
-        DBGPRINTF("Delay longer and retry...");
-        pMe->tcpTryCnt = 0;
-        ISHELL_SetTimerEx(pMe->applet.m_pIShell, CONNECT_LONG_DELAY,
-                          &pMe->cbTryConn);
-        return;
+    /* The connect timeout runs from the first try on, until connected. */
+    if (!CALLBACK_IsQueued(&pMe->cbConnTimeout)) {
+        pMe->dwConnStart = GETUPTIMEMS();
     }
 
     /* Connect to the distant server. */
-    ret = ISockPort_Connect(pMe->pISockPort, &pMe->svrAddr);
-    pMe->tcpTryCnt++;
+    ret = ISockPort_Connect(pMe->pISockPort,
+                            PosDetServers_Current(&pMe->servers));
 
     if (AEEPORT_WAIT == ret) {
-        DBGPRINTF("SockPort wait");
+        PDT_DEBUG(&pMe->trace, PDT_EV_CONN_WAIT, pMe->servers.nCur, 0);
         ISockPort_Writeable(pMe->pISockPort, &pMe->cbTryConn);
         pMe->bConnected = FALSE;
+        /* A server that is down may leave the connect unanswered for
+         * minutes, move on to the next one well before. */
+        if (!CALLBACK_IsQueued(&pMe->cbConnTimeout)) {
+            ISHELL_SetTimerEx(pMe->applet.m_pIShell,
+                              pMe->nConnTimeout * 1000, &pMe->cbConnTimeout);
+        }
         return;
     }
     else if (AEE_NET_ETIMEDOUT == ret) {
-        PosDetApp_Printf(pMe, 0, 2, AEE_FONT_BOLD,
-                         IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
-                         "SockPort timed out! %d Tries.", pMe->tcpTryCnt);
-        DBGPRINTF("SockPort timed out! %d tries.", pMe->tcpTryCnt);
+        PosDetView_Printf(&pMe->view, 0, 2, AEE_FONT_BOLD,
+                          IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
+                          "SockPort timed out! Server %d.",
+                          pMe->servers.nCur);
+        PosDetView_Update(&pMe->view);
+        PDT_ERROR(&pMe->trace, PDT_EV_CONN_TIMEDOUT, pMe->servers.nCur, 0);
         PosDetApp_OnBadConn(pMe);
         return;
     }
     else if (AEE_NET_ECONNREFUSED == ret) {
-        PosDetApp_Printf(pMe, 0, 2, AEE_FONT_BOLD,
-                         IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
-                         "SockPort conn refused! %d tries.", pMe->tcpTryCnt);
-        DBGPRINTF("SockPort conn refused! %d tries.", pMe->tcpTryCnt);
+        PosDetView_Printf(&pMe->view, 0, 2, AEE_FONT_BOLD,
+                          IDF_ALIGN_CENTER | IDF_ALIGN_MIDDLE,
+                          "SockPort conn refused! Server %d.",
+                          pMe->servers.nCur);
+        PosDetView_Update(&pMe->view);
+        PDT_ERROR(&pMe->trace, PDT_EV_CONN_REFUSED, pMe->servers.nCur, 0);
         PosDetApp_OnBadConn(pMe);
         return;
     }
     else if (AEE_NET_EISCONN == ret) {
-        DBGPRINTF("Socket is already connected.");
-        pMe->bConnected = TRUE;
-        return;
+        /* The connect finished while we waited, set it up as below. */
+        PDT_INFO(&pMe->trace, PDT_EV_CONN_ISCONN, pMe->servers.nCur, 0);
     }
     else if (AEE_NET_EBADF == ret || AEE_NET_EAFNOSUPPORT == ret
              || AEE_NET_EOPNOTSUPP == ret || AEE_NET_ENOMEM == ret) {
 
-        DBGPRINTF("SockPort connect err = 0x%x. Close applet.", ret);
+        PDT_ERROR(&pMe->trace, PDT_EV_CONN_FATAL, ret, pMe->servers.nCur);
         ISHELL_CloseApplet(pMe->applet.m_pIShell, FALSE);
     }
     else if (AEE_NET_EINPROGRESS == ret) {
         /* TODO */
-        DBGPRINTF("SockPort connect in progress.");
+        PDT_DEBUG(&pMe->trace, PDT_EV_CONN_INPROGRESS, pMe->servers.nCur, 0);
         pMe->bConnected = FALSE;
         return;
     }
     else if (AEE_SUCCESS != ret) {
         /* For other errors, delay and retry. */
         pMe->bConnected = FALSE;
-        DBGPRINTF("SockPort connect err=0x%x, delay & retry...", ret);
-        ISHELL_SetTimerEx(pMe->applet.m_pIShell, CONNECT_SHORT_DELAY,
-                          &pMe->cbTryConn);
+        PDT_ERROR(&pMe->trace, PDT_EV_CONN_ERR, ret, pMe->servers.nCur);
+        PosDetApp_RetryConnect(pMe);
         return;
     }
 
-    /* (AEE_SUCCESS == ret), the SockPort is connected */
+    /* (AEE_SUCCESS == ret || AEE_NET_EISCONN == ret), the SockPort is
+     * connected */
     pMe->bConnected = TRUE;
-    pMe->tcpTryCnt = 0;
-
-    /* Start a request for GPS fix. */
-    (void)PosDetApp_RequestAFix(pMe);
+    CALLBACK_Cancel(&pMe->cbConnTimeout);
+    PosDetStats_Count(&pMe->stats, PDST_CTR_CONNECTS, 1);
+    PosDetStats_Sample(&pMe->stats, PDST_HIST_CONNECT,
+                       GETUPTIMEMS() - pMe->dwConnStart);
+    PosDetServers_Connected(&pMe->servers);
+    PosDetBackoff_Reset(&pMe->reconnect);
+    PDT_INFO(&pMe->trace, PDT_EV_CONNECTED, pMe->servers.nCur,
+             GETUPTIMEMS() - pMe->dwConnStart);
+
+    /* A backup server only stands in until the primary is back. */
+    if (pMe->servers.nCur != 0 && pMe->nPrimaryReturn > 0) {
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, pMe->nPrimaryReturn * 1000,
+                          &pMe->cbPrimary);
+    }
+
+    /* A new connection starts with hello and a new delta stream. Reports
+     * not acknowledged on the old one are sent again, under the same
+     * sequence numbers. */
+    pMe->bHelloDue = TRUE;
+    PosDetCodec_ResetDelta(&pMe->deltaCtx, pMe->nKeyInterval);
+    pMe->dwNextSeq = PosDetQueue_HeadSeq(&pMe->fixQueue);
+    pMe->nUdpLost = 0;
+
+    /* Listen for ACKs. */
+    pMe->nRxLen = 0;
+    CALLBACK_Cancel(&pMe->cbRead);
+    PosDetApp_TryReadFromSvr(pMe);
+
+    /* Send what was queued while disconnected. */
+    PosDetApp_DrainQueue(pMe);
 }
 
 static void
@@ -1134,8 +1321,8 @@ PosDetApp_TryWriteToSvr(void *po)
 
     // write the data to the server.
     ret = ISockPort_Write(pMe->pISockPort, // ISockPort object
-                          pMe->reportStr + pMe->uBytesSent, // buffer to write
-                          SOCK_BUF_SIZE - pMe->uBytesSent);  // buffer length
+                          pMe->sendBuf + pMe->uBytesSent, // buffer to write
+                          pMe->uSendLen - pMe->uBytesSent);  // buffer length
 
     // the system can't write data at the moment.
     if (AEEPORT_WAIT == ret) {
@@ -1147,57 +1334,517 @@ PosDetApp_TryWriteToSvr(void *po)
     // an error occurred. get the error code.
     if (AEEPORT_ERROR == ret) {
         ret = ISockPort_GetLastError(pMe->pISockPort);
-        DBGPRINTF("SockPort write err = %d", ret);
+        PDT_ERROR(&pMe->trace, PDT_EV_SOCK_WRITE_ERR, ret, pMe->uBytesSent);
+        // The reports stay queued and are sent again in whole frames,
+        // starting with a keyframe as the server may have missed deltas.
+        pMe->bSending = FALSE;
+        PosDetCodec_ResetDelta(&pMe->deltaCtx, pMe->nKeyInterval);
         // Connection was reset.
         if (AEE_NET_ECONNRESET == ret) {
-            DBGPRINTF("Connection reset!");
             // On broken connection, try re-connect.
             PosDetApp_OnBadConn(pMe);
         }
+        else if (pMe->uBytesSent > 0) {
+            // The server got part of a frame, the stream can't be resumed.
+            PosDetApp_OnBadConn(pMe);
+        }
+        pMe->uBytesSent = 0;
         return;
     }
 
     // connection closed by the other side
     if (AEEPORT_CLOSED == ret) {
-        DBGPRINTF("Server closed the connection!");
+        PDT_ERROR(&pMe->trace, PDT_EV_SOCK_CLOSED, pMe->servers.nCur, 0);
         // On broken connection, try re-connect.
         PosDetApp_OnBadConn(pMe);
         return;
     }
 
-    // some bytes were written.
-    pMe->uBytesSent += ret;
+    // some bytes were written, a datagram is sent whole or not at all.
+    PosDetStats_Count(&pMe->stats, PDST_CTR_BYTES_SENT, (uint32)ret);
+    if (TRANSPORT_UDP == pMe->transport) {
+        pMe->uBytesSent = pMe->uSendLen;
+    }
+    else {
+        pMe->uBytesSent += ret;
+    }
 
     // Not all the bytes were written yet. Call PosDetApp_TryWriteToSvr() again
     // when the write operation may progress.
-    if (pMe->uBytesSent < SOCK_BUF_SIZE) {
+    if (pMe->uBytesSent < pMe->uSendLen) {
         ISockPort_WriteableEx(pMe->pISockPort, &pMe->cbSendTo,
                               PosDetApp_TryWriteToSvr, pMe);
         return;
     }
 
-    // (SOCK_BUF_SIZE == pMe->uBytesSent) - all the bytes were successfully
+    // (uSendLen == pMe->uBytesSent) - all the bytes were successfully
     // written reset the bytes counter for next write operation
     pMe->uBytesSent = 0;
     pMe->bSendSucceeds = TRUE;
+    pMe->bSending = FALSE;
+    PosDetStats_Count(&pMe->stats, PDST_CTR_REPORTS_SENT, pMe->nSendCnt);
+    PosDetStats_Sample(&pMe->stats, PDST_HIST_WRITE,
+                       GETUPTIMEMS() - pMe->dwWriteStart);
+
+    // The reports are on their way. They are released once the server
+    // acknowledges them, or now if it sends no ACK. Go on with the rest.
+    pMe->dwNextSeq += pMe->nSendCnt;
+    if (0 == pMe->nAckTimeout) {
+        PosDetApp_ReleaseBefore(pMe, pMe->dwNextSeq);
+    }
+    else if (!CALLBACK_IsQueued(&pMe->cbAckTimeout)) {
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, pMe->nAckTimeout * 1000,
+                          &pMe->cbAckTimeout);
+    }
+    ISHELL_Resume(pMe->applet.m_pIShell, &pMe->cbDrain);
+}
+
+/* Read what the server sent, until the socket would block. */
+static void
+PosDetApp_TryReadFromSvr(void *po)
+{
+    int ret = 0;
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    for (;;) {
+        ret = ISockPort_Read(pMe->pISockPort, pMe->rxBuf + pMe->nRxLen,
+                             RX_BUF_SIZE - pMe->nRxLen);
+
+        if (AEEPORT_WAIT == ret) {
+            ISockPort_ReadableEx(pMe->pISockPort, &pMe->cbRead,
+                                 PosDetApp_TryReadFromSvr, pMe);
+            return;
+        }
+        if (AEEPORT_ERROR == ret) {
+            PDT_ERROR(&pMe->trace, PDT_EV_SOCK_READ_ERR,
+                      ISockPort_GetLastError(pMe->pISockPort), 0);
+            PosDetApp_OnBadConn(pMe);
+            return;
+        }
+        if (AEEPORT_CLOSED == ret) {
+            PDT_ERROR(&pMe->trace, PDT_EV_SOCK_CLOSED, pMe->servers.nCur,
+                      0);
+            PosDetApp_OnBadConn(pMe);
+            return;
+        }
+
+        pMe->nRxLen = (uint16)(pMe->nRxLen + ret);
+        if (!PosDetApp_ProcessRx(pMe)) {
+            PosDetApp_OnBadConn(pMe);
+            return;
+        }
+        if (TRANSPORT_UDP == pMe->transport) {
+            pMe->nRxLen = 0; // a frame never spans datagrams
+        }
+    }
+}
+
+/* Handle the complete frames in rxBuf and keep the rest for the next read.
+ * Returns FALSE if the server sent a frame that can never fit in rxBuf. */
+static boolean
+PosDetApp_ProcessRx(PosDetApp *pMe)
+{
+    const byte *pPayload = NULL;
+    uint16 nPayload = 0;
+    uint16 nUsed = 0;
+    uint32 dwSeq = 0;
+    byte type = 0;
+    int n = 0;
+
+    while ((n = PosDetCodec_ParseFrame(pMe->rxBuf + nUsed,
+                                       pMe->nRxLen - nUsed, &type,
+                                       &pPayload, &nPayload)) > 0) {
+        if (PDC_FRAME_ACK == type
+            && PosDetCodec_DecodeAck(pPayload, nPayload, &dwSeq) == SUCCESS) {
+            PosDetApp_OnAck(pMe, dwSeq);
+        }
+        else if (PDC_FRAME_CONFIG == type) {
+            PosDetApp_ApplyRemoteConfig(pMe, pPayload, nPayload);
+        }
+        else {
+            DBGPRINTF("Skip frame type %d from server", type);
+        }
+        nUsed = (uint16)(nUsed + n);
+    }
+
+    pMe->nRxLen = (uint16)(pMe->nRxLen - nUsed);
+    MEMMOVE(pMe->rxBuf, pMe->rxBuf + nUsed, pMe->nRxLen);
+
+    if (RX_BUF_SIZE == pMe->nRxLen) {
+        DBGPRINTF("Frame from server too long");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* The server stored every report up to and including dwSeq. */
+static void
+PosDetApp_OnAck(PosDetApp *pMe, uint32 dwSeq)
+{
+    uint32 dwHead = PosDetQueue_HeadSeq(&pMe->fixQueue);
+
+    /* A report not sent on this connection can't be acknowledged. */
+    if ((int32)(dwSeq - pMe->dwNextSeq) >= 0) {
+        DBGPRINTF("ACK %d of an unsent report", dwSeq);
+        return;
+    }
+    if ((int32)(dwSeq - dwHead) < 0) {
+        return; // already released
+    }
+
+    PosDetApp_ReleaseBefore(pMe, dwSeq + 1);
+    pMe->nUdpLost = 0;
+
+    /* The server is making progress, give the rest a new timeout. */
+    CALLBACK_Cancel(&pMe->cbAckTimeout);
+    if (pMe->nAckTimeout > 0
+        && PosDetQueue_HeadSeq(&pMe->fixQueue) != pMe->dwNextSeq) {
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, pMe->nAckTimeout * 1000,
+                          &pMe->cbAckTimeout);
+    }
+
+    /* The window may have room again. */
+    ISHELL_Resume(pMe->applet.m_pIShell, &pMe->cbDrain);
+}
+
+/* Sent reports were not acknowledged in time, the connection is assumed
+ * dead. They are sent again after reconnecting. */
+static void
+PosDetApp_OnAckTimeout(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    PDT_ERROR(&pMe->trace, PDT_EV_ACK_TIMEOUT,
+              pMe->dwNextSeq - PosDetQueue_HeadSeq(&pMe->fixQueue),
+              pMe->nUdpLost);
+
+    /* Over UDP a lost datagram is only sent again, until too many are
+     * lost in a row and the server is better reached over TCP. */
+    if (TRANSPORT_UDP == pMe->transport
+        && ++pMe->nUdpLost < pMe->nUdpMaxLost) {
+        if (!pMe->bSending) {
+            pMe->dwNextSeq = PosDetQueue_HeadSeq(&pMe->fixQueue);
+            ISHELL_Resume(pMe->applet.m_pIShell, &pMe->cbDrain);
+        }
+        ISHELL_SetTimerEx(pMe->applet.m_pIShell, pMe->nAckTimeout * 1000,
+                          &pMe->cbAckTimeout);
+        return;
+    }
+    if (TRANSPORT_UDP == pMe->transport) {
+        PDT_INFO(&pMe->trace, PDT_EV_UDP_FALLBACK, pMe->nUdpLost, 0);
+        pMe->transport = TRANSPORT_TCP;
+    }
+    PosDetApp_OnBadConn(pMe);
+}
+
+/* Release the queued reports with a sequence number before dwSeq. */
+static void
+PosDetApp_ReleaseBefore(PosDetApp *pMe, uint32 dwSeq)
+{
+    uint32 n = dwSeq - PosDetQueue_HeadSeq(&pMe->fixQueue);
+
+    /* Reports may have been dropped meanwhile by a full queue. */
+    if ((int32)n > 0) {
+        (void)PosDetQueue_Pop(&pMe->fixQueue,
+                              MIN(n, PosDetQueue_Count(&pMe->fixQueue)));
+    }
+}
+
+/* Store the report of pFix just made, it is sent when the connection
+ * allows. */
+static void
+PosDetApp_EnqueueReport(PosDetApp *pMe, const PosDetFix *pFix)
+{
+    int err = 0;
+    byte binBuf[PDC_BINARY_SIZE];
+
+    /* Delta encoding depends on what the connection has sent, so the fix
+     * is queued as a binary report and turned into a delta when sent. */
+    if (ENCODING_BINARY == pMe->encoding || ENCODING_DELTA == pMe->encoding) {
+        err = PosDetQueue_Push(&pMe->fixQueue, binBuf,
+                               (uint16)PosDetCodec_EncodeBinary(pFix,
+                                   binBuf, sizeof(binBuf)));
+    }
+    else {
+        err = PosDetQueue_Push(&pMe->fixQueue, pMe->reportStr,
+                               pMe->nReportLen);
+    }
+    if (SUCCESS != err) {
+        DBGPRINTF("Enqueue report failed: err = %d", err);
+        PosDetStats_Count(&pMe->stats, PDST_CTR_QUEUE_FULL, 1);
+        return;
+    }
+    PosDetStats_Sample(&pMe->stats, PDST_HIST_QUEUE,
+                       PosDetQueue_Count(&pMe->fixQueue));
+}
+
+/* Turn the queued record of nLen bytes at pRecord into the report sent,
+ * in place, and return its length. There must be room for SOCK_BUF_SIZE
+ * bytes.
+ *
+ * In delta mode a binary report becomes a keyframe or a delta, any other
+ * record is sent as it was queued. */
+static uint16
+PosDetApp_EncodeForWire(PosDetApp *pMe, byte *pRecord, uint16 nLen)
+{
+    PosDetFix fix;
+    int n = 0;
+
+    if (ENCODING_DELTA == pMe->encoding && nLen > 0
+        && PDC_MAGIC_BINARY == pRecord[0]
+        && PosDetCodec_DecodeBinary(pRecord, nLen, &fix) == SUCCESS) {
+        n = PosDetCodec_EncodeDelta(&pMe->deltaCtx, &fix, TERMINAL_ID,
+                                    pRecord, SOCK_BUF_SIZE);
+        if (n > 0) {
+            nLen = (uint16)n;
+        }
+    }
+    return nLen;
+}
+
+/* Start sending the oldest queued reports not sent yet, if connected and
+ * idle.
+ *
+ * Reports are sent in batches of nBatchSize in a single write, so that the
+ * radio wakes up once per batch instead of once per fix. A partial batch
+ * is sent once the oldest report has waited nBatchAge seconds. The reports
+ * of a batch share one batch frame, a lone report goes in a report frame.
+ *
+ * Sent reports stay queued until acknowledged, at most ACK_WINDOW of them,
+ * so a server that stopped answering does not get the whole queue.
+ *
+ * While the data session is dormant, reports wait up to nDormantHold
+ * seconds for something else to wake the radio; they all go in one burst
+ * once it is open again.
+ *
+ * Every nStatsInterval seconds a stats frame goes along with the next
+ * batch, it never makes a write of its own. */
+static void
+PosDetApp_DrainQueue(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+    uint32 dwHead = 0;
+    uint32 nInFlight = 0;
+    uint32 nUnsent = 0;
+    uint32 nToSend = 0;
+    uint32 uSendLen = 0;
+    uint32 uMaxLen = SEND_BUF_SIZE;
+    uint32 uFrame = 0;
+    byte *pFrame = NULL;
+    byte *pRecord = NULL;
+    uint16 nLen = 0;
+    uint16 i = 0;
+    int nStatsLen = 0;
+    int err = 0;
+
+    if (!pMe->bConnected || pMe->bSending) {
+        return;
+    }
+
+    /* A datagram may be lost or come out of order, so each one is read on
+     * its own: it starts with hello, and delta reports with a keyframe. */
+    if (TRANSPORT_UDP == pMe->transport) {
+        uMaxLen = UDP_MAX_DATAGRAM;
+    }
+
+    /* A full queue may have dropped reports that were sent. */
+    dwHead = PosDetQueue_HeadSeq(&pMe->fixQueue);
+    if ((int32)(pMe->dwNextSeq - dwHead) < 0) {
+        pMe->dwNextSeq = dwHead;
+    }
+    nInFlight = pMe->dwNextSeq - dwHead;
+    nUnsent = PosDetQueue_Count(&pMe->fixQueue) - nInFlight;
+    if (0 == nUnsent) {
+        /* Everything was sent, the next report starts a new batch. */
+        pMe->bFlushDue = FALSE;
+        pMe->bWakeDue = FALSE;
+        CALLBACK_Cancel(&pMe->cbBatchAge);
+        CALLBACK_Cancel(&pMe->cbDormant);
+        return;
+    }
+
+    if (nUnsent < pMe->nBatchSize && !pMe->bFlushDue) {
+        /* Wait for more reports, but not longer than nBatchAge. */
+        if (!CALLBACK_IsQueued(&pMe->cbBatchAge)) {
+            ISHELL_SetTimerEx(pMe->applet.m_pIShell,
+                              pMe->nBatchAge * 1000, &pMe->cbBatchAge);
+        }
+        return;
+    }
+
+    if (PosDetApp_IsDormant(pMe) && !pMe->bWakeDue) {
+        if (!CALLBACK_IsQueued(&pMe->cbDormant)) {
+            ISHELL_SetTimerEx(pMe->applet.m_pIShell,
+                              pMe->nDormantHold * 1000, &pMe->cbDormant);
+        }
+        return; // PosDetApp_OnNetEvtState() resumes
+    }
+
+    nToSend = MIN(nUnsent, pMe->nBatchSize);
+    if (pMe->nAckTimeout > 0) {
+        if (nInFlight >= ACK_WINDOW) {
+            return; // PosDetApp_OnAck() resumes
+        }
+        nToSend = MIN(nToSend, ACK_WINDOW - nInFlight);
+    }
+
+    uSendLen = 0;
+    if (TRANSPORT_UDP == pMe->transport) {
+        pMe->bHelloDue = TRUE;
+        PosDetCodec_ResetDelta(&pMe->deltaCtx, pMe->nKeyInterval);
+    }
+    if (pMe->bHelloDue) {
+        uSendLen = (uint32)PosDetCodec_EncodeHello(TERMINAL_ID,
+                                                   (byte*)pMe->sendBuf,
+                                                   SEND_BUF_SIZE);
+    }
+    nStatsLen = 0;
+    if (pMe->nStatsInterval > 0
+        && GETUPTIMEMS() - pMe->stats.dwStart
+           >= pMe->nStatsInterval * 1000UL) {
+        /* Leave room for a report at least. */
+        nStatsLen = PosDetStats_EncodeFrame(&pMe->stats,
+                        (byte*)pMe->sendBuf + uSendLen,
+                        (int)(uMaxLen - uSendLen)
+                        - (PDC_REPORT_HDR_SIZE + PDC_BATCH_LEN_MAX
+                           + SOCK_BUF_SIZE));
+        uSendLen += (uint32)nStatsLen;
+    }
+
+    /* The frame header goes in front once the reports are in place,
+     * each report is read in after a byte for its length. */
+    uFrame = uSendLen;
+    uSendLen += PDC_REPORT_HDR_SIZE;
+    for (i = 0; i < nToSend; i++) {
+        if (uSendLen + PDC_BATCH_LEN_MAX + SOCK_BUF_SIZE > uMaxLen) {
+            break;
+        }
+        pRecord = (byte*)pMe->sendBuf + uSendLen + 1;
+        err = PosDetQueue_Peek(&pMe->fixQueue, nInFlight + i, pRecord,
+                               SOCK_BUF_SIZE, &nLen);
+        if (SUCCESS != err) {
+            /* Its sequence number still goes out, as a report of no
+             * bytes, so the server can acknowledge past it. */
+            DBGPRINTF("Queued report %d unreadable: err = %d",
+                      pMe->dwNextSeq + i, err);
+            nLen = 0;
+        }
+        nLen = PosDetApp_EncodeForWire(pMe, pRecord, nLen);
+        if (nLen >= 0x80) {
+            MEMMOVE(pRecord + 1, pRecord, nLen);
+        }
+        uSendLen += (uint32)PosDetCodec_PutBatchLen(pRecord - 1, nLen)
+            + nLen;
+    }
+
+    if (0 == i) {
+        return; // no room for a report, the stats frame leaves some
+    }
+
+    pFrame = (byte*)pMe->sendBuf + uFrame;
+    if (1 == i) {
+        /* A lone report needs no length, its frame has it. */
+        nLen = (uint16)(uSendLen - uFrame - PDC_REPORT_HDR_SIZE);
+        nLen -= (pFrame[PDC_REPORT_HDR_SIZE] & 0x80) ? 2 : 1;
+        MEMMOVE(pFrame + PDC_REPORT_HDR_SIZE,
+                pFrame + uSendLen - uFrame - nLen, nLen);
+        uSendLen = uFrame
+            + (uint32)PosDetCodec_PutReportHdr(pFrame, pMe->dwNextSeq,
+                                               nLen)
+            + nLen;
+    }
+    else {
+        (void)PosDetCodec_PutBatchHdr(pFrame, pMe->dwNextSeq,
+                  (uint16)(uSendLen - uFrame - PDC_REPORT_HDR_SIZE));
+    }
+
+    pMe->nSendCnt = i;
+    pMe->uSendLen = uSendLen;
+    pMe->uBytesSent = 0;
+    pMe->bSending = TRUE;
+    pMe->bHelloDue = FALSE;
+    if (nStatsLen > 0) {
+        PosDetStats_Reset(&pMe->stats);
+    }
+    pMe->dwWriteStart = GETUPTIMEMS();
+    PosDetApp_TryWriteToSvr(pMe);
+}
+
+/* Returns TRUE if sending now would wake a dormant data session. */
+static boolean
+PosDetApp_IsDormant(PosDetApp *pMe)
+{
+    return pMe->nDormantHold > 0
+        && (AEE_NET_STATUS_SLEEPING == pMe->netStatus
+            || AEE_NET_STATUS_ASLEEP == pMe->netStatus);
+}
+
+/* Reports waited nDormantHold seconds for the radio, wake it. */
+static void
+PosDetApp_OnDormantHold(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    pMe->bWakeDue = TRUE;
+    PosDetApp_DrainQueue(pMe);
+}
+
+/* The oldest queued report waited long enough, send the partial batch. */
+static void
+PosDetApp_OnBatchAge(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    pMe->bFlushDue = TRUE;
+    PosDetApp_DrainQueue(pMe);
 }
 
 static void
 PosDetApp_ProcessGPSData(PosDetApp *pMe)
 {
     int err = 0;
+    PosDetFix kept[PDS_MAX_OUT];
+    int nKept = 0;
+    int i;
     err = PosDetApp_DecodePosInfo(pMe);
     if (err != SUCCESS) {
         DBGPRINTF("Decode posInfo failed: err = %d", err);
         return;
     }
-    PosDetApp_MakeReportStr(pMe);
+    PosDetCodec_MakeFix(&pMe->fix, &pMe->posInfoEx, pMe->gpsInfo.dwTimeStamp);
+    PosDetApp_AdaptInterval(pMe);
 
-    PosDetApp_TryWriteToSvr(pMe);
+    PosDetStats_Count(&pMe->stats, PDST_CTR_GPS_FIXES, 1);
+    if (pMe->bTTFFDue) {
+        pMe->bTTFFDue = FALSE;
+        PosDetStats_Sample(&pMe->stats, PDST_HIST_TTFF,
+                           GETUPTIMEMS() - pMe->dwTrackStart);
+    }
+
+    /* Only the fixes needed to draw the track are reported. */
+    nKept = PosDetSimplify_Add(&pMe->simplify, &pMe->fix, kept);
+    for (i = 0; i < nKept; i++) {
+        PosDetApp_ReportFix(pMe, &kept[i]);
+    }
+    if (nKept > 0) {
+        PosDetApp_DrainQueue(pMe);
+    }
 
     /* test */
     PosDetApp_ShowGPSInfo(pMe);
-    PosDetApp_LogPos(pMe);
+}
+
+/* Make the report of pFix and queue it. */
+static void
+PosDetApp_ReportFix(PosDetApp *pMe, const PosDetFix *pFix)
+{
+    PosDetApp_MakeReportStr(pMe, pFix);
+
+    /* Never write straight to the socket, the uplink may be down. */
+    PosDetApp_EnqueueReport(pMe, pFix);
+
+    /* test */
+    PosDetApp_LogPos(pMe, pFix);
 }
 
 static boolean
@@ -1218,7 +1865,270 @@ PosDetApp_RequestAFix(PosDetApp *pMe)
     }
 }
 
-/* Return:
+/*
+ * Config keys. Each "key = value;" line of the config file is looked up in
+ * configKeys and its value handed to the setter of the key, which checks it
+ * and stores it into the field at nOffset.
+ *
+ * Keys with CONFIG_REMOTE may also be set by the server at runtime, see
+ * PosDetApp_ApplyRemoteConfig().
+ */
+typedef struct _ConfigKey ConfigKey;
+typedef boolean (*PFNCONFIGSET)(PosDetApp *pMe, const ConfigKey *pKey,
+                                const char *pszVal);
+
+struct _ConfigKey {
+    const char   *pszKey;
+    PFNCONFIGSET  pfnSet;
+    uint16        nOffset;  // of the field in PosDetApp
+    uint8         nSize;    // of the field, for PosDetApp_SetUInt
+    uint32        nMin;
+    uint32        nMax;
+    uint8         nFlags;
+};
+
+#define CONFIG_REMOTE   0x01    // may be set by a config frame
+
+#define CONFIG_FIELD(f) \
+    (uint16)FPOS(PosDetApp, f), (uint8)FSIZ(PosDetApp, f)
+
+static boolean PosDetApp_SetUInt(PosDetApp *pMe, const ConfigKey *pKey,
+                                 const char *pszVal);
+static boolean PosDetApp_SetPort(PosDetApp *pMe, const ConfigKey *pKey,
+                                 const char *pszVal);
+static boolean PosDetApp_SetIPv4(PosDetApp *pMe, const ConfigKey *pKey,
+                                 const char *pszVal);
+static boolean PosDetApp_SetServerList(PosDetApp *pMe, const ConfigKey *pKey,
+                                       const char *pszVal);
+
+static const ConfigKey configKeys[] = {
+    { SPD_CONFIG_OPT_STRING, PosDetApp_SetUInt,
+      CONFIG_FIELD(gpsSettings.optim), 0, 255, 0 },
+    { SPD_CONFIG_QOS_STRING, PosDetApp_SetUInt,
+      CONFIG_FIELD(gpsSettings.qos), 0, 255, CONFIG_REMOTE },
+    { SPD_CONFIG_SVR_TYPE_STRING, PosDetApp_SetUInt,
+      CONFIG_FIELD(gpsSettings.server.svrType), 0, 255, 0 },
+    { SPD_CONFIG_SVR_IP_STRING, PosDetApp_SetIPv4,
+      CONFIG_FIELD(gpsSettings.server.svr.ipsvr.addr), 0, 0, 0 },
+    { SPD_CONFIG_SVR_PORT_STRING, PosDetApp_SetPort,
+      CONFIG_FIELD(gpsSettings.server.svr.ipsvr.port), 0, 0, 0 },
+    { SPD_CONFIG_UPLOAD_SVR_IP, PosDetApp_SetIPv4,
+      CONFIG_FIELD(svrAddr.inet.addr), 0, 0, 0 },
+    { SPD_CONFIG_UPLOAD_SVR_PORT, PosDetApp_SetPort,
+      CONFIG_FIELD(svrAddr.inet.port), 0, 0, 0 },
+    { SPD_CONFIG_CONNECT_MAX_TRY, PosDetApp_SetUInt,
+      CONFIG_FIELD(tcpConnMaxTry), 1, 255, 0 },
+    { SPD_CONFIG_SERVER_LIST, PosDetApp_SetServerList,
+      CONFIG_FIELD(servers), 0, 0, 0 },
+    { SPD_CONFIG_CONNECT_TIMEOUT, PosDetApp_SetUInt,
+      CONFIG_FIELD(nConnTimeout), 1, 600, 0 },
+    { SPD_CONFIG_PRIMARY_RETURN, PosDetApp_SetUInt,
+      CONFIG_FIELD(nPrimaryReturn), 0, 65535, 0 },
+    { SPD_CONFIG_TRANSPORT, PosDetApp_SetUInt,
+      CONFIG_FIELD(transport), TRANSPORT_TCP, TRANSPORT_UDP, 0 },
+    { SPD_CONFIG_UDP_MAX_LOST, PosDetApp_SetUInt,
+      CONFIG_FIELD(nUdpMaxLost), 1, 255, 0 },
+    { SPD_CONFIG_DORMANT_HOLD, PosDetApp_SetUInt,
+      CONFIG_FIELD(nDormantHold), 0, 3600, CONFIG_REMOTE },
+    { SPD_CONFIG_GET_GPS_INTERVAL, PosDetApp_SetUInt,
+      CONFIG_FIELD(nIntervalCache), 1, 3600, CONFIG_REMOTE },
+    { SPD_CONFIG_GPS_INTERVAL_MIN, PosDetApp_SetUInt,
+      CONFIG_FIELD(nIntervalMin), 0, 3600, CONFIG_REMOTE },
+    { SPD_CONFIG_GPS_INTERVAL_MAX, PosDetApp_SetUInt,
+      CONFIG_FIELD(nIntervalMax), 0, 3600, CONFIG_REMOTE },
+    { SPD_CONFIG_GPS_MODE, PosDetApp_SetUInt,
+      CONFIG_FIELD(gpsModeCache), 0, 255, CONFIG_REMOTE },
+    { SPD_CONFIG_LOCAL_PORT, PosDetApp_SetPort,
+      CONFIG_FIELD(localAddr.inet.port), 0, 0, 0 },
+    { SPD_CONFIG_BATCH_SIZE, PosDetApp_SetUInt,
+      CONFIG_FIELD(nBatchSize), 1, BATCH_MAX_REPORTS, CONFIG_REMOTE },
+    { SPD_CONFIG_BATCH_AGE, PosDetApp_SetUInt,
+      CONFIG_FIELD(nBatchAge), 0, 3600, CONFIG_REMOTE },
+    { SPD_CONFIG_ENCODING, PosDetApp_SetUInt,
+      CONFIG_FIELD(encoding), ENCODING_ASCII, ENCODING_DELTA, CONFIG_REMOTE },
+    { SPD_CONFIG_KEY_INTERVAL, PosDetApp_SetUInt,
+      CONFIG_FIELD(nKeyInterval), 0, 65535, CONFIG_REMOTE },
+    { SPD_CONFIG_SIMPLIFY_TOL, PosDetApp_SetUInt,
+      CONFIG_FIELD(nSimplifyTol), 0, 1000, 0 },
+    { SPD_CONFIG_SIMPLIFY_GAP, PosDetApp_SetUInt,
+      CONFIG_FIELD(nSimplifyGap), 0, 65535, 0 },
+    { SPD_CONFIG_LOG_FILES, PosDetApp_SetUInt,
+      CONFIG_FIELD(nLogFiles), 1, PDL_MAX_FILES, 0 },
+    { SPD_CONFIG_LOG_FILE_SIZE, PosDetApp_SetUInt,
+      CONFIG_FIELD(nLogFileSize), PDL_BUF_SIZE / 1024, 4096, 0 },
+    { SPD_CONFIG_RECONN_BASE, PosDetApp_SetUInt,
+      CONFIG_FIELD(nReconnBase), 100, 3600000, 0 },
+    { SPD_CONFIG_RECONN_CAP, PosDetApp_SetUInt,
+      CONFIG_FIELD(nReconnCap), 100, 3600000, 0 },
+    { SPD_CONFIG_RECONN_MULT, PosDetApp_SetUInt,
+      CONFIG_FIELD(nReconnMult), 100, 1000, 0 },
+    { SPD_CONFIG_RECONN_JITTER, PosDetApp_SetUInt,
+      CONFIG_FIELD(nReconnJitter), 0, 100, 0 },
+    { SPD_CONFIG_ACK_TIMEOUT, PosDetApp_SetUInt,
+      CONFIG_FIELD(nAckTimeout), 0, 3600, 0 },
+    { SPD_CONFIG_STATS_INTERVAL, PosDetApp_SetUInt,
+      CONFIG_FIELD(nStatsInterval), 0, 65535, CONFIG_REMOTE }
+};
+
+/* Parse a decimal number, nothing else may follow it. */
+static boolean
+PosDetApp_ParseUInt(const char *pszVal, uint32 *pn)
+{
+    uint32 n = 0;
+
+    if (0 == *pszVal) {
+        return FALSE;
+    }
+    for (; *pszVal; pszVal++) {
+        if (*pszVal < '0' || *pszVal > '9' || n > (MAX_UINT32 - 9) / 10) {
+            return FALSE;
+        }
+        n = n * 10 + (uint32)(*pszVal - '0');
+    }
+
+    *pn = n;
+    return TRUE;
+}
+
+static boolean
+PosDetApp_SetUInt(PosDetApp *pMe, const ConfigKey *pKey, const char *pszVal)
+{
+    byte *pField = (byte*)pMe + pKey->nOffset;
+    uint32 n = 0;
+
+    if (!PosDetApp_ParseUInt(pszVal, &n) || n < pKey->nMin
+        || n > pKey->nMax) {
+        return FALSE;
+    }
+
+    switch (pKey->nSize) {
+    case 1:
+        *(uint8*)pField = (uint8)n;
+        break;
+    case 2:
+        *(uint16*)pField = (uint16)n;
+        break;
+    default:
+        *(uint32*)pField = n;
+        break;
+    }
+    return TRUE;
+}
+
+/* Port numbers are stored in network byte order. */
+static boolean
+PosDetApp_SetPort(PosDetApp *pMe, const ConfigKey *pKey, const char *pszVal)
+{
+    uint32 n = 0;
+
+    if (!PosDetApp_ParseUInt(pszVal, &n) || n > 65535) {
+        return FALSE;
+    }
+    *(INPort*)((byte*)pMe + pKey->nOffset) = HTONS((uint16)n);
+    return TRUE;
+}
+
+/* Only IPv4 addresses in dotted decimal, host names are not resolved. */
+static boolean
+PosDetApp_SetIPv4(PosDetApp *pMe, const ConfigKey *pKey, const char *pszVal)
+{
+    return INET_PTON(AEE_AF_INET, pszVal,
+                     (INAddr*)((byte*)pMe + pKey->nOffset)) ? TRUE : FALSE;
+}
+
+/* "ip:port, ip:port, ...", the first server is the primary. The whole
+ * list is rejected if any entry is bad. */
+static boolean
+PosDetApp_SetServerList(PosDetApp *pMe, const ConfigKey *pKey,
+                        const char *pszVal)
+{
+    PosDetServers *pSL = (PosDetServers*)((byte*)pMe + pKey->nOffset);
+    PosDetServers servers;
+    AEESockAddrStorage addr;
+    char szItem[32];
+    const char *pEnd = NULL;
+    char *pPort = NULL;
+    uint32 nPort = 0;
+    int nLen = 0;
+
+    PosDetServers_Init(&servers, pSL->nMaxTry);
+    MEMSET(&addr, 0, sizeof(addr));
+    addr.wFamily = AEE_AF_INET;
+
+    while (*pszVal) {
+        while (' ' == *pszVal) {
+            pszVal++;
+        }
+        pEnd = STRCHR(pszVal, ',');
+        nLen = pEnd ? (int)(pEnd - pszVal) : STRLEN(pszVal);
+        if (nLen >= (int)sizeof(szItem)) {
+            return FALSE;
+        }
+        MEMCPY(szItem, pszVal, nLen);
+        while (nLen > 0 && ' ' == szItem[nLen - 1]) {
+            nLen--;
+        }
+        szItem[nLen] = 0;
+
+        pPort = STRCHR(szItem, ':');
+        if (NULL == pPort) {
+            return FALSE;
+        }
+        *pPort++ = 0;
+        if (!INET_PTON(AEE_AF_INET, szItem, &addr.inet.addr)
+            || !PosDetApp_ParseUInt(pPort, &nPort) || 0 == nPort
+            || nPort > 65535) {
+            return FALSE;
+        }
+        addr.inet.port = HTONS((uint16)nPort);
+        if (PosDetServers_Add(&servers, &addr) != SUCCESS) {
+            return FALSE;
+        }
+
+        pszVal = pEnd ? pEnd + 1 : pszVal + STRLEN(pszVal);
+    }
+
+    if (0 == servers.nServers) {
+        return FALSE;
+    }
+    *pSL = servers;
+    return TRUE;
+}
+
+/* Hand one config item to the setter of its key. */
+static void
+PosDetApp_OnConfigItem(void *pUser, const char *pszKey, const char *pszVal,
+                       int nLine)
+{
+    PosDetApp *pMe = (PosDetApp*)pUser;
+    int i;
+
+    for (i = 0; i < (int)ARRAYSIZE(configKeys); i++) {
+        if (STRCMP(configKeys[i].pszKey, pszKey) == 0) {
+            if (pMe->bRemoteConfig
+                && !(configKeys[i].nFlags & CONFIG_REMOTE)) {
+                DBGPRINTF("config line %d: %s can't be set remotely", nLine,
+                          pszKey);
+                pMe->nConfigErrors++;
+            }
+            else if (!configKeys[i].pfnSet(pMe, &configKeys[i], pszVal)) {
+                DBGPRINTF("config line %d: bad value %s = %s", nLine,
+                          pszKey, pszVal);
+                pMe->nConfigErrors++;
+            }
+            return;
+        }
+    }
+
+    DBGPRINTF("config line %d: unknown key %s", nLine, pszKey);
+    pMe->nConfigErrors++;
+}
+
+/* Read the config file in one pass. Missing keys, unknown keys and bad
+ * values leave the defaults in place, the latter two are counted in
+ * pMe->nConfigErrors.
+ *
+ * Return:
      SUCCESS
      NO_USER_CONFIG
      ENOMEMORY
@@ -1230,116 +2140,159 @@ PosDetApp_ReadUserConfig(PosDetApp *pMe)
     IFile *pCnfgFile = NULL;
     int ret = SUCCESS;
     char *pBuf = NULL;
-    char *pszTok = NULL;
-    char *pszDelimiter = ";";
-
     AEEFileInfo fileInfo;
     int nRead = 0;
 
     if (IFILEMGR_Test(pMe->pIFileMgr, SPD_CONFIG_FILE) != SUCCESS) {
         return NO_USER_CONFIG;
     }
-    else {
-        pCnfgFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_CONFIG_FILE,
-                                      _OFM_READ);
-        if (NULL == pCnfgFile) {
-            ret = IFILEMGR_GetLastError(pMe->pIFileMgr);
-            return ret;
-        }
+
+    pCnfgFile = IFILEMGR_OpenFile(pMe->pIFileMgr, SPD_CONFIG_FILE, _OFM_READ);
+    if (NULL == pCnfgFile) {
+        return IFILEMGR_GetLastError(pMe->pIFileMgr);
     }
 
     (void)IFILE_GetInfo(pCnfgFile, &fileInfo);
-    pBuf = (char*)MALLOC(fileInfo.dwSize);
+    pBuf = (char*)MALLOC(fileInfo.dwSize + 1);
     if (NULL == pBuf) {
+        IFILE_Release(pCnfgFile);
         return ENOMEMORY;
     }
 
     nRead = IFILE_Read(pCnfgFile, (void*)pBuf, fileInfo.dwSize);
     if ((uint32)nRead != fileInfo.dwSize) {
-        FREEIF(pBuf);
         ret = IFILEMGR_GetLastError(pMe->pIFileMgr);
-        return ret;
-    }
-
-    /* Check for upload server IP. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_UPLOAD_SVR_IP);
-    if (pszTok) {
-        char *pszSvr = NULL;
-        int nResult = 0;
-        pszTok += STRLEN(SPD_CONFIG_UPLOAD_SVR_IP);
-        nResult = DistToSemi(pszTok);
-        pszSvr = (char*)MALLOC(nResult + 1);
-        (void)STRLCPY(pszSvr, pszTok, nResult + 1);
-        if (!INET_PTON(AEE_AF_INET, pszSvr, &pMe->svrAddr.inet.addr)) {
-            FREE(pszSvr);
-            FREEIF(pBuf);
-            return EFAILED;
-        }
-        FREE(pszSvr);
     }
-
-    /* Check for upload server port. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_UPLOAD_SVR_PORT);
-    if (pszTok) {
-        INPort temp;
-        pszTok += STRLEN(SPD_CONFIG_UPLOAD_SVR_PORT);
-        temp = (INPort)STRTOUL(pszTok, &pszDelimiter, 10);
-        pMe->svrAddr.inet.port = AEE_htons(temp);
-    }
-
-    /* Check for max times of connection try. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_CONNECT_MAX_TRY);
-    if (pszTok) {
-        pszTok += STRLEN(SPD_CONFIG_CONNECT_MAX_TRY);
-        pMe->tcpConnMaxTry = (int)STRTOUL(pszTok, &pszDelimiter, 10);
+    else {
+        pMe->nConfigErrors = 0;
+        pMe->nConfigErrors += ParseConfig(pBuf, nRead, PosDetApp_OnConfigItem,
+                                          pMe);
+        if (pMe->nConfigErrors > 0) {
+            DBGPRINTF(SPD_CONFIG_FILE ": %d errors", pMe->nConfigErrors);
+        }
     }
 
-    /* Check for get GPS info interval. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_GET_GPS_INTERVAL);
-    if (pszTok) {
-        pszTok += STRLEN(SPD_CONFIG_GET_GPS_INTERVAL);
-        pMe->nIntervalCache = (uint16)STRTOUL(pszTok, &pszDelimiter, 10);
-    }
+    FREE(pBuf);
+    IFILE_Release(pCnfgFile);
+    return ret;
+}
 
-    /* Check for GPS mode. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_GPS_MODE);
-    if (pszTok) {
-        pszTok += STRLEN(SPD_CONFIG_GPS_MODE);
-        pMe->gpsModeCache = (AEEGPSMode)STRTOUL(pszTok, &pszDelimiter, 10);
+/* Apply a config frame from the server. Only CONFIG_REMOTE keys are taken,
+ * the others count as errors. The settings last until the applet stops,
+ * config.txt is left as it is.
+ *
+ * The tracking session is reconfigured only if a GPS setting really
+ * changed, the server may well send the same config to the whole fleet
+ * again and again. */
+static void
+PosDetApp_ApplyRemoteConfig(PosDetApp *pMe, const byte *pText, uint16 nLen)
+{
+    char szBuf[RX_BUF_SIZE + 1];
+    AEEGPSMode gpsMode = pMe->gpsModeCache;
+    AEEGPSQos qos = pMe->gpsSettings.qos;
+    uint16 nInterval = pMe->nIntervalCache;
+    uint16 nIntervalMin = pMe->nIntervalMin;
+    uint16 nIntervalMax = pMe->nIntervalMax;
+    uint16 nIntervalCur = pMe->nIntervalCur;
+    ReportEncoding encoding = pMe->encoding;
+    int nErrors = 0;
+
+    MEMCPY(szBuf, pText, nLen);
+    pMe->bRemoteConfig = TRUE;
+    nErrors = ParseConfig(szBuf, nLen, PosDetApp_OnConfigItem, pMe);
+    pMe->bRemoteConfig = FALSE;
+    pMe->nConfigErrors += nErrors;
+    DBGPRINTF("Config from server, %d errors", nErrors);
+
+    if (nInterval != pMe->nIntervalCache
+        || nIntervalMin != pMe->nIntervalMin
+        || nIntervalMax != pMe->nIntervalMax) {
+        PosDetApp_ResetInterval(pMe);
+    }
+    if (gpsMode != pMe->gpsModeCache || qos != pMe->gpsSettings.qos
+        || nIntervalCur != pMe->nIntervalCur) {
+        DBGPRINTF("GPS mode %d, qos %d, interval %d s", pMe->gpsModeCache,
+                  pMe->gpsSettings.qos, pMe->nIntervalCur);
+        PosDetApp_CnfgTrack(pMe);
     }
 
-    /* Check for local port. */
-    pszTok = STRSTR(pBuf, SPD_CONFIG_LOCAL_PORT);
-    if (pszTok) {
-        pszTok += STRLEN(SPD_CONFIG_LOCAL_PORT);
-        pMe->localAddr.inet.port = HTONS((uint16)STRTOUL(pszTok, &pszDelimiter, 10));
+    /* Queued reports keep the encoding they were made in. The next delta
+     * report after a change is a keyframe, so the server does not apply
+     * it to a fix it saw long ago. */
+    if (encoding != pMe->encoding) {
+        PosDetCodec_ResetDelta(&pMe->deltaCtx, pMe->nKeyInterval);
     }
+    pMe->deltaCtx.nKeyInterval = pMe->nKeyInterval;
 
-    FREE(pBuf);
-    IFILE_Release(pCnfgFile);
-    return ret;
+    /* A smaller batch may be complete already. */
+    ISHELL_Resume(pMe->applet.m_pIShell, &pMe->cbDrain);
 }
 
 static void
 PosDetApp_ApplyDefaultConfig(PosDetApp *pMe)
 {
+    /* GPS settings. */
+    pMe->gpsSettings.reqType = MULTIPLE_REQUESTS;
+    pMe->gpsSettings.optim = AEEGPS_OPT_DEFAULT;
+    pMe->gpsSettings.qos = SPD_QOS_DEFAULT;
+    pMe->gpsSettings.server.svrType = AEEGPS_SERVER_DEFAULT;
+
     /* Initialize the addresses. */
     pMe->svrAddr.wFamily = AEE_AF_INET;          /* IPv4 socket */
     pMe->svrAddr.inet.port = HTONS(SERVER_PORT); /* set port number */
     INET_PTON(pMe->svrAddr.wFamily, SERVER_ADDR,
               &(pMe->svrAddr.inet.addr)); /* set server IP addr */
 
-    /* Initialize the max times of connect try. */
+    /* Server list and failover, see PosDetServers.h. The list is filled
+     * from the config. */
     pMe->tcpConnMaxTry = CONNECT_MAX_TRY;
+    PosDetServers_Init(&pMe->servers, CONNECT_MAX_TRY);
+    pMe->nConnTimeout = DEFAULT_CONNECT_TIMEOUT;
+    pMe->nPrimaryReturn = DEFAULT_PRIMARY_RETURN;
+
+    /* Transport. */
+    pMe->transport = DEFAULT_TRANSPORT;
+    pMe->nUdpMaxLost = DEFAULT_UDP_MAX_LOST;
+
+    /* Dormancy. */
+    pMe->nDormantHold = DEFAULT_DORMANT_HOLD;
 
     /* Initialize GPS mode. */
     pMe->gpsModeCache = AEEGPS_MODE_TRACK_LOCAL;
 
     /* Initialize interval of getting GPS info. */
     pMe->nIntervalCache = GPSCBACK_INTERVAL;
+    pMe->nIntervalMin = 0;
+    pMe->nIntervalMax = 0;
 
     /* local port */
     pMe->localAddr.inet.port = HTONS(DEFAULT_LOCAL_PORT);
+
+    /* Batching of reports. */
+    pMe->nBatchSize = DEFAULT_BATCH_SIZE;
+    pMe->nBatchAge = DEFAULT_BATCH_AGE;
+
+    /* Wire format of reports. */
+    pMe->encoding = DEFAULT_ENCODING;
+    pMe->nKeyInterval = DEFAULT_KEY_INTERVAL;
+
+    /* Track simplification. */
+    pMe->nSimplifyTol = DEFAULT_SIMPLIFY_TOL;
+    pMe->nSimplifyGap = DEFAULT_SIMPLIFY_GAP;
+
+    /* Local log. */
+    pMe->nLogFiles = DEFAULT_LOG_FILES;
+    pMe->nLogFileSize = DEFAULT_LOG_FILE_SIZE;
+
+    /* Reconnect backoff. */
+    pMe->nReconnBase = DEFAULT_RECONN_BASE;
+    pMe->nReconnCap = DEFAULT_RECONN_CAP;
+    pMe->nReconnMult = DEFAULT_RECONN_MULT;
+    pMe->nReconnJitter = DEFAULT_RECONN_JITTER;
+
+    /* Acknowledgements. */
+    pMe->nAckTimeout = DEFAULT_ACK_TIMEOUT;
+    pMe->nStatsInterval = DEFAULT_STATS_INTERVAL;
 }
 
 static void
@@ -1349,13 +2302,13 @@ PosDetApp_TryBind(void *po)
     int ret = 0;
     ret = ISockPort_Bind(pMe->pISockPort, &pMe->localAddr);
     if (AEEPORT_WAIT == ret) {
-        DBGPRINTF("Try binding to port %d waiting...",
-                  NTOHS(pMe->localAddr.inet.port));
+        PDT_DEBUG(&pMe->trace, PDT_EV_BIND_WAIT,
+                  NTOHS(pMe->localAddr.inet.port), 0);
         ISockPort_Writeable(pMe->pISockPort, &pMe->cbTryBind);
         return;
     } else if (AEE_SUCCESS != ret) {
-        DBGPRINTF("Try binding to port %d err = 0x%x",
-                  NTOHS(pMe->localAddr.inet.port), ret);
+        PDT_ERROR(&pMe->trace, PDT_EV_BIND_ERR, ret,
+                  NTOHS(pMe->localAddr.inet.port));
         return;
     }
     /* AEE_SUCCESS == ret */
@@ -1368,7 +2321,7 @@ PosDetApp_TryBind(void *po)
 static void
 PosDetApp_OnBadConn(PosDetApp *pMe)
 {
-    DBGPRINTF("PosDetApp_OnBadConn");
+    PDT_INFO(&pMe->trace, PDT_EV_CONN_BAD, pMe->servers.nCur, 0);
     ISHELL_SetTimer(pMe->applet.m_pIShell, 0, PosDetApp_ProcessBadConn, pMe);
 }
 
@@ -1376,55 +2329,148 @@ static void
 PosDetApp_OnGetGpsInfoTimeout(void *po)
 {
     PosDetApp *pMe = (PosDetApp*)po;
-    DBGPRINTF("GetGPSInfo time out. Retry request.");
+    PDT_ERROR(&pMe->trace, PDT_EV_GPS_TIMEOUT, pMe->nReqTimeout, 0);
+
+    /* Give up the pending request, or no new one would be made. */
+    CALLBACK_Cancel(&pMe->cbGetGPSInfo);
+    pMe->bWaitingForResp = FALSE;
+    PosDetApp_AdaptRequest(pMe, FALSE, pMe->nReqTimeout);
+    PosDetStats_Count(&pMe->stats, PDST_CTR_GPS_TIMEOUTS, 1);
+
     ISHELL_Resume(pMe->applet.m_pIShell, &pMe->cbReqInterval);
 }
 
 static void
 PosDetApp_OnNetEvtIP(void *po, int evt)
 {
-    DBGPRINTF("#### PosDetApp_OnNetEvtIP");
-    DBGPRINTF("evt = %d", evt);
-    PosDetApp_ProcessNetEvtIP((PosDetApp*)po);
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    PDT_INFO(&pMe->trace, PDT_EV_NET_IP, evt, 0);
+    PosDetApp_ProcessNetEvtIP(pMe);
+
+    /* A new address is the best time to reach the server, don't wait out
+     * the backoff. */
+    PosDetApp_ConnectNow(pMe);
 }
 
 static void
 PosDetApp_OnNetEvtState(void *po, int evt)
 {
-    DBGPRINTF("#### PosDetApp_OnNetEvtState");
-    DBGPRINTF("evt = %d", evt);
-    PosDetApp_ProcessNetEvtState((PosDetApp*)po);
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    PDT_INFO(&pMe->trace, PDT_EV_NET_STATE, evt, 0);
+    PosDetApp_ProcessNetEvtState(pMe);
+
+    /* The radio is up anyway, send everything waiting, partial batch
+     * included. */
+    if (AEE_NET_STATUS_OPEN == pMe->netStatus) {
+        pMe->bFlushDue = TRUE;
+        PosDetApp_DrainQueue(pMe);
+    }
+}
+
+/* If waiting to retry a connect, retry now, with a fresh backoff. */
+static void
+PosDetApp_ConnectNow(PosDetApp *pMe)
+{
+    if (pMe->bConnected || !CALLBACK_IsQueued(&pMe->cbTryConn)
+        || CALLBACK_IsQueued(&pMe->cbConnTimeout)) {
+        return; // connected, stopped, or a connect is under way
+    }
+
+    PDT_INFO(&pMe->trace, PDT_EV_CONN_NOW, pMe->servers.nCur, 0);
+    PosDetBackoff_Reset(&pMe->reconnect);
+    CALLBACK_Cancel(&pMe->cbTryConn);
+    CALLBACK_Init(&pMe->cbTryConn, PosDetApp_TryConnect, pMe);
+    ISHELL_SetTimerEx(pMe->applet.m_pIShell, 0, &pMe->cbTryConn);
+}
+
+static void
+PosDetApp_OnConnTimeout(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    PDT_ERROR(&pMe->trace, PDT_EV_CONN_DEADLINE, pMe->servers.nCur, 0);
+    PosDetApp_OnBadConn(pMe);
+}
+
+/* Connected to a backup server for nPrimaryReturn seconds, try the
+ * primary again. Reports not acknowledged yet are sent to it. */
+static void
+PosDetApp_OnPrimaryReturn(void *po)
+{
+    PosDetApp *pMe = (PosDetApp*)po;
+
+    PDT_INFO(&pMe->trace, PDT_EV_CONN_PRIMARY, pMe->servers.nCur, 0);
+    PosDetApp_CloseConn(pMe);
+    PosDetServers_UsePrimary(&pMe->servers);
+
+    CALLBACK_Cancel(&pMe->cbTryConn);
+    CALLBACK_Init(&pMe->cbTryConn, PosDetApp_TryConnect, pMe);
+    ISHELL_SetTimerEx(pMe->applet.m_pIShell, 0, &pMe->cbTryConn);
 }
 
 static void
 PosDetApp_ProcessBadConn(void *po)
 {
     PosDetApp *pMe = (PosDetApp*)po;
-    int ret = 0;
 
     PosDetApp_ProcessNetEvtState(pMe);
+    PosDetApp_CloseConn(pMe);
+    PosDetApp_RetryConnect(pMe);
+}
+
+/* Drop the connection, or the try to connect, and open a new socket. */
+static void
+PosDetApp_CloseConn(PosDetApp *pMe)
+{
+    int ret = 0;
+    boolean bOpen = FALSE;
 
     pMe->bConnected = FALSE;
-    pMe->bWaitingForResp = FALSE;
     pMe->bSending = FALSE;
+    pMe->uBytesSent = 0; // the unfinished batch is sent again in full
+    pMe->nRxLen = 0;
 
     CALLBACK_Cancel(&pMe->cbTryConn);
     CALLBACK_Cancel(&pMe->cbTryBind);
-    CALLBACK_Cancel(&pMe->cbReqTimeout);
-    CALLBACK_Cancel(&pMe->cbGetGPSInfo);
     CALLBACK_Cancel(&pMe->cbSendTo);
-    CALLBACK_Cancel(&pMe->cbReqInterval);
+    CALLBACK_Cancel(&pMe->cbDrain);
+    CALLBACK_Cancel(&pMe->cbBatchAge);
+    CALLBACK_Cancel(&pMe->cbRead);
+    CALLBACK_Cancel(&pMe->cbAckTimeout);
+    CALLBACK_Cancel(&pMe->cbConnTimeout);
+    CALLBACK_Cancel(&pMe->cbPrimary);
 
     ret = ISockPort_Close(pMe->pISockPort);
-    DBGPRINTF("**** SockPort close err = 0x%x", ret);
     ISockPort_Release(pMe->pISockPort);
     pMe->pISockPort = NULL;
 
-    ret = PosDetApp_StartTCPClient(pMe);
-    DBGPRINTF("Re-start TCP client, boolean = %d", ret);
+    bOpen = PosDetApp_StartClient(pMe);
+    PDT_INFO(&pMe->trace, PDT_EV_CONN_CLOSE, ret, bOpen);
+}
+
+/* Count a failed try and schedule the next one: soon, on the same or the
+ * next server, or after the backoff delay once every server failed. */
+static void
+PosDetApp_RetryConnect(PosDetApp *pMe)
+{
+    uint32 nDelay = CONNECT_RETRY_DELAY;
+
+    if (PosDetServers_Failed(&pMe->servers)) {
+        nDelay = PosDetBackoff_Next(&pMe->reconnect);
+        PosDetStats_Set(&pMe->stats, PDST_GAUGE_BACKOFF_FAILURES,
+                        pMe->reconnect.nFailures);
+        PosDetStats_Set(&pMe->stats, PDST_GAUGE_BACKOFF_DELAY, nDelay);
+    }
+    PosDetStats_Count(&pMe->stats, PDST_CTR_RECONNECTS, 1);
 
-    ISHELL_SetTimerEx(pMe->applet.m_pIShell, CONNECT_LONG_DELAY,
-                      &pMe->cbTryConn);
+    PDT_INFO(&pMe->trace, PDT_EV_CONN_RETRY, nDelay,
+             PDT_SPLIT(pMe->reconnect.nFailures, pMe->servers.nCur));
+    CALLBACK_Cancel(&pMe->cbConnTimeout);
+    CALLBACK_Cancel(&pMe->cbTryConn);
+    CALLBACK_Init(&pMe->cbTryConn, PosDetApp_TryConnect, pMe);
+    ISHELL_SetTimerEx(pMe->applet.m_pIShell, (int32)nDelay, &pMe->cbTryConn);
 }
 
 static void
@@ -1435,21 +2481,21 @@ PosDetApp_ProcessNetEvtIP(PosDetApp *pMe)
 
     err = INetwork_GetMyIPAddrs(pMe->pINetwork, NULL, &numAddr);
     if (AEE_NET_SUCCESS != err) {
-        DBGPRINTF("GetMyIPAddrs numAddr err = 0x%x", err);
+        PDT_ERROR(&pMe->trace, PDT_EV_IP_ERR, err, 0);
         return;
     }
 
-    DBGPRINTF("IP num = %d", numAddr);
+    PDT_INFO(&pMe->trace, PDT_EV_IP_ADDRS, numAddr, 0);
     FREEIF(pMe->pMyIPs);
     pMe->pMyIPs = (IPAddr*)MALLOC(numAddr * sizeof(IPAddr));
     if (NULL == pMe->pMyIPs) {
-        DBGPRINTF("MALLOC IPAddr[] failed!");
+        PDT_ERROR(&pMe->trace, PDT_EV_IP_NOMEM, numAddr, 0);
         return;
     }
 
     err = INetwork_GetMyIPAddrs(pMe->pINetwork, pMe->pMyIPs, &numAddr);
     if (AEE_NET_SUCCESS != err) {
-        DBGPRINTF("GetMyIPAddrs err = 0x%x", err);
+        PDT_ERROR(&pMe->trace, PDT_EV_IP_ERR, err, 0);
         return;
     }
 }
@@ -1461,37 +2507,7 @@ PosDetApp_ProcessNetEvtState(PosDetApp *pMe)
     AEENetStats  netStats;
 
     (void)INetwork_NetStatus(pMe->pINetwork, &netStatus, &netStats);
+    pMe->netStatus = netStatus;
 
-#ifdef _DEBUG
-    switch (netStatus) {
-    case AEE_NET_STATUS_INVALID_STATE:
-        DBGPRINTF("Net status: INVALID");
-        break;
-    case AEE_NET_STATUS_OPENING:
-        DBGPRINTF("Net status: OPENING");
-        break;
-    case AEE_NET_STATUS_OPEN:
-        DBGPRINTF("Net status: OPEN");
-        break;
-    case AEE_NET_STATUS_CLOSING:
-        DBGPRINTF("Net status: CLOSING");
-        break;
-    case AEE_NET_STATUS_CLOSED:
-        DBGPRINTF("Net status: CLOSED");
-        break;
-    case AEE_NET_STATUS_SLEEPING:
-        DBGPRINTF("Net status: SLEEPING");
-        break;
-    case AEE_NET_STATUS_ASLEEP:
-        DBGPRINTF("Net status: ASLEEP");
-        break;
-    case AEE_NET_STATUS_WAKING:
-        DBGPRINTF("Net status: WAKING");
-        break;
-    default:
-        break;
-    }
-#else
-    DBGPRINTF("Net status = %d", netStatus);
-#endif
+    PDT_INFO(&pMe->trace, PDT_EV_NET_STATUS, netStatus, 0);
 }
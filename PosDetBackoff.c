@@ -0,0 +1,51 @@
+#include "PosDetBackoff.h"
+
+void
+PosDetBackoff_Init(PosDetBackoff *pb, uint32 nBase, uint32 nCap,
+                   uint16 nMultiplier, uint8 nJitter)
+{
+    MEMSET(pb, 0, sizeof(PosDetBackoff));
+    pb->nBase = MAX(nBase, 1);
+    pb->nCap = MAX(nCap, pb->nBase);
+    pb->nMultiplier = MAX(nMultiplier, 100);
+    pb->nJitter = MIN(nJitter, 100);
+    pb->nCur = pb->nBase;
+}
+
+/* Count a failure and return the milliseconds to wait before retrying. */
+uint32
+PosDetBackoff_Next(PosDetBackoff *pb)
+{
+    uint32 nDelay = pb->nCur;
+    uint32 nSpread = nDelay / 100 * pb->nJitter
+        + nDelay % 100 * pb->nJitter / 100;
+    uint32 nRand = 0;
+
+    if (nSpread > 0) {
+        GETRAND(&nRand, sizeof(nRand));
+        nDelay -= nRand % (nSpread + 1);
+    }
+
+    /* Grow the next delay, without overflowing on a large cap. */
+    if (pb->nCur >= pb->nCap / pb->nMultiplier * 100) {
+        pb->nCur = pb->nCap;
+    }
+    else {
+        pb->nCur = MIN(pb->nCur * pb->nMultiplier / 100, pb->nCap);
+    }
+
+    if (pb->nFailures < 0xFFFF) {
+        pb->nFailures++;
+    }
+    pb->nLast = nDelay;
+    return nDelay;
+}
+
+/* The retried operation succeeded, start over from nBase. */
+void
+PosDetBackoff_Reset(PosDetBackoff *pb)
+{
+    pb->nCur = pb->nBase;
+    pb->nLast = 0;
+    pb->nFailures = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef POSDETBACKOFF_H
+#define POSDETBACKOFF_H
+
+#include "AEEStdLib.h"
+
+/*
+ * Retry delays growing exponentially with randomized jitter, so that a
+ * fleet of devices losing the server at the same moment does not come back
+ * at the same moment.
+ *
+ * The n-th retry in a row waits MIN(nBase * (nMultiplier/100)^(n-1), nCap)
+ * milliseconds, minus a random part of up to nJitter percent of it.
+ */
+
+typedef struct _PosDetBackoff {
+    uint32 nBase;       // ms, delay of the first retry
+    uint32 nCap;        // ms, longest delay
+    uint16 nMultiplier; // percent, 200 doubles the delay on each failure
+    uint8  nJitter;     // percent of the delay that is randomized
+    uint32 nCur;        // ms, delay of the next retry before jitter
+    uint32 nLast;       // ms, delay handed out last
+    uint16 nFailures;   // failures in a row
+} PosDetBackoff;
+
+void   PosDetBackoff_Init(PosDetBackoff *pb, uint32 nBase, uint32 nCap,
+                          uint16 nMultiplier, uint8 nJitter);
+uint32 PosDetBackoff_Next(PosDetBackoff *pb);
+void   PosDetBackoff_Reset(PosDetBackoff *pb);
+
+#endif /* ifndef POSDETBACKOFF_H */
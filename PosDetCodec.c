@@ -0,0 +1,347 @@
+#include "PosDetCodec.h"
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+static byte *
+PutBE16(byte *p, uint16 v)
+{
+    *p++ = (byte)(v >> 8);
+    *p++ = (byte)(v & 0xFF);
+    return p;
+}
+
+static byte *
+PutBE32(byte *p, uint32 v)
+{
+    *p++ = (byte)(v >> 24);
+    *p++ = (byte)((v >> 16) & 0xFF);
+    *p++ = (byte)((v >> 8) & 0xFF);
+    *p++ = (byte)(v & 0xFF);
+    return p;
+}
+
+static uint16
+GetBE16(const byte *p)
+{
+    return (uint16)((p[0] << 8) | p[1]);
+}
+
+static uint32
+GetBE32(const byte *p)
+{
+    return ((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8)
+        | (uint32)p[3];
+}
+
+/* Append v as a zig-zag varint, returns the new end. */
+static byte *
+PutZigZag(byte *p, int32 v)
+{
+    uint32 u = ((uint32)v << 1) ^ (uint32)(v >> 31);
+
+    while (u >= 0x80) {
+        *p++ = (byte)(u | 0x80);
+        u >>= 7;
+    }
+    *p++ = (byte)u;
+    return p;
+}
+
+/* Longitude change from nFrom to nTo, wrapped into -180 to 180 degrees.
+ * Across the antimeridian the plain difference is close to a full turn,
+ * and does not even fit in an int32. */
+static int32
+LonDelta(int32 nFrom, int32 nTo)
+{
+    uint32 d = 0;
+
+    if (nTo >= nFrom) {
+        d = (uint32)nTo - (uint32)nFrom;
+        return d < PDC_LON_HALF_TURN ? (int32)d
+                                     : -(int32)(PDC_LON_TURN - d);
+    }
+    d = (uint32)nFrom - (uint32)nTo;
+    return d <= PDC_LON_HALF_TURN ? -(int32)d : (int32)(PDC_LON_TURN - d);
+}
+
+/* Write everything of the binary report but the magic and version. */
+static byte *
+PutFixBody(byte *p, const PosDetFix *pFix)
+{
+    *p++ = pFix->flags;
+    p = PutBE32(p, pFix->dwTime);
+    p = PutBE32(p, (uint32)pFix->nLat);
+    p = PutBE32(p, (uint32)pFix->nLon);
+    p = PutBE16(p, (uint16)pFix->nAlt);
+    p = PutBE16(p, pFix->wSpeed);
+    p = PutBE16(p, pFix->wHeading);
+    return p;
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+/* Round v * scale to the nearest integer. */
+int32
+PosDetCodec_ToFixed(double v, double scale)
+{
+    double d = FMUL(v, scale);
+
+    if (FCMP_L(d, 0.0)) {
+        return FLTTOINT(FSUB(d, 0.5));
+    }
+    return FLTTOINT(FADD(d, 0.5));
+}
+
+/* Convert the position decoded by IPosDet into fixed point. */
+void
+PosDetCodec_MakeFix(PosDetFix *pFix, const AEEPositionInfoEx *pInfo,
+                    uint32 dwGpsTime)
+{
+    int32 n = 0;
+
+    MEMSET(pFix, 0, sizeof(PosDetFix));
+    pFix->dwTime = dwGpsTime + PDC_GPS_TO_UNIX_SECS;
+
+    if (pInfo->fLatitude && pInfo->fLongitude) {
+        pFix->nLat = PosDetCodec_ToFixed(pInfo->Latitude, 10000000.0);
+        pFix->nLon = PosDetCodec_ToFixed(pInfo->Longitude, 10000000.0);
+        pFix->flags |= PDC_HAS_POS;
+    }
+    if (pInfo->fAltitude) {
+        n = pInfo->nAltitude;
+        pFix->nAlt = (int16)MAX(MIN(n, 32767), -32768);
+        pFix->flags |= PDC_HAS_ALT;
+    }
+    if (pInfo->fHorVelocity) {
+        n = PosDetCodec_ToFixed(pInfo->HorVelocity, 100.0);
+        pFix->wSpeed = (uint16)MAX(MIN(n, 65535), 0);
+        pFix->flags |= PDC_HAS_SPEED;
+    }
+    if (pInfo->fHeading) {
+        n = PosDetCodec_ToFixed(pInfo->Heading, 100.0) % 36000;
+        pFix->wHeading = (uint16)(n < 0 ? n + 36000 : n);
+        pFix->flags |= PDC_HAS_HEADING;
+    }
+}
+
+/* Returns the number of bytes written, or 0 if nSize is too small. */
+int
+PosDetCodec_EncodeBinary(const PosDetFix *pFix, byte *pBuf, int nSize)
+{
+    byte *p = pBuf;
+
+    if (nSize < PDC_BINARY_SIZE) {
+        return 0;
+    }
+
+    *p++ = PDC_MAGIC_BINARY;
+    *p++ = PDC_BINARY_VERSION;
+    p = PutFixBody(p, pFix);
+
+    return (int)(p - pBuf);
+}
+
+/* Returns SUCCESS, or EBADPARM if pBuf does not hold a binary report. */
+int
+PosDetCodec_DecodeBinary(const byte *pBuf, int nLen, PosDetFix *pFix)
+{
+    if (nLen < PDC_BINARY_SIZE || PDC_MAGIC_BINARY != pBuf[0]
+        || PDC_BINARY_VERSION != pBuf[1]) {
+        return EBADPARM;
+    }
+
+    pFix->flags = pBuf[2];
+    pFix->dwTime = GetBE32(pBuf + 3);
+    pFix->nLat = (int32)GetBE32(pBuf + 7);
+    pFix->nLon = (int32)GetBE32(pBuf + 11);
+    pFix->nAlt = (int16)GetBE16(pBuf + 15);
+    pFix->wSpeed = GetBE16(pBuf + 17);
+    pFix->wHeading = GetBE16(pBuf + 19);
+
+    return SUCCESS;
+}
+
+/* Write a frame header for nLen bytes of payload, returns its size. */
+int
+PosDetCodec_PutFrameHdr(byte *pBuf, byte type, uint16 nLen)
+{
+    pBuf[0] = type;
+    (void)PutBE16(pBuf + 1, nLen);
+    return PDC_FRAME_HDR_SIZE;
+}
+
+/* Write the header of a report frame with sequence number dwSeq, for a
+ * report of nLen bytes. Returns the header size. */
+int
+PosDetCodec_PutReportHdr(byte *pBuf, uint32 dwSeq, uint16 nLen)
+{
+    (void)PosDetCodec_PutFrameHdr(pBuf, PDC_FRAME_REPORT, (uint16)(4 + nLen));
+    (void)PutBE32(pBuf + PDC_FRAME_HDR_SIZE, dwSeq);
+    return PDC_REPORT_HDR_SIZE;
+}
+
+/* Write the header of a batch frame whose first report has sequence number
+ * dwSeq, for nLen bytes of length-prefixed reports. Returns the header
+ * size, the same as that of a report frame. */
+int
+PosDetCodec_PutBatchHdr(byte *pBuf, uint32 dwSeq, uint16 nLen)
+{
+    (void)PosDetCodec_PutFrameHdr(pBuf, PDC_FRAME_BATCH, (uint16)(4 + nLen));
+    (void)PutBE32(pBuf + PDC_FRAME_HDR_SIZE, dwSeq);
+    return PDC_REPORT_HDR_SIZE;
+}
+
+/* Write the length of a report in a batch frame, returns its size, 1 for a
+ * report shorter than 128 bytes, at most PDC_BATCH_LEN_MAX. */
+int
+PosDetCodec_PutBatchLen(byte *pBuf, uint16 nLen)
+{
+    if (nLen < 0x80) {
+        pBuf[0] = (byte)nLen;
+        return 1;
+    }
+    pBuf[0] = (byte)(nLen | 0x80);
+    pBuf[1] = (byte)(nLen >> 7);
+    return 2;
+}
+
+/* Find the first frame in the nLen bytes received at pBuf.
+ * Returns the size of the whole frame, or 0 if it is not complete yet. */
+int
+PosDetCodec_ParseFrame(const byte *pBuf, int nLen, byte *pType,
+                       const byte **ppPayload, uint16 *pnPayload)
+{
+    uint16 nPayload = 0;
+
+    if (nLen < PDC_FRAME_HDR_SIZE) {
+        return 0;
+    }
+    nPayload = GetBE16(pBuf + 1);
+    if (nLen < PDC_FRAME_HDR_SIZE + nPayload) {
+        return 0;
+    }
+
+    *pType = pBuf[0];
+    *ppPayload = pBuf + PDC_FRAME_HDR_SIZE;
+    *pnPayload = nPayload;
+    return PDC_FRAME_HDR_SIZE + nPayload;
+}
+
+/* Returns SUCCESS, or EBADPARM if the payload is not an ACK. */
+int
+PosDetCodec_DecodeAck(const byte *pPayload, uint16 nLen, uint32 *pdwSeq)
+{
+    if (nLen < 4) {
+        return EBADPARM;
+    }
+    *pdwSeq = GetBE32(pPayload);
+    return SUCCESS;
+}
+
+/* Returns the size of the whole frame, or 0 if nSize is too small. */
+int
+PosDetCodec_EncodeHello(const char *pszTerminalId, byte *pBuf, int nSize)
+{
+    int nIdLen = STRLEN(pszTerminalId);
+
+    if (nSize < PDC_FRAME_HDR_SIZE + 1 + nIdLen) {
+        return 0;
+    }
+
+    (void)PosDetCodec_PutFrameHdr(pBuf, PDC_FRAME_HELLO, (uint16)(1 + nIdLen));
+    pBuf[PDC_FRAME_HDR_SIZE] = PDC_BINARY_VERSION;
+    MEMCPY(pBuf + PDC_FRAME_HDR_SIZE + 1, pszTerminalId, nIdLen);
+
+    return PDC_FRAME_HDR_SIZE + 1 + nIdLen;
+}
+
+/* Start a new stream, the next fix is sent as a keyframe. */
+void
+PosDetCodec_ResetDelta(PosDetDeltaCtx *pCtx, uint16 nKeyInterval)
+{
+    MEMSET(pCtx, 0, sizeof(PosDetDeltaCtx));
+    pCtx->nKeyInterval = nKeyInterval;
+}
+
+/* Encode pFix relative to the previous fix of the stream.
+ * Returns the number of bytes written, or 0 if nSize is too small. */
+int
+PosDetCodec_EncodeDelta(PosDetDeltaCtx *pCtx, const PosDetFix *pFix,
+                        const char *pszTerminalId, byte *pBuf, int nSize)
+{
+    byte *p = pBuf;
+    int32 dt = 0;
+    int32 dHeading = 0;
+    byte mask = 0;
+    int nIdLen = 0;
+
+    if (!pCtx->bHaveKey || pFix->flags != pCtx->last.flags
+        || (pCtx->nKeyInterval && pCtx->nSinceKey >= pCtx->nKeyInterval)) {
+
+        nIdLen = MIN(STRLEN(pszTerminalId), PDC_KEY_ID_MAX);
+        if (nSize < PDC_KEY_MAX_SIZE) {
+            return 0;
+        }
+
+        *p++ = PDC_MAGIC_KEY;
+        *p++ = PDC_BINARY_VERSION;
+        *p++ = (byte)nIdLen;
+        MEMCPY(p, pszTerminalId, nIdLen);
+        p = PutFixBody(p + nIdLen, pFix);
+
+        pCtx->bHaveKey = TRUE;
+        pCtx->nSinceKey = 0;
+        pCtx->nLastDt = 0;
+        pCtx->last = *pFix;
+        return (int)(p - pBuf);
+    }
+
+    if (nSize < PDC_DELTA_MAX_SIZE) {
+        return 0;
+    }
+
+    dt = (int32)(pFix->dwTime - pCtx->last.dwTime);
+    dHeading = (int32)pFix->wHeading - (int32)pCtx->last.wHeading;
+    if (dHeading > 18000) {
+        dHeading -= 36000;
+    }
+    else if (dHeading < -18000) {
+        dHeading += 36000;
+    }
+
+    p++; // the tag byte is written last, when the mask is known
+    if (dt != pCtx->nLastDt) {
+        mask |= PDC_DELTA_TIME;
+        p = PutZigZag(p, dt - pCtx->nLastDt);
+    }
+    if (pFix->nLat != pCtx->last.nLat) {
+        mask |= PDC_DELTA_LAT;
+        p = PutZigZag(p, pFix->nLat - pCtx->last.nLat);
+    }
+    if (pFix->nLon != pCtx->last.nLon) {
+        mask |= PDC_DELTA_LON;
+        p = PutZigZag(p, LonDelta(pCtx->last.nLon, pFix->nLon));
+    }
+    if (pFix->nAlt != pCtx->last.nAlt) {
+        mask |= PDC_DELTA_ALT;
+        p = PutZigZag(p, (int32)pFix->nAlt - (int32)pCtx->last.nAlt);
+    }
+    if (pFix->wSpeed != pCtx->last.wSpeed) {
+        mask |= PDC_DELTA_SPEED;
+        p = PutZigZag(p, (int32)pFix->wSpeed - (int32)pCtx->last.wSpeed);
+    }
+    if (dHeading != 0) {
+        mask |= PDC_DELTA_HEADING;
+        p = PutZigZag(p, dHeading);
+    }
+    pBuf[0] = (byte)(PDC_DELTA_TAG | mask);
+
+    pCtx->nSinceKey++;
+    pCtx->nLastDt = dt;
+    pCtx->last = *pFix;
+    return (int)(p - pBuf);
+}
@@ -0,0 +1,186 @@
+#ifndef POSDETCODEC_H
+#define POSDETCODEC_H
+
+#include "AEEStdLib.h"
+#include "AEEPosDet.h"
+
+/*
+ * Compact binary encoding of a position report.
+ *
+ * All fields are big-endian:
+ *
+ *   offset size  field
+ *   0      1     magic, PDC_MAGIC_BINARY
+ *   1      1     version, PDC_BINARY_VERSION
+ *   2      1     flags, PDC_HAS_* bits
+ *   3      4     time, seconds since 1970-01-01 00:00:00 GMT
+ *   7      4     latitude, int32 in 1e-7 degree
+ *   11     4     longitude, int32 in 1e-7 degree
+ *   15     2     altitude, int16 in metre
+ *   17     2     horizontal speed, uint16 in 0.01 m/s
+ *   19     2     heading, uint16 in 0.01 degree
+ *
+ * The magic byte is never a printable character, so the server tells a
+ * binary report from an ASCII "{EHL,...}" report by its first byte.
+ */
+
+#define PDC_MAGIC_BINARY    0xB5
+#define PDC_BINARY_VERSION  1
+#define PDC_BINARY_SIZE     21
+
+#define PDC_HAS_POS         0x01
+#define PDC_HAS_ALT         0x02
+#define PDC_HAS_SPEED       0x04
+#define PDC_HAS_HEADING     0x08
+
+/*
+ * Delta stream encoding.
+ *
+ * Within a connection, fixes are sent as a keyframe followed by deltas:
+ *
+ * Keyframe:
+ *   offset size  field
+ *   0      1     magic, PDC_MAGIC_KEY
+ *   1      1     version, PDC_BINARY_VERSION
+ *   2      1     n, length of the terminal ID
+ *   3      n     terminal ID, ASCII, up to PDC_KEY_ID_MAX characters
+ *   3+n    19    flags, time, latitude, ... as in the binary report
+ *
+ * Delta:
+ *   0      1     PDC_DELTA_TAG | mask, the mask telling which fields follow
+ *   1      ...   one zig-zag varint per field in the mask, in bit order
+ *
+ *   mask bit  field
+ *   0         time, change of the interval since the previous fix
+ *   1         latitude change
+ *   2         longitude change, wrapped into -180 to 180 degrees
+ *   3         altitude change
+ *   4         speed change
+ *   5         heading change, wrapped into -18000 to 18000
+ *
+ * The longitude is wrapped across the antimeridian, where it goes from
+ * 179.99 to -179.99 degrees, the reader wraps the sum back into -180 to
+ * 180. Fields that did not change are left out. A varint holds 7 bits per byte,
+ * least significant group first, the high bit set on all but the last
+ * byte. Zig-zag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+ *
+ * A keyframe is sent for the first fix of a connection, every nKeyInterval
+ * fixes and whenever the PDC_HAS_* flags change, so that the server can
+ * resync after a lost connection.
+ */
+
+#define PDC_MAGIC_KEY       0xB6
+#define PDC_DELTA_TAG       0xC0
+#define PDC_DELTA_TAG_MASK  0xC0
+#define PDC_KEY_ID_MAX      32
+#define PDC_KEY_MAX_SIZE    (3 + PDC_KEY_ID_MAX + PDC_BINARY_SIZE - 2)
+#define PDC_DELTA_MAX_SIZE  (1 + 6 * 5)
+
+#define PDC_DELTA_TIME      0x01
+#define PDC_DELTA_LAT       0x02
+#define PDC_DELTA_LON       0x04
+#define PDC_DELTA_ALT       0x08
+#define PDC_DELTA_SPEED     0x10
+#define PDC_DELTA_HEADING   0x20
+
+#define PDC_LON_TURN        3600000000UL    // 360 degrees, 1e-7 degree
+#define PDC_LON_HALF_TURN   1800000000UL
+
+/*
+ * Framing.
+ *
+ * Everything written to the server is wrapped into frames, so the server
+ * reads exactly the bytes of each message:
+ *
+ *   offset size  field
+ *   0      1     type, PDC_FRAME_*
+ *   1      2     n, payload length, big-endian
+ *   3      n     payload
+ *
+ * PDC_FRAME_HELLO is the first frame of every connection, its payload is
+ * PDC_BINARY_VERSION followed by the terminal ID in ASCII.
+ * PDC_FRAME_REPORT holds a 4 byte big-endian sequence number followed by
+ * one report in any of the encodings above, told apart by its first byte.
+ * Sequence numbers grow by one per report and survive restarts, a report
+ * sent again after a lost connection keeps its number, so the server can
+ * drop duplicates.
+ *
+ * PDC_FRAME_BATCH holds several reports sent in one write, under
+ * consecutive sequence numbers: the 4 byte big-endian sequence number of
+ * the first one, then each report preceded by its length as a varint.
+ * The reports are what PDC_FRAME_REPORT would hold, so a batch costs the
+ * frame and sequence number once and one length byte per report.
+ *
+ * A report of no bytes, in either frame, stands for a queued report that
+ * could not be read back from flash. Its sequence number is taken like
+ * that of any other report, so the ACKs go on past it.
+ *
+ * The server answers with PDC_FRAME_ACK, its payload a 4 byte big-endian
+ * sequence number: every report up to and including it is stored and may
+ * be released by the terminal.
+ *
+ * Over UDP each datagram holds whole frames and starts with a hello frame,
+ * delta reports with a keyframe, so it can be read without the others.
+ * The server sends ACK frames back in datagrams as well.
+ *
+ * PDC_FRAME_CONFIG changes settings at runtime, its payload is text in the
+ * syntax of config.txt, "key = value;" lines. Only some keys may be set
+ * this way, see PosDetApp.c.
+ *
+ * PDC_FRAME_STATS goes to the server along with reports now and then, its
+ * payload holds counters and histograms of the terminal, see
+ * PosDetStats.h. It has no sequence number and is not acknowledged, one
+ * lost with its connection is not sent again.
+ */
+
+#define PDC_FRAME_HDR_SIZE  3
+#define PDC_REPORT_HDR_SIZE (PDC_FRAME_HDR_SIZE + 4)
+#define PDC_FRAME_HELLO     0x01
+#define PDC_FRAME_REPORT    0x02
+#define PDC_FRAME_ACK       0x03
+#define PDC_FRAME_CONFIG    0x04
+#define PDC_FRAME_STATS     0x05
+#define PDC_FRAME_BATCH     0x06
+#define PDC_BATCH_LEN_MAX   2   // varint length of a report in a batch
+
+/* GPS time counts from 1980-01-06, Unix time from 1970-01-01. */
+#define PDC_GPS_TO_UNIX_SECS    315964800UL
+
+typedef struct _PosDetFix {
+    uint32 dwTime;      // seconds since 1970-01-01 00:00:00 GMT
+    int32  nLat;        // 1e-7 degree
+    int32  nLon;        // 1e-7 degree
+    int16  nAlt;        // metre
+    uint16 wSpeed;      // 0.01 m/s
+    uint16 wHeading;    // 0.01 degree, 0 to 35999
+    uint8  flags;       // PDC_HAS_* bits
+} PosDetFix;
+
+typedef struct _PosDetDeltaCtx {
+    PosDetFix last;         // the previous fix sent
+    int32     nLastDt;      // seconds between the two previous fixes
+    uint16    nSinceKey;    // fixes sent since the last keyframe
+    uint16    nKeyInterval; // fixes between keyframes, 0 for no periodic one
+    boolean   bHaveKey;     // FALSE until a keyframe was sent
+} PosDetDeltaCtx;
+
+int32 PosDetCodec_ToFixed(double v, double scale);
+void PosDetCodec_MakeFix(PosDetFix *pFix, const AEEPositionInfoEx *pInfo,
+                         uint32 dwGpsTime);
+int  PosDetCodec_EncodeBinary(const PosDetFix *pFix, byte *pBuf, int nSize);
+int  PosDetCodec_DecodeBinary(const byte *pBuf, int nLen, PosDetFix *pFix);
+int  PosDetCodec_PutFrameHdr(byte *pBuf, byte type, uint16 nLen);
+int  PosDetCodec_PutReportHdr(byte *pBuf, uint32 dwSeq, uint16 nLen);
+int  PosDetCodec_PutBatchHdr(byte *pBuf, uint32 dwSeq, uint16 nLen);
+int  PosDetCodec_PutBatchLen(byte *pBuf, uint16 nLen);
+int  PosDetCodec_ParseFrame(const byte *pBuf, int nLen, byte *pType,
+                            const byte **ppPayload, uint16 *pnPayload);
+int  PosDetCodec_DecodeAck(const byte *pPayload, uint16 nLen, uint32 *pdwSeq);
+int  PosDetCodec_EncodeHello(const char *pszTerminalId, byte *pBuf,
+                             int nSize);
+void PosDetCodec_ResetDelta(PosDetDeltaCtx *pCtx, uint16 nKeyInterval);
+int  PosDetCodec_EncodeDelta(PosDetDeltaCtx *pCtx, const PosDetFix *pFix,
+                             const char *pszTerminalId, byte *pBuf,
+                             int nSize);
+
+#endif /* ifndef POSDETCODEC_H */
@@ -0,0 +1,44 @@
+#include "PosDetLatency.h"
+
+void
+PosDetLatency_Init(PosDetLatency *pl)
+{
+    MEMSET(pl, 0, sizeof(PosDetLatency));
+}
+
+/* Add a sample, the oldest one is dropped once the window is full. */
+void
+PosDetLatency_Add(PosDetLatency *pl, uint32 nMs)
+{
+    pl->samples[pl->nNext] = nMs;
+    pl->nNext = (uint8)((pl->nNext + 1) % PDLT_WINDOW);
+    if (pl->nCount < PDLT_WINDOW) {
+        pl->nCount++;
+    }
+}
+
+/* Returns the nPercent-th percentile of the window, the smallest sample
+ * not exceeded by nPercent percent of them, or 0 if there is none. */
+uint32
+PosDetLatency_Percentile(const PosDetLatency *pl, uint8 nPercent)
+{
+    uint32 sorted[PDLT_WINDOW];
+    uint32 n = 0;
+    int i, j;
+
+    if (0 == pl->nCount) {
+        return 0;
+    }
+
+    /* Insertion sort, the window is tiny. */
+    for (i = 0; i < pl->nCount; i++) {
+        n = pl->samples[i];
+        for (j = i; j > 0 && sorted[j - 1] > n; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = n;
+    }
+
+    i = (pl->nCount * MIN(nPercent, 100) + 99) / 100;
+    return sorted[MAX(i, 1) - 1];
+}
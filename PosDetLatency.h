@@ -0,0 +1,26 @@
+#ifndef POSDETLATENCY_H
+#define POSDETLATENCY_H
+
+#include "AEEStdLib.h"
+
+/*
+ * Percentiles of the last PDLT_WINDOW latencies, e.g. of GetGPSInfo
+ * requests, so that timeouts follow what the receiver does now rather
+ * than a worst case fixed at build time.
+ *
+ * The window is small, a percentile is taken by sorting a copy of it.
+ */
+
+#define PDLT_WINDOW         16
+
+typedef struct _PosDetLatency {
+    uint32 samples[PDLT_WINDOW];    // ms
+    uint8  nCount;                  // samples in the window
+    uint8  nNext;                   // where the next sample goes
+} PosDetLatency;
+
+void   PosDetLatency_Init(PosDetLatency *pl);
+void   PosDetLatency_Add(PosDetLatency *pl, uint32 nMs);
+uint32 PosDetLatency_Percentile(const PosDetLatency *pl, uint8 nPercent);
+
+#endif /* ifndef POSDETLATENCY_H */
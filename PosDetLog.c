@@ -0,0 +1,279 @@
+#include "PosDetLog.h"
+
+#define PDL_NEWLINE     "\r\n"
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+static void
+PutU32(byte *p, uint32 v)
+{
+    p[0] = (byte)(v & 0xFF);
+    p[1] = (byte)((v >> 8) & 0xFF);
+    p[2] = (byte)((v >> 16) & 0xFF);
+    p[3] = (byte)(v >> 24);
+}
+
+static uint32
+GetU32(const byte *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16)
+        | ((uint32)p[3] << 24);
+}
+
+static void
+PosDetLog_FileName(const PosDetLog *pLog, uint8 n, const char *pszExt,
+                   char *pszBuf)
+{
+    SNPRINTF(pszBuf, PDL_NAME_SIZE + 8, "%s%d%s", pLog->szName, n, pszExt);
+}
+
+static void
+PosDetLog_CloseFiles(PosDetLog *pLog)
+{
+    if (pLog->pFile) {
+        (void)IFILE_Release(pLog->pFile);
+        pLog->pFile = NULL;
+    }
+    if (pLog->pIndex) {
+        (void)IFILE_Release(pLog->pIndex);
+        pLog->pIndex = NULL;
+    }
+}
+
+/* Open pszFile for appending, creating it if needed. */
+static IFile *
+PosDetLog_OpenAppend(PosDetLog *pLog, const char *pszFile)
+{
+    if (IFILEMGR_Test(pLog->pIFileMgr, pszFile) != SUCCESS) {
+        return IFILEMGR_OpenFile(pLog->pIFileMgr, pszFile, _OFM_CREATE);
+    }
+    return IFILEMGR_OpenFile(pLog->pIFileMgr, pszFile, _OFM_APPEND);
+}
+
+/* Open log file number pLog->nCur and its index, emptied if bEmpty. */
+static int
+PosDetLog_OpenFiles(PosDetLog *pLog, boolean bEmpty)
+{
+    char szFile[PDL_NAME_SIZE + 8];
+    char szIndex[PDL_NAME_SIZE + 8];
+    AEEFileInfo fileInfo;
+    int err = SUCCESS;
+
+    PosDetLog_FileName(pLog, pLog->nCur, ".txt", szFile);
+    PosDetLog_FileName(pLog, pLog->nCur, ".idx", szIndex);
+
+    if (bEmpty) {
+        (void)IFILEMGR_Remove(pLog->pIFileMgr, szFile);
+        (void)IFILEMGR_Remove(pLog->pIFileMgr, szIndex);
+    }
+
+    /* The error of the index would hide that of the log file. */
+    pLog->pFile = PosDetLog_OpenAppend(pLog, szFile);
+    if (NULL == pLog->pFile) {
+        err = IFILEMGR_GetLastError(pLog->pIFileMgr);
+    }
+    else {
+        pLog->pIndex = PosDetLog_OpenAppend(pLog, szIndex);
+        if (NULL == pLog->pIndex) {
+            err = IFILEMGR_GetLastError(pLog->pIFileMgr);
+        }
+    }
+    if (NULL == pLog->pFile || NULL == pLog->pIndex) {
+        PosDetLog_CloseFiles(pLog);
+        return SUCCESS == err ? EFAILED : err;
+    }
+
+    pLog->bEmptyDue = FALSE;
+    pLog->nFileSize = 0;
+    if (IFILE_GetInfo(pLog->pFile, &fileInfo) == SUCCESS) {
+        pLog->nFileSize = fileInfo.dwSize;
+    }
+    return SUCCESS;
+}
+
+/* Returns TRUE and the time of the last block in *pdwTime if log file
+ * number n has a non-empty index. */
+static boolean
+PosDetLog_LastTime(PosDetLog *pLog, uint8 n, uint32 *pdwTime)
+{
+    char szIndex[PDL_NAME_SIZE + 8];
+    byte entry[PDL_INDEX_ENTRY_SIZE];
+    AEEFileInfo fileInfo;
+    IFile *pIndex = NULL;
+    boolean bFound = FALSE;
+
+    PosDetLog_FileName(pLog, n, ".idx", szIndex);
+    if (IFILEMGR_Test(pLog->pIFileMgr, szIndex) != SUCCESS) {
+        return FALSE;
+    }
+    pIndex = IFILEMGR_OpenFile(pLog->pIFileMgr, szIndex, _OFM_READ);
+    if (NULL == pIndex) {
+        return FALSE;
+    }
+
+    if (IFILE_GetInfo(pIndex, &fileInfo) == SUCCESS
+        && fileInfo.dwSize >= PDL_INDEX_ENTRY_SIZE
+        && IFILE_Seek(pIndex, _SEEK_START,
+                      (int32)(fileInfo.dwSize - fileInfo.dwSize
+                              % PDL_INDEX_ENTRY_SIZE
+                              - PDL_INDEX_ENTRY_SIZE)) == SUCCESS
+        && IFILE_Read(pIndex, entry, sizeof(entry)) == sizeof(entry)) {
+        *pdwTime = GetU32(entry);
+        bFound = TRUE;
+    }
+
+    (void)IFILE_Release(pIndex);
+    return bFound;
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+/* Open the log, continuing in the most recently written file.
+ * pIFileMgr must stay valid until PosDetLog_Close(). */
+int
+PosDetLog_Open(PosDetLog *pLog, IFileMgr *pIFileMgr, const char *pszName,
+               uint8 nFiles, uint32 nMaxFileSize)
+{
+    uint32 dwTime = 0;
+    uint32 dwLatest = 0;
+    boolean bFound = FALSE;
+    uint8 i;
+
+    if (!pLog || !pIFileMgr || 0 == nFiles || nFiles > PDL_MAX_FILES
+        || nMaxFileSize < PDL_BUF_SIZE || STRLEN(pszName) >= PDL_NAME_SIZE) {
+        return EBADPARM;
+    }
+
+    MEMSET(pLog, 0, sizeof(PosDetLog));
+    pLog->pIFileMgr = pIFileMgr;
+    pLog->nFiles = nFiles;
+    pLog->nMaxFileSize = nMaxFileSize;
+    STRLCPY(pLog->szName, pszName, PDL_NAME_SIZE);
+
+    for (i = 0; i < nFiles; i++) {
+        if (PosDetLog_LastTime(pLog, i, &dwTime)
+            && (!bFound || (int32)(dwTime - dwLatest) >= 0)) {
+            dwLatest = dwTime;
+            pLog->nCur = i;
+            bFound = TRUE;
+        }
+    }
+
+    return PosDetLog_OpenFiles(pLog, FALSE);
+}
+
+/* Flush the buffer and close the files. */
+void
+PosDetLog_Close(PosDetLog *pLog)
+{
+    if (pLog->pIFileMgr) {
+        (void)PosDetLog_Flush(pLog);
+    }
+    PosDetLog_CloseFiles(pLog);
+    pLog->pIFileMgr = NULL;
+}
+
+/* Append a line, "\r\n" is added. The buffer is flushed first if the line
+ * does not fit in. */
+int
+PosDetLog_Write(PosDetLog *pLog, uint32 dwTime, const char *pLine,
+                uint16 nLen)
+{
+    uint16 nNeed = (uint16)(nLen + STRLEN(PDL_NEWLINE));
+    int err = SUCCESS;
+
+    if (NULL == pLog->pIFileMgr) {
+        return EBADSTATE;
+    }
+    if (nNeed > PDL_BUF_SIZE) {
+        return EBADPARM;
+    }
+
+    if (pLog->nLen + nNeed > PDL_BUF_SIZE) {
+        err = PosDetLog_Flush(pLog);
+        /* A failed write keeps its lines for the next flush, unless new
+         * lines need the room. */
+        if (pLog->nLen + nNeed > PDL_BUF_SIZE) {
+            pLog->nLen = 0;
+        }
+    }
+
+    if (0 == pLog->nLen) {
+        pLog->dwBufTime = dwTime;
+    }
+    MEMCPY(pLog->buf + pLog->nLen, pLine, nLen);
+    MEMCPY(pLog->buf + pLog->nLen + nLen, PDL_NEWLINE, STRLEN(PDL_NEWLINE));
+    pLog->nLen = (uint16)(pLog->nLen + nNeed);
+
+    return err;
+}
+
+/* Write the buffered lines as one block, moving on to the next file first if
+ * the block does not fit in the current one. The bytes a failed write left
+ * out stay in the buffer and go first in the next flush, those written are
+ * not written again. */
+int
+PosDetLog_Flush(PosDetLog *pLog)
+{
+    byte entry[PDL_INDEX_ENTRY_SIZE];
+    uint32 nLen = pLog->nLen;
+    uint32 nWritten = 0;
+    int err = SUCCESS;
+
+    if (NULL == pLog->pIFileMgr) {
+        return EBADSTATE;
+    }
+    if (0 == nLen) {
+        return SUCCESS;
+    }
+    pLog->nLen = 0;
+
+    /* The files failed to open last time, try again. */
+    if (NULL == pLog->pFile) {
+        err = PosDetLog_OpenFiles(pLog, pLog->bEmptyDue);
+        if (SUCCESS != err) {
+            return err;
+        }
+    }
+
+    if (pLog->nFileSize > 0 && pLog->nFileSize + nLen > pLog->nMaxFileSize) {
+        PosDetLog_CloseFiles(pLog);
+        pLog->nCur = (uint8)((pLog->nCur + 1) % pLog->nFiles);
+        err = PosDetLog_OpenFiles(pLog, TRUE);
+        if (SUCCESS != err) {
+            pLog->bEmptyDue = TRUE;
+            return err;
+        }
+    }
+
+    PutU32(entry, pLog->dwBufTime);
+    PutU32(entry + 4, pLog->nFileSize);
+
+    /* The file grows by what was written, even by part of the block, or
+     * the entries of later blocks would point before their lines. */
+    nWritten = IFILE_Write(pLog->pFile, pLog->buf, nLen);
+    pLog->nFileSize += nWritten;
+    if (nWritten < nLen) {
+        err = IFILEMGR_GetLastError(pLog->pIFileMgr);
+        if (SUCCESS == err) {
+            err = EFAILED;
+        }
+        MEMMOVE(pLog->buf, pLog->buf + nWritten, nLen - nWritten);
+        pLog->nLen = (uint16)(nLen - nWritten);
+        if (0 == nWritten) {
+            return err;
+        }
+    }
+
+    /* The block is indexed only once it is written, so an entry never
+     * points past the end of the log file. */
+    if (IFILE_Write(pLog->pIndex, entry, sizeof(entry)) != sizeof(entry)) {
+        return IFILEMGR_GetLastError(pLog->pIFileMgr);
+    }
+
+    return err;
+}
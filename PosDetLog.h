@@ -0,0 +1,61 @@
+#ifndef POSDETLOG_H
+#define POSDETLOG_H
+
+#include "AEEStdLib.h"
+#include "AEEFile.h"
+
+/*
+ * Buffered, rotating log of text lines.
+ *
+ * Lines are collected in memory and written to flash in one block when the
+ * buffer is full or PosDetLog_Flush() is called, e.g. from a timer.
+ *
+ * The log spreads over nFiles files "<name>0.txt" ... "<name>N.txt", used in
+ * turn. A block that would grow the current file past nMaxFileSize goes to
+ * the next file, which is emptied first, so the log never takes more than
+ * nFiles * nMaxFileSize bytes.
+ *
+ * Each log file has an index "<name>N.idx" with one entry per block:
+ *
+ *   offset size  field
+ *   0      4     time of the first line of the block, as given to Write
+ *   4      4     offset of the block in the log file
+ *
+ * both little-endian, so a time window can be read without scanning the
+ * whole log. On open, logging continues in the file whose index ends with
+ * the latest time.
+ *
+ * A log file that can't be opened, e.g. when moving on to the next one, is
+ * tried again on the next flush. The lines of the blocks flushed meanwhile
+ * are lost. The part of a block a write left out is written by the next
+ * flush, as long as new lines leave room for it in the buffer.
+ */
+
+#define PDL_BUF_SIZE        2048
+#define PDL_MAX_FILES       8
+#define PDL_INDEX_ENTRY_SIZE 8
+#define PDL_NAME_SIZE       32
+
+typedef struct _PosDetLog {
+    IFileMgr *pIFileMgr;    // not owned
+    IFile    *pFile;        // current log file
+    IFile    *pIndex;       // index of the current log file
+    char      szName[PDL_NAME_SIZE];
+    uint32    nFileSize;    // bytes in the current log file
+    uint32    nMaxFileSize;
+    uint32    dwBufTime;    // time of the first line in buf
+    uint16    nLen;         // bytes in buf
+    uint8     nFiles;
+    uint8     nCur;         // number of the current log file
+    boolean   bEmptyDue;    // nCur is to be emptied when it is opened
+    char      buf[PDL_BUF_SIZE];
+} PosDetLog;
+
+int  PosDetLog_Open(PosDetLog *pLog, IFileMgr *pIFileMgr, const char *pszName,
+                    uint8 nFiles, uint32 nMaxFileSize);
+void PosDetLog_Close(PosDetLog *pLog);
+int  PosDetLog_Write(PosDetLog *pLog, uint32 dwTime, const char *pLine,
+                     uint16 nLen);
+int  PosDetLog_Flush(PosDetLog *pLog);
+
+#endif /* ifndef POSDETLOG_H */
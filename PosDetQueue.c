@@ -0,0 +1,319 @@
+#include "PosDetQueue.h"
+
+#define PDQ_MAGIC   0x31514450  /* "PDQ1" */
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+static void
+PutU16(byte *p, uint16 v)
+{
+    p[0] = (byte)(v & 0xFF);
+    p[1] = (byte)(v >> 8);
+}
+
+static void
+PutU32(byte *p, uint32 v)
+{
+    p[0] = (byte)(v & 0xFF);
+    p[1] = (byte)((v >> 8) & 0xFF);
+    p[2] = (byte)((v >> 16) & 0xFF);
+    p[3] = (byte)(v >> 24);
+}
+
+static uint16
+GetU16(const byte *p)
+{
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32
+GetU32(const byte *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16)
+        | ((uint32)p[3] << 24);
+}
+
+/* Fletcher-16 over the given bytes. */
+static uint16
+PosDetQueue_Sum(const byte *p, uint32 nLen)
+{
+    uint16 s1 = 0xFF;
+    uint16 s2 = 0xFF;
+
+    while (nLen--) {
+        s1 = (uint16)((s1 + *p++) % 255);
+        s2 = (uint16)((s2 + s1) % 255);
+    }
+    return (uint16)((s2 << 8) | s1);
+}
+
+static int32
+PosDetQueue_SlotOffset(const PosDetQueue *pq, uint32 seq)
+{
+    return (int32)(2 * PDQ_HDR_SIZE
+                   + (seq % pq->slotCount)
+                     * (uint32)(PDQ_SLOT_HDR_SIZE + pq->slotSize));
+}
+
+static int
+PosDetQueue_WriteAt(PosDetQueue *pq, int32 nOffset, const void *p,
+                    uint32 nLen)
+{
+    if (IFILE_Seek(pq->pFile, _SEEK_START, nOffset) != SUCCESS) {
+        return EFAILED;
+    }
+    if (IFILE_Write(pq->pFile, p, nLen) != nLen) {
+        return EFAILED;
+    }
+    return SUCCESS;
+}
+
+static int
+PosDetQueue_ReadAt(PosDetQueue *pq, int32 nOffset, void *p, uint32 nLen)
+{
+    if (IFILE_Seek(pq->pFile, _SEEK_START, nOffset) != SUCCESS) {
+        return EFAILED;
+    }
+    if (IFILE_Read(pq->pFile, p, nLen) != (int32)nLen) {
+        return EFAILED;
+    }
+    return SUCCESS;
+}
+
+/* Write the head/tail markers into the header copy not holding the last
+ * committed state. Only after this returns SUCCESS does a push or pop
+ * become durable. */
+static int
+PosDetQueue_Commit(PosDetQueue *pq, uint32 head, uint32 tail)
+{
+    byte hdr[PDQ_HDR_SIZE];
+    uint32 gen = pq->gen + 1;
+
+    MEMSET(hdr, 0, sizeof(hdr));
+    PutU32(hdr + 0, PDQ_MAGIC);
+    PutU32(hdr + 4, gen);
+    PutU32(hdr + 8, head);
+    PutU32(hdr + 12, tail);
+    PutU16(hdr + 16, pq->slotSize);
+    PutU16(hdr + 18, pq->slotCount);
+    PutU16(hdr + 20, PosDetQueue_Sum(hdr, 20));
+
+    if (PosDetQueue_WriteAt(pq, (int32)((gen & 1) * PDQ_HDR_SIZE), hdr,
+                            sizeof(hdr)) != SUCCESS) {
+        return EFAILED;
+    }
+
+    pq->gen = gen;
+    pq->head = head;
+    pq->tail = tail;
+    return SUCCESS;
+}
+
+/* Returns TRUE if the header is intact and matches the queue geometry. */
+static boolean
+PosDetQueue_ParseHdr(const PosDetQueue *pq, const byte *hdr, uint32 *pGen,
+                     uint32 *pHead, uint32 *pTail)
+{
+    if (GetU32(hdr) != PDQ_MAGIC
+        || GetU16(hdr + 20) != PosDetQueue_Sum(hdr, 20)
+        || GetU16(hdr + 16) != pq->slotSize
+        || GetU16(hdr + 18) != pq->slotCount) {
+        return FALSE;
+    }
+
+    *pGen = GetU32(hdr + 4);
+    *pHead = GetU32(hdr + 8);
+    *pTail = GetU32(hdr + 12);
+
+    return (*pTail - *pHead) <= pq->slotCount;
+}
+
+/* Size an empty queue file to its full length, so later writes never need
+ * to grow the file. The slots are not cleared: only records between head
+ * and tail are ever read, and each one carries its own checksum. */
+static int
+PosDetQueue_Format(PosDetQueue *pq)
+{
+    byte zero = 0;
+    uint32 nTotal = 2 * PDQ_HDR_SIZE
+        + (uint32)pq->slotCount * (PDQ_SLOT_HDR_SIZE + pq->slotSize);
+
+    (void)IFILE_Truncate(pq->pFile, 0);
+    if (PosDetQueue_WriteAt(pq, (int32)(nTotal - 1), &zero, 1) != SUCCESS) {
+        return EFAILED;
+    }
+
+    pq->gen = 0;
+    return PosDetQueue_Commit(pq, 0, 0);
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+/* Open the queue file, creating and formatting it if it does not exist or
+ * does not match the requested geometry. */
+int
+PosDetQueue_Open(PosDetQueue *pq, IFileMgr *pIFileMgr, const char *pszFile,
+                 uint16 slotSize, uint16 slotCount)
+{
+    byte hdrA[PDQ_HDR_SIZE];
+    byte hdrB[PDQ_HDR_SIZE];
+    uint32 genA, headA, tailA;
+    uint32 genB, headB, tailB;
+    boolean bA = FALSE;
+    boolean bB = FALSE;
+
+    if (!pq || !pIFileMgr || 0 == slotSize || slotSize > PDQ_MAX_SLOT_SIZE
+        || 0 == slotCount) {
+        return EBADPARM;
+    }
+
+    MEMSET(pq, 0, sizeof(PosDetQueue));
+    pq->slotSize = slotSize;
+    pq->slotCount = slotCount;
+
+    if (IFILEMGR_Test(pIFileMgr, pszFile) != SUCCESS) {
+        pq->pFile = IFILEMGR_OpenFile(pIFileMgr, pszFile, _OFM_CREATE);
+        if (NULL == pq->pFile) {
+            return IFILEMGR_GetLastError(pIFileMgr);
+        }
+        return PosDetQueue_Format(pq);
+    }
+
+    pq->pFile = IFILEMGR_OpenFile(pIFileMgr, pszFile, _OFM_READWRITE);
+    if (NULL == pq->pFile) {
+        return IFILEMGR_GetLastError(pIFileMgr);
+    }
+
+    if (PosDetQueue_ReadAt(pq, 0, hdrA, sizeof(hdrA)) == SUCCESS) {
+        bA = PosDetQueue_ParseHdr(pq, hdrA, &genA, &headA, &tailA);
+    }
+    if (PosDetQueue_ReadAt(pq, PDQ_HDR_SIZE, hdrB, sizeof(hdrB)) == SUCCESS) {
+        bB = PosDetQueue_ParseHdr(pq, hdrB, &genB, &headB, &tailB);
+    }
+
+    if (bA && (!bB || (int32)(genA - genB) > 0)) {
+        pq->gen = genA;
+        pq->head = headA;
+        pq->tail = tailA;
+    }
+    else if (bB) {
+        pq->gen = genB;
+        pq->head = headB;
+        pq->tail = tailB;
+    }
+    else {
+        DBGPRINTF("Queue %s unreadable, formatting", pszFile);
+        return PosDetQueue_Format(pq);
+    }
+
+    return SUCCESS;
+}
+
+void
+PosDetQueue_Close(PosDetQueue *pq)
+{
+    if (pq->pFile) {
+        (void)IFILE_Release(pq->pFile);
+        pq->pFile = NULL;
+    }
+}
+
+uint32
+PosDetQueue_Count(const PosDetQueue *pq)
+{
+    return pq->tail - pq->head;
+}
+
+/* Sequence number of the oldest record, or of the next record to push if
+ * the queue is empty. The nIndex-th oldest record has HeadSeq() + nIndex. */
+uint32
+PosDetQueue_HeadSeq(const PosDetQueue *pq)
+{
+    return pq->head;
+}
+
+/* Append a record. If the queue is full, the oldest record is dropped
+ * first: its slot is about to be reused, and a crash between the slot write
+ * and the commit must not leave the new record readable under the old
+ * record's sequence number. */
+int
+PosDetQueue_Push(PosDetQueue *pq, const void *pData, uint16 nLen)
+{
+    byte slot[PDQ_SLOT_HDR_SIZE + PDQ_MAX_SLOT_SIZE];
+
+    if (NULL == pq->pFile) {
+        return EBADSTATE;
+    }
+    if (nLen > pq->slotSize) {
+        return EBADPARM;
+    }
+
+    if (PosDetQueue_Count(pq) >= pq->slotCount
+        && PosDetQueue_Commit(pq, pq->head + 1, pq->tail) != SUCCESS) {
+        return EFAILED;
+    }
+
+    PutU16(slot, nLen);
+    PutU16(slot + 2, PosDetQueue_Sum((const byte*)pData, nLen));
+    MEMCPY(slot + PDQ_SLOT_HDR_SIZE, pData, nLen);
+
+    if (PosDetQueue_WriteAt(pq, PosDetQueue_SlotOffset(pq, pq->tail), slot,
+                            PDQ_SLOT_HDR_SIZE + (uint32)nLen) != SUCCESS) {
+        return EFAILED;
+    }
+
+    return PosDetQueue_Commit(pq, pq->head, pq->tail + 1);
+}
+
+/* Copy the nIndex-th oldest record into pBuf. */
+int
+PosDetQueue_Peek(PosDetQueue *pq, uint32 nIndex, void *pBuf, uint16 nBufSize,
+                 uint16 *pnLen)
+{
+    byte slotHdr[PDQ_SLOT_HDR_SIZE];
+    uint16 nLen;
+
+    if (NULL == pq->pFile) {
+        return EBADSTATE;
+    }
+    if (nIndex >= PosDetQueue_Count(pq)) {
+        return EBADPARM;
+    }
+
+    if (PosDetQueue_ReadAt(pq, PosDetQueue_SlotOffset(pq, pq->head + nIndex),
+                           slotHdr, sizeof(slotHdr)) != SUCCESS) {
+        return EFAILED;
+    }
+
+    nLen = GetU16(slotHdr);
+    if (nLen > pq->slotSize || nLen > nBufSize) {
+        return EFAILED;
+    }
+    if (IFILE_Read(pq->pFile, pBuf, nLen) != (int32)nLen
+        || GetU16(slotHdr + 2) != PosDetQueue_Sum((const byte*)pBuf, nLen)) {
+        return EFAILED;
+    }
+
+    *pnLen = nLen;
+    return SUCCESS;
+}
+
+/* Release the nCount oldest records. */
+int
+PosDetQueue_Pop(PosDetQueue *pq, uint32 nCount)
+{
+    if (NULL == pq->pFile) {
+        return EBADSTATE;
+    }
+
+    nCount = MIN(nCount, PosDetQueue_Count(pq));
+    if (0 == nCount) {
+        return SUCCESS;
+    }
+
+    return PosDetQueue_Commit(pq, pq->head + nCount, pq->tail);
+}
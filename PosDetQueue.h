@@ -0,0 +1,54 @@
+#ifndef POSDETQUEUE_H
+#define POSDETQUEUE_H
+
+#include "AEEStdLib.h"
+#include "AEEFile.h"
+
+/*
+ * A fixed size FIFO of records kept in a flash file, used to store reports
+ * while the uplink is down.
+ *
+ * File layout:
+ *   [header A][header B][slot 0][slot 1] ... [slot slotCount-1]
+ *
+ * The head/tail markers live in two header copies that are written
+ * alternately, each one carrying a generation number and a checksum. A
+ * crash while writing a header can only corrupt the copy being written, so
+ * on open the valid copy with the higher generation wins and the queue comes
+ * back in the last committed state. A record is written into its slot before
+ * the header that makes it visible, so a torn record is never read back.
+ *
+ * When the queue is full, pushing a new record drops the oldest one. The
+ * drop is committed before the slot is overwritten, so the reused slot is
+ * never visible while it is being written.
+ *
+ * Each record has a sequence number, one more than the record pushed
+ * before it. The numbers are kept in the headers, so they keep growing
+ * across restarts.
+ */
+
+#define PDQ_HDR_SIZE        32
+#define PDQ_SLOT_HDR_SIZE   4   // uint16 length + uint16 checksum
+#define PDQ_MAX_SLOT_SIZE   256 // largest slotSize PosDetQueue_Open accepts
+
+typedef struct _PosDetQueue {
+    IFile  *pFile;
+    uint32  gen;        // generation of the last committed header
+    uint32  head;       // sequence number of the oldest record
+    uint32  tail;       // sequence number of the next record to push
+    uint16  slotSize;   // max payload bytes per record
+    uint16  slotCount;  // number of slots in the ring
+} PosDetQueue;
+
+int    PosDetQueue_Open(PosDetQueue *pq, IFileMgr *pIFileMgr,
+                        const char *pszFile, uint16 slotSize,
+                        uint16 slotCount);
+void   PosDetQueue_Close(PosDetQueue *pq);
+int    PosDetQueue_Push(PosDetQueue *pq, const void *pData, uint16 nLen);
+int    PosDetQueue_Peek(PosDetQueue *pq, uint32 nIndex, void *pBuf,
+                        uint16 nBufSize, uint16 *pnLen);
+int    PosDetQueue_Pop(PosDetQueue *pq, uint32 nCount);
+uint32 PosDetQueue_Count(const PosDetQueue *pq);
+uint32 PosDetQueue_HeadSeq(const PosDetQueue *pq);
+
+#endif /* ifndef POSDETQUEUE_H */
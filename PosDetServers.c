@@ -0,0 +1,73 @@
+#include "PosDetServers.h"
+
+void
+PosDetServers_Init(PosDetServers *pSL, uint8 nMaxTry)
+{
+    MEMSET(pSL, 0, sizeof(PosDetServers));
+    pSL->nMaxTry = MAX(nMaxTry, 1);
+}
+
+/* Append a server, the first one added is the primary.
+ * Returns SUCCESS, or EBADPARM if the list is full. */
+int
+PosDetServers_Add(PosDetServers *pSL, const AEESockAddrStorage *pAddr)
+{
+    if (pSL->nServers >= PDSV_MAX_SERVERS) {
+        return EBADPARM;
+    }
+    MEMSET(&pSL->servers[pSL->nServers], 0, sizeof(PosDetServer));
+    pSL->servers[pSL->nServers].addr = *pAddr;
+    pSL->nServers++;
+    return SUCCESS;
+}
+
+/* The server to connect to. The list must not be empty. */
+const AEESockAddrStorage *
+PosDetServers_Current(const PosDetServers *pSL)
+{
+    return &pSL->servers[pSL->nCur].addr;
+}
+
+/* Count a failed try on the current server, moving on to the next one
+ * after nMaxTry of them. Returns TRUE if every server failed in this
+ * round, the next round starts over from the primary. */
+boolean
+PosDetServers_Failed(PosDetServers *pSL)
+{
+    PosDetServer *pServer = &pSL->servers[pSL->nCur];
+
+    if (pServer->nFailures < 0xFFFF) {
+        pServer->nFailures++;
+    }
+    if (++pSL->nTries < pSL->nMaxTry) {
+        return FALSE;
+    }
+
+    pSL->nTries = 0;
+    pSL->nCur = (uint8)((pSL->nCur + 1) % pSL->nServers);
+    if (++pSL->nRound < pSL->nServers) {
+        return FALSE;
+    }
+
+    pSL->nRound = 0;
+    pSL->nCur = 0;
+    return TRUE;
+}
+
+/* The current server accepted a connection. */
+void
+PosDetServers_Connected(PosDetServers *pSL)
+{
+    pSL->servers[pSL->nCur].nFailures = 0;
+    pSL->nTries = 0;
+    pSL->nRound = 0;
+}
+
+/* Go back to the primary, e.g. some time after failing over. */
+void
+PosDetServers_UsePrimary(PosDetServers *pSL)
+{
+    pSL->nCur = 0;
+    pSL->nTries = 0;
+    pSL->nRound = 0;
+}
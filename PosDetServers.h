@@ -0,0 +1,42 @@
+#ifndef POSDETSERVERS_H
+#define POSDETSERVERS_H
+
+#include "AEEStdLib.h"
+#include "AEESockPort.h"
+
+/*
+ * Ordered list of the servers reports may be sent to.
+ *
+ * The first server is the primary, the others are backups. Connecting
+ * starts with the primary. After nMaxTry failed tries in a row the next
+ * server is tried, and after the last one the primary again; a failed round
+ * through the whole list is what the caller backs off on.
+ *
+ * Each server counts its failed tries in a row, cleared when a connection
+ * to it succeeds, so the health of every server can be told apart.
+ */
+
+#define PDSV_MAX_SERVERS    4
+
+typedef struct _PosDetServer {
+    AEESockAddrStorage addr;
+    uint16             nFailures;   // failed tries in a row
+} PosDetServer;
+
+typedef struct _PosDetServers {
+    PosDetServer servers[PDSV_MAX_SERVERS];
+    uint8        nServers;
+    uint8        nCur;      // server being tried or connected to
+    uint8        nTries;    // failed tries on nCur in a row
+    uint8        nMaxTry;   // tries on a server before moving on
+    uint8        nRound;    // servers given up on in this round
+} PosDetServers;
+
+void    PosDetServers_Init(PosDetServers *pSL, uint8 nMaxTry);
+int     PosDetServers_Add(PosDetServers *pSL, const AEESockAddrStorage *pAddr);
+const AEESockAddrStorage *PosDetServers_Current(const PosDetServers *pSL);
+boolean PosDetServers_Failed(PosDetServers *pSL);
+void    PosDetServers_Connected(PosDetServers *pSL);
+void    PosDetServers_UsePrimary(PosDetServers *pSL);
+
+#endif /* ifndef POSDETSERVERS_H */
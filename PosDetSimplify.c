@@ -0,0 +1,191 @@
+#include "PosDetSimplify.h"
+
+#define PDS_M_PER_UNIT      0.0111319       // metre per 1e-7 degree latitude
+#define PDS_RAD_PER_UNIT    1.74532925e-9   // radian per 1e-7 degree
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+/* Taylor series of cos(x), good to 1e-3 for |x| <= pi/2, which is all a
+ * latitude needs. */
+static double
+PosDetSimplify_Cos(double x)
+{
+    double x2 = FMUL(x, x);
+    double x4 = FMUL(x2, x2);
+
+    return FADD(FSUB(1.0, FDIV(x2, 2.0)),
+                FSUB(FDIV(x4, 24.0), FDIV(FMUL(x4, x2), 720.0)));
+}
+
+/* Returns TRUE if pX lies within the tolerance of the segment pA->pB.
+ * kLon is metre per 1e-7 degree longitude around pA. */
+static boolean
+PosDetSimplify_Within(const PosDetSimplify *pS, double kLon,
+                      const PosDetFix *pA, const PosDetFix *pB,
+                      const PosDetFix *pX)
+{
+    double bx = FMUL(FSUB(pB->nLon, pA->nLon), kLon);
+    double by = FMUL(FSUB(pB->nLat, pA->nLat), PDS_M_PER_UNIT);
+    double px = FMUL(FSUB(pX->nLon, pA->nLon), kLon);
+    double py = FMUL(FSUB(pX->nLat, pA->nLat), PDS_M_PER_UNIT);
+    double len2 = FADD(FMUL(bx, bx), FMUL(by, by));
+    double tol = FASSIGN_INT(pS->nTolerance);
+    double t = 0.0;
+
+    /* Distance to the nearest point of the segment, so a fix behind the
+     * anchor or beyond pB, as on a U-turn, is measured to the end point. */
+    if (FCMP_G(len2, 0.0)) {
+        t = FDIV(FADD(FMUL(px, bx), FMUL(py, by)), len2);
+        if (FCMP_L(t, 0.0)) {
+            t = 0.0;
+        }
+        else if (FCMP_G(t, 1.0)) {
+            t = 1.0;
+        }
+        px = FSUB(px, FMUL(t, bx));
+        py = FSUB(py, FMUL(t, by));
+    }
+
+    return FCMP_LE(FADD(FMUL(px, px), FMUL(py, py)), FMUL(tol, tol));
+}
+
+/* Returns TRUE if the candidate and every fix dropped before it lie within
+ * the tolerance of the segment anchor->pFix. */
+static boolean
+PosDetSimplify_Covers(const PosDetSimplify *pS, const PosDetFix *pFix)
+{
+    double kLon = FMUL(PDS_M_PER_UNIT,
+                       PosDetSimplify_Cos(FMUL(pS->anchor.nLat,
+                                               PDS_RAD_PER_UNIT)));
+    uint16 i;
+
+    if (!PosDetSimplify_Within(pS, kLon, &pS->anchor, pFix, &pS->cand)) {
+        return FALSE;
+    }
+    for (i = 0; i < pS->nWindow; i++) {
+        if (!PosDetSimplify_Within(pS, kLon, &pS->anchor, pFix,
+                                   &pS->window[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static boolean
+PosDetSimplify_IsStopped(const PosDetFix *pFix)
+{
+    return (pFix->flags & PDC_HAS_SPEED) && pFix->wSpeed < PDS_STOP_SPEED;
+}
+
+/* Returns TRUE if pFix must be kept whatever the geometry says. */
+static boolean
+PosDetSimplify_IsFeature(const PosDetSimplify *pS, const PosDetFix *pFix)
+{
+    const PosDetFix *pA = &pS->anchor;
+    boolean bStopped = PosDetSimplify_IsStopped(pFix);
+    int32 dHeading = 0;
+
+    if (!(pFix->flags & PDC_HAS_POS) || pFix->flags != pA->flags) {
+        return TRUE;
+    }
+    if (pS->nMaxGap && pFix->dwTime - pA->dwTime >= pS->nMaxGap) {
+        return TRUE;
+    }
+    if (bStopped != PosDetSimplify_IsStopped(pA)) {
+        return TRUE;
+    }
+
+    /* Heading is noise when standing still. */
+    if (!bStopped && (pFix->flags & PDC_HAS_HEADING)) {
+        dHeading = (int32)pFix->wHeading - (int32)pA->wHeading;
+        if (dHeading < 0) {
+            dHeading = -dHeading;
+        }
+        if (dHeading > 18000) {
+            dHeading = 36000 - dHeading;
+        }
+        if (dHeading >= PDS_TURN_ANGLE) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Make pFix the anchor and forget the fixes dropped before it. */
+static void
+PosDetSimplify_Anchor(PosDetSimplify *pS, const PosDetFix *pFix)
+{
+    pS->anchor = *pFix;
+    pS->bAnchor = TRUE;
+    pS->nWindow = 0;
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+void
+PosDetSimplify_Init(PosDetSimplify *pS, uint16 nTolerance, uint16 nMaxGap)
+{
+    MEMSET(pS, 0, sizeof(PosDetSimplify));
+    pS->nTolerance = nTolerance;
+    pS->nMaxGap = nMaxGap;
+}
+
+/* Feed the next fix of the track. The fixes to keep, oldest first, are
+ * copied to pOut, which must have room for PDS_MAX_OUT fixes.
+ * Returns the number of fixes copied. */
+int
+PosDetSimplify_Add(PosDetSimplify *pS, const PosDetFix *pFix,
+                   PosDetFix *pOut)
+{
+    int n = 0;
+
+    if (0 == pS->nTolerance) {
+        pOut[0] = *pFix;
+        return 1;
+    }
+
+    if (!pS->bAnchor || PosDetSimplify_IsFeature(pS, pFix)) {
+        if (pS->bCand) {
+            pOut[n++] = pS->cand;
+            pS->bCand = FALSE;
+        }
+        pOut[n++] = *pFix;
+        PosDetSimplify_Anchor(pS, pFix);
+        return n;
+    }
+
+    if (pS->bCand) {
+        if (pS->nWindow >= PDS_WINDOW_SIZE
+            || !PosDetSimplify_Covers(pS, pFix)) {
+            pOut[n++] = pS->cand;
+            PosDetSimplify_Anchor(pS, &pS->cand);
+        }
+        else {
+            pS->window[pS->nWindow++] = pS->cand;
+        }
+    }
+
+    pS->cand = *pFix;
+    pS->bCand = TRUE;
+    return n;
+}
+
+/* Keep the candidate, if any, e.g. when the application stops.
+ * Returns the number of fixes copied to pOut, 0 or 1. */
+int
+PosDetSimplify_Flush(PosDetSimplify *pS, PosDetFix *pOut)
+{
+    if (!pS->bCand) {
+        return 0;
+    }
+
+    pOut[0] = pS->cand;
+    pS->bCand = FALSE;
+    PosDetSimplify_Anchor(pS, pOut);
+    return 1;
+}
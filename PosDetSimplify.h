@@ -0,0 +1,49 @@
+#ifndef POSDETSIMPLIFY_H
+#define POSDETSIMPLIFY_H
+
+#include "AEEStdLib.h"
+#include "PosDetCodec.h"
+
+/*
+ * Online line simplification of the track, run on every fix before it is
+ * reported.
+ *
+ * The last kept fix is the anchor. A new fix P is tested against the fixes
+ * seen since the anchor: if every one of them lies within the tolerance of
+ * the segment anchor->P, they are not needed to draw the track and P only
+ * becomes the candidate. Otherwise the candidate, the previous fix, is kept
+ * and becomes the new anchor. This is the opening window variant of
+ * Douglas-Peucker, it keeps at most PDS_WINDOW_SIZE fixes in memory and a
+ * fix is kept at most one fix later than it was seen.
+ *
+ * Regardless of the tolerance, a fix is kept at once if:
+ *   - the heading turned PDS_TURN_ANGLE or more since the anchor,
+ *   - the vehicle stopped or started moving, see PDS_STOP_SPEED,
+ *   - nMaxGap seconds passed since the anchor, so the server keeps seeing
+ *     a parked vehicle,
+ *   - the PDC_HAS_* flags changed, or the fix has no position.
+ */
+
+#define PDS_WINDOW_SIZE     16
+#define PDS_TURN_ANGLE      3000    // 0.01 degree
+#define PDS_STOP_SPEED      100     // 0.01 m/s, slower is standing still
+#define PDS_MAX_OUT         2       // fixes kept per call, at most
+
+typedef struct _PosDetSimplify {
+    PosDetFix anchor;                   // last fix kept
+    PosDetFix cand;                     // last fix seen, not kept yet
+    PosDetFix window[PDS_WINDOW_SIZE];  // fixes dropped since the anchor
+    uint16    nWindow;
+    uint16    nTolerance;               // metre, 0 keeps every fix
+    uint16    nMaxGap;                  // seconds, 0 for no limit
+    boolean   bAnchor;                  // FALSE until the first fix
+    boolean   bCand;
+} PosDetSimplify;
+
+void PosDetSimplify_Init(PosDetSimplify *pS, uint16 nTolerance,
+                         uint16 nMaxGap);
+int  PosDetSimplify_Add(PosDetSimplify *pS, const PosDetFix *pFix,
+                        PosDetFix *pOut);
+int  PosDetSimplify_Flush(PosDetSimplify *pS, PosDetFix *pOut);
+
+#endif /* ifndef POSDETSIMPLIFY_H */
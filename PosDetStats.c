@@ -0,0 +1,117 @@
+#include "PosDetStats.h"
+#include "PosDetCodec.h"
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+/* Append v as an unsigned varint, returns the new end. */
+static byte *
+PutVarint(byte *p, uint32 v)
+{
+    while (v >= 0x80) {
+        *p++ = (byte)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (byte)v;
+    return p;
+}
+
+static byte *
+PutCounts(byte *p, const uint32 *pCounts, int n)
+{
+    int i;
+
+    p = PutVarint(p, (uint32)n);
+    for (i = 0; i < n; i++) {
+        p = PutVarint(p, pCounts[i]);
+    }
+    return p;
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+void
+PosDetStats_Reset(PosDetStats *ps)
+{
+    MEMSET(ps, 0, sizeof(PosDetStats));
+    ps->dwStart = GETUPTIMEMS();
+}
+
+void
+PosDetStats_Count(PosDetStats *ps, int nCounter, uint32 n)
+{
+    ps->counters[nCounter] += n;
+}
+
+void
+PosDetStats_GPSError(PosDetStats *ps, uint32 status)
+{
+    uint32 i = status - AEEGPS_ERR_BASE;
+
+    ps->gpsErrs[i < PDST_GPS_ERRS ? i : 0]++;
+}
+
+void
+PosDetStats_Sample(PosDetStats *ps, int nHist, uint32 v)
+{
+    PosDetHist *ph = &ps->hists[nHist];
+    int i = 0;
+
+    while (i < PDST_HIST_BUCKETS - 1 && (v >> i) != 0) {
+        i++;
+    }
+    ph->buckets[i]++;
+    ph->nSum = (ph->nSum + v < ph->nSum) ? 0xFFFFFFFF : ph->nSum + v;
+    ph->nMax = MAX(ph->nMax, v);
+}
+
+void
+PosDetStats_Set(PosDetStats *ps, int nGauge, uint32 v)
+{
+    ps->gauges[nGauge] = v;
+}
+
+/* Write the stats frame into pBuf, returns its size, or 0 if nSize is less
+ * than PDST_FRAME_MAX_SIZE. */
+int
+PosDetStats_EncodeFrame(const PosDetStats *ps, byte *pBuf, int nSize)
+{
+    const PosDetHist *ph = NULL;
+    uint32 dwSecs = (GETUPTIMEMS() - ps->dwStart) / 1000;
+    byte *p = pBuf + PDC_FRAME_HDR_SIZE;
+    int nBuckets = 0;
+    int i;
+
+    if (nSize < PDST_FRAME_MAX_SIZE) {
+        return 0;
+    }
+
+    *p++ = PDST_VERSION;
+    *p++ = (byte)(dwSecs >> 24);
+    *p++ = (byte)(dwSecs >> 16);
+    *p++ = (byte)(dwSecs >> 8);
+    *p++ = (byte)dwSecs;
+    p = PutCounts(p, ps->counters, PDST_CTR_COUNT);
+    p = PutCounts(p, ps->gpsErrs, PDST_GPS_ERRS);
+
+    p = PutVarint(p, PDST_HIST_COUNT);
+    for (i = 0; i < PDST_HIST_COUNT; i++) {
+        ph = &ps->hists[i];
+        for (nBuckets = PDST_HIST_BUCKETS; nBuckets > 0; nBuckets--) {
+            if (ph->buckets[nBuckets - 1] != 0) {
+                break;
+            }
+        }
+        p = PutCounts(p, ph->buckets, nBuckets);
+        p = PutVarint(p, ph->nSum);
+        p = PutVarint(p, ph->nMax);
+    }
+    p = PutCounts(p, ps->gauges, PDST_GAUGE_COUNT);
+
+    (void)PosDetCodec_PutFrameHdr(pBuf, PDC_FRAME_STATS,
+                                  (uint16)(p - pBuf - PDC_FRAME_HDR_SIZE));
+    return (int)(p - pBuf);
+}
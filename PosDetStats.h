@@ -0,0 +1,96 @@
+#ifndef POSDETSTATS_H
+#define POSDETSTATS_H
+
+#include "AEEStdLib.h"
+
+/*
+ * Runtime counters and histograms, sent to the server now and then in a
+ * PDC_FRAME_STATS frame so that a slow terminal can be told apart from a
+ * slow network without a debugger attached. Everything counts from the
+ * last PosDetStats_Reset(), i.e. the last stats frame.
+ *
+ * A histogram has log2 buckets: bucket 0 counts the samples of 0, bucket
+ * i the ones from 2^(i-1) to 2^i - 1, the last one everything above.
+ * Latencies are in ms, so the last bucket starts at 2^18 ms, 4.4 minutes.
+ *
+ * Payload of the frame, varints as in the delta encoding but unsigned:
+ *
+ *   size    field
+ *   1       version, PDST_VERSION
+ *   4       seconds covered, big-endian
+ *   varint  n, counters that follow, PDST_CTR_* order
+ *   varint  each counter
+ *   varint  n, GPS errors that follow, PDST_GPS_ERRS order
+ *   varint  each GPS error count
+ *   varint  n, histograms that follow, PDST_HIST_* order, each of
+ *     varint  m, buckets that follow, the ones after are 0
+ *     varint  each bucket
+ *     varint  sum of the samples, saturating
+ *     varint  largest sample
+ *   varint  n, gauges that follow, PDST_GAUGE_* order
+ *   varint  each gauge
+ *
+ * Readers skip what they don't know of a longer list, so counters and
+ * histograms may be added at the end without a new version.
+ */
+
+#define PDST_VERSION          1
+#define PDST_HIST_BUCKETS     20
+
+/* Counters. */
+#define PDST_CTR_GPS_REQS     0     // GetGPSInfo requests made
+#define PDST_CTR_GPS_FIXES    1     // answers with a fix
+#define PDST_CTR_GPS_TIMEOUTS 2     // requests never answered
+#define PDST_CTR_CONNECTS     3
+#define PDST_CTR_RECONNECTS   4     // connect tries scheduled after a failure
+#define PDST_CTR_BYTES_SENT   5
+#define PDST_CTR_REPORTS_SENT 6     // again after a lost connection too
+#define PDST_CTR_QUEUE_FULL   7     // reports that could not be queued
+#define PDST_CTR_LOG_ERRORS   8     // log writes that failed, lines lost
+#define PDST_CTR_COUNT        9
+
+/* Histograms. */
+#define PDST_HIST_FIX         0     // ms from GetGPSInfo to its answer
+#define PDST_HIST_TTFF        1     // ms from the start to the first fix
+#define PDST_HIST_CONNECT     2     // ms from connect to connected
+#define PDST_HIST_WRITE       3     // ms to write a batch
+#define PDST_HIST_QUEUE       4     // reports queued, once per new report
+#define PDST_HIST_COUNT       5
+
+/* Gauges, values as last set rather than sums, 0 if not set since the
+ * last frame. */
+#define PDST_GAUGE_BACKOFF_FAILURES 0   // reconnect failures in a row
+#define PDST_GAUGE_BACKOFF_DELAY    1   // ms, the reconnect wait after them
+#define PDST_GAUGE_COUNT            2
+
+/* GPS errors by AEEGPS_ERR_BASE + index, index 0 for any other code. */
+#define PDST_GPS_ERRS         12
+
+/* Largest stats frame, PosDetStats_EncodeFrame() needs this much room. */
+#define PDST_FRAME_MAX_SIZE (3 + 1 + 4 + 4 * 5 + 5 * (PDST_CTR_COUNT \
+                             + PDST_GPS_ERRS \
+                             + PDST_HIST_COUNT * (PDST_HIST_BUCKETS + 3) \
+                             + PDST_GAUGE_COUNT))
+
+typedef struct _PosDetHist {
+    uint32 buckets[PDST_HIST_BUCKETS];
+    uint32 nSum;
+    uint32 nMax;
+} PosDetHist;
+
+typedef struct _PosDetStats {
+    uint32     dwStart;     // uptime ms of the last reset
+    uint32     counters[PDST_CTR_COUNT];
+    uint32     gpsErrs[PDST_GPS_ERRS];
+    PosDetHist hists[PDST_HIST_COUNT];
+    uint32     gauges[PDST_GAUGE_COUNT];
+} PosDetStats;
+
+void PosDetStats_Reset(PosDetStats *ps);
+void PosDetStats_Count(PosDetStats *ps, int nCounter, uint32 n);
+void PosDetStats_GPSError(PosDetStats *ps, uint32 status);
+void PosDetStats_Sample(PosDetStats *ps, int nHist, uint32 v);
+void PosDetStats_Set(PosDetStats *ps, int nGauge, uint32 v);
+int  PosDetStats_EncodeFrame(const PosDetStats *ps, byte *pBuf, int nSize);
+
+#endif /* ifndef POSDETSTATS_H */
@@ -0,0 +1,99 @@
+#include "PosDetTrace.h"
+
+/*===========================================================================
+HELPER ROUTINES.
+===========================================================================*/
+
+static byte *
+PutU16(byte *p, uint16 v)
+{
+    p[0] = (byte)(v & 0xFF);
+    p[1] = (byte)(v >> 8);
+    return p + 2;
+}
+
+static byte *
+PutU32(byte *p, uint32 v)
+{
+    p[0] = (byte)(v & 0xFF);
+    p[1] = (byte)((v >> 8) & 0xFF);
+    p[2] = (byte)((v >> 16) & 0xFF);
+    p[3] = (byte)(v >> 24);
+    return p + 4;
+}
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+void
+PosDetTrace_Init(PosDetTrace *pt)
+{
+    MEMSET(pt, 0, sizeof(PosDetTrace));
+}
+
+void
+PosDetTrace_Add(PosDetTrace *pt, uint32 dwEvent, uint32 dwArg1,
+                uint32 dwArg2)
+{
+    PosDetTraceRec *pr = &pt->recs[pt->nNext & (PDT_RING_SIZE - 1)];
+
+    pr->dwTime = GETUPTIMEMS();
+    pr->dwEvent = dwEvent;
+    pr->dwArg1 = dwArg1;
+    pr->dwArg2 = dwArg2;
+    pt->nNext++;
+}
+
+/* Write the ring to pszFile, replacing it. The ring is left as it is. */
+int
+PosDetTrace_Dump(const PosDetTrace *pt, IFileMgr *pIFileMgr,
+                 const char *pszFile)
+{
+    const PosDetTraceRec *pr = NULL;
+    uint32 n = MIN(pt->nNext, PDT_RING_SIZE);
+    uint32 nSize = PDT_HDR_SIZE + n * PDT_RECORD_SIZE;
+    IFile *pFile = NULL;
+    byte *pBuf = NULL;
+    byte *p = NULL;
+    uint32 i;
+    int err = SUCCESS;
+
+    pBuf = (byte*)MALLOC(nSize);
+    if (NULL == pBuf) {
+        return ENOMEMORY;
+    }
+
+    p = pBuf;
+    MEMCPY(p, "PDTR", 4);
+    p += 4;
+    p = PutU16(p, PDT_VERSION);
+    p = PutU16(p, PDT_RECORD_SIZE);
+    p = PutU32(p, n);
+    p = PutU32(p, pt->nNext - n);
+    p = PutU32(p, GETUPTIMEMS());
+    p = PutU32(p, GETTIMESECONDS());
+    for (i = pt->nNext - n; i != pt->nNext; i++) {
+        pr = &pt->recs[i & (PDT_RING_SIZE - 1)];
+        p = PutU32(p, pr->dwTime);
+        p = PutU32(p, pr->dwEvent);
+        p = PutU32(p, pr->dwArg1);
+        p = PutU32(p, pr->dwArg2);
+    }
+
+    if (IFILEMGR_Test(pIFileMgr, pszFile) == SUCCESS) {
+        (void)IFILEMGR_Remove(pIFileMgr, pszFile);
+    }
+    pFile = IFILEMGR_OpenFile(pIFileMgr, pszFile, _OFM_CREATE);
+    if (NULL == pFile) {
+        err = IFILEMGR_GetLastError(pIFileMgr);
+    }
+    else {
+        if (IFILE_Write(pFile, pBuf, nSize) != nSize) {
+            err = IFILEMGR_GetLastError(pIFileMgr);
+        }
+        (void)IFILE_Release(pFile);
+    }
+    FREE(pBuf);
+    return err;
+}
@@ -0,0 +1,128 @@
+#ifndef POSDETTRACE_H
+#define POSDETTRACE_H
+
+#include "AEEStdLib.h"
+#include "AEEFile.h"
+
+/*
+ * Binary trace of the last PDT_RING_SIZE events, for the paths that run on
+ * every callback, where a formatted DBGPRINTF costs more than the work.
+ *
+ * An event is a fixed size record, the uptime, an event id and two
+ * arguments, written into a ring in RAM. Nothing is formatted on the
+ * terminal: PosDetTrace_Dump() writes the ring to a file as it is and
+ * host/posdettrace prints it, with the text of each event.
+ *
+ * Events are traced at a level, the ones above PDT_LEVEL are compiled out:
+ *
+ *   PDT_ERROR(pt, ev, a, b)    something failed
+ *   PDT_INFO(pt, ev, a, b)     a change of state, e.g. connected
+ *   PDT_DEBUG(pt, ev, a, b)    each step, e.g. each GetGPSInfo request
+ *
+ * Dump file, all little-endian as the log index:
+ *
+ *   offset size  field
+ *   0      4     "PDTR"
+ *   4      2     version, PDT_VERSION
+ *   6      2     size of a record, PDT_RECORD_SIZE
+ *   8      4     n, records that follow
+ *   12     4     records overwritten before the oldest one
+ *   16     4     uptime ms when dumped
+ *   20     4     GETTIMESECONDS() when dumped, to date the records
+ *   24     16*n  records, oldest first: uptime ms, event, arg 1, arg 2
+ */
+
+#define PDT_LEVEL_NONE      0
+#define PDT_LEVEL_ERROR     1
+#define PDT_LEVEL_INFO      2
+#define PDT_LEVEL_DEBUG     3
+
+/* Per-fix events only when asked for, e.g. -DPDT_LEVEL=3. */
+#ifndef PDT_LEVEL
+#define PDT_LEVEL           PDT_LEVEL_INFO
+#endif
+
+#define PDT_RING_SIZE       128     // a power of 2
+#define PDT_VERSION         1
+#define PDT_HDR_SIZE        24
+#define PDT_RECORD_SIZE     16
+
+/* Events, keep host/PosDetTraceDump.c in step. An id is never reused. */
+#define PDT_EV_GPS_REQ          1   // request number, accuracy
+#define PDT_EV_GPS_REQ_FAIL     2   // err
+#define PDT_EV_GPS_ERR          3   // status, latency ms
+#define PDT_EV_CONN_WAIT        4   // server
+#define PDT_EV_CONN_TIMEDOUT    5   // server
+#define PDT_EV_CONN_REFUSED     6   // server
+#define PDT_EV_CONN_ISCONN      7   // server
+#define PDT_EV_CONN_FATAL       8   // err, server
+#define PDT_EV_CONN_INPROGRESS  9   // server
+#define PDT_EV_CONN_ERR         10  // err, server
+#define PDT_EV_CONNECTED        11  // server, ms since the first try
+#define PDT_EV_IP_ERR           12  // err
+#define PDT_EV_IP_ADDRS         13  // number of addresses
+#define PDT_EV_IP_NOMEM         14  // number of addresses
+#define PDT_EV_GPS_ADAPT        15  // timeout ms, split retry ms, accuracy
+#define PDT_EV_NET_IP           16  // NETWORK_EVENT_IP event code
+#define PDT_EV_NET_STATE        17  // NETWORK_EVENT_STATE event code
+#define PDT_EV_NET_STATUS       18  // AEENetStatus
+#define PDT_EV_CONN_BAD         19  // server
+#define PDT_EV_CONN_NOW         20  // server
+#define PDT_EV_CONN_DEADLINE    21  // server
+#define PDT_EV_CONN_PRIMARY     22  // server given up for the primary
+#define PDT_EV_CONN_CLOSE       23  // ISockPort_Close() result, reopened
+#define PDT_EV_CONN_RETRY       24  // delay ms, split failures, server
+#define PDT_EV_BIND_WAIT        25  // local port
+#define PDT_EV_BIND_ERR         26  // err, local port
+#define PDT_EV_GPS_TIMEOUT      27  // request timeout ms
+#define PDT_EV_SOCK_WRITE_ERR   28  // err, bytes of the frame sent
+#define PDT_EV_SOCK_READ_ERR    29  // err
+#define PDT_EV_SOCK_CLOSED      30  // server
+#define PDT_EV_ACK_TIMEOUT      31  // reports unacknowledged, datagrams lost
+#define PDT_EV_UDP_FALLBACK     32  // datagrams lost
+
+/* Two values in one argument, a in the low 24 bits and b in the high 8,
+ * for the events marked split. */
+#define PDT_SPLIT(a, b) \
+    (((uint32)(a) & 0xFFFFFF) | ((uint32)(b) << 24))
+
+typedef struct _PosDetTraceRec {
+    uint32 dwTime;      // uptime ms
+    uint32 dwEvent;
+    uint32 dwArg1;
+    uint32 dwArg2;
+} PosDetTraceRec;
+
+typedef struct _PosDetTrace {
+    PosDetTraceRec recs[PDT_RING_SIZE];
+    uint32         nNext;   // records ever added
+} PosDetTrace;
+
+void PosDetTrace_Init(PosDetTrace *pt);
+void PosDetTrace_Add(PosDetTrace *pt, uint32 dwEvent, uint32 dwArg1,
+                     uint32 dwArg2);
+int  PosDetTrace_Dump(const PosDetTrace *pt, IFileMgr *pIFileMgr,
+                      const char *pszFile);
+
+#if PDT_LEVEL >= PDT_LEVEL_ERROR
+#define PDT_ERROR(pt, ev, a, b) \
+    PosDetTrace_Add((pt), (ev), (uint32)(a), (uint32)(b))
+#else
+#define PDT_ERROR(pt, ev, a, b) ((void)0)
+#endif
+
+#if PDT_LEVEL >= PDT_LEVEL_INFO
+#define PDT_INFO(pt, ev, a, b) \
+    PosDetTrace_Add((pt), (ev), (uint32)(a), (uint32)(b))
+#else
+#define PDT_INFO(pt, ev, a, b) ((void)0)
+#endif
+
+#if PDT_LEVEL >= PDT_LEVEL_DEBUG
+#define PDT_DEBUG(pt, ev, a, b) \
+    PosDetTrace_Add((pt), (ev), (uint32)(a), (uint32)(b))
+#else
+#define PDT_DEBUG(pt, ev, a, b) ((void)0)
+#endif
+
+#endif /* ifndef POSDETTRACE_H */
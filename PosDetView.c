@@ -0,0 +1,128 @@
+#include "PosDetView.h"
+#include "RyanUtils.h"
+
+/*===========================================================================
+PUBLIC ROUTINES.
+===========================================================================*/
+
+/* Lay out the lines for a screen of cxScreen x cyScreen pixels. */
+void
+PosDetView_Init(PosDetView *pv, IDisplay *pIDisplay, int cxScreen,
+                int cyScreen)
+{
+    int i;
+
+    MEMSET(pv, 0, sizeof(PosDetView));
+    pv->pIDisplay = pIDisplay;
+    pv->nLines = (uint8)MIN(MAX(cyScreen / LINEHEIGHT, 1), PDV_MAX_LINES);
+    pv->bClear = TRUE;
+
+    for (i = 0; i < pv->nLines; i++) {
+        pv->lines[i].rc.x = 0;
+        pv->lines[i].rc.y = (int16)(i * LINEHEIGHT);
+        pv->lines[i].rc.dx = (int16)cxScreen;
+        pv->lines[i].rc.dy = LINEHEIGHT;
+    }
+}
+
+void
+PosDetView_Printf(PosDetView *pv, int nLine, int nCol, AEEFont fnt,
+                  uint32 dwFlags, const char *pszFormat, ...)
+{
+    va_list args;
+
+    va_start(args, pszFormat);
+    PosDetView_VPrintf(pv, nLine, nCol, fnt, dwFlags, pszFormat, args);
+    va_end(args);
+}
+
+/* Set the text of a line, drawn from nCol pixels on. Vertical alignment
+ * flags are ignored, a line is always one line high. */
+void
+PosDetView_VPrintf(PosDetView *pv, int nLine, int nCol, AEEFont fnt,
+                   uint32 dwFlags, const char *pszFormat, va_list args)
+{
+    PosDetViewLine *pLine = NULL;
+    char szText[PDV_TEXT_SIZE];
+
+    if (!pv->bShown || nLine < 0 || nLine >= pv->nLines) {
+        return;
+    }
+    pLine = &pv->lines[nLine];
+
+    VSNPRINTF(szText, sizeof(szText), pszFormat, args);
+    dwFlags = (dwFlags & ~IDF_ALIGNVERT_MASK) | IDF_RECT_FILL;
+
+    if (STRCMP(szText, pLine->szText) == 0 && fnt == pLine->fnt
+        && dwFlags == pLine->dwFlags && nCol == pLine->rc.x) {
+        return;
+    }
+
+    STRLCPY(pLine->szText, szText, sizeof(pLine->szText));
+    STR_TO_WSTR(pLine->szText, pLine->wText, sizeof(pLine->wText));
+    pLine->fnt = fnt;
+    pLine->dwFlags = dwFlags;
+    pLine->rc.dx = (int16)(pLine->rc.dx + pLine->rc.x - nCol);
+    pLine->rc.x = (int16)nCol;
+    pLine->bDirty = TRUE;
+}
+
+/* Blank nLine and the lines below it, e.g. fields not known any more. */
+void
+PosDetView_ClearFrom(PosDetView *pv, int nLine)
+{
+    for (; nLine < pv->nLines; nLine++) {
+        if (pv->lines[nLine].szText[0]) {
+            pv->lines[nLine].szText[0] = 0;
+            pv->lines[nLine].wText[0] = 0;
+            pv->lines[nLine].bDirty = TRUE;
+        }
+    }
+}
+
+/* Show or hide the view. Once shown, the next update draws every line. */
+void
+PosDetView_Show(PosDetView *pv, boolean bShown)
+{
+    pv->bShown = bShown;
+    pv->bClear = TRUE;
+}
+
+/* Draw the dirty lines, then update the display once. */
+void
+PosDetView_Update(PosDetView *pv)
+{
+    PosDetViewLine *pLine = NULL;
+    boolean bDrawn = FALSE;
+    int i;
+
+    if (!pv->bShown) {
+        return;
+    }
+    if (pv->bClear) {
+        IDISPLAY_ClearScreen(pv->pIDisplay);
+        bDrawn = TRUE;
+    }
+
+    for (i = 0; i < pv->nLines; i++) {
+        pLine = &pv->lines[i];
+        if (!pLine->bDirty && !(pv->bClear && pLine->szText[0])) {
+            continue;
+        }
+        if (pLine->szText[0]) {
+            (void)IDISPLAY_DrawText(pv->pIDisplay, pLine->fnt, pLine->wText,
+                                    -1, pLine->rc.x, pLine->rc.y, &pLine->rc,
+                                    pLine->dwFlags);
+        }
+        else {
+            IDISPLAY_EraseRect(pv->pIDisplay, &pLine->rc);
+        }
+        pLine->bDirty = FALSE;
+        bDrawn = TRUE;
+    }
+
+    pv->bClear = FALSE;
+    if (bDrawn) {
+        IDISPLAY_Update(pv->pIDisplay);
+    }
+}
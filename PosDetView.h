@@ -0,0 +1,51 @@
+#ifndef POSDETVIEW_H
+#define POSDETVIEW_H
+
+#include "AEEStdLib.h"
+#include "AEEDisp.h"
+
+/*
+ * Retained status screen: a column of text lines of LINEHEIGHT pixels.
+ *
+ * Lines are set with PosDetView_Printf(), which only keeps the text and
+ * marks the line dirty if it changed. PosDetView_Update() then draws the
+ * dirty lines, each over its own background, and updates the display once.
+ * Nothing is cleared in between, so the screen does not flicker, and a
+ * frame costs as much as the lines that changed.
+ *
+ * The line rectangles are laid out once, from the screen size. While the
+ * view is hidden, e.g. the app runs in the background, lines are neither
+ * set nor drawn; showing it again draws the whole screen.
+ */
+
+#define PDV_MAX_LINES       12
+#define PDV_TEXT_SIZE       64      // "Time = ... GMT+8" and more
+
+typedef struct _PosDetViewLine {
+    char    szText[PDV_TEXT_SIZE];
+    AECHAR  wText[PDV_TEXT_SIZE];   // szText, as drawn
+    AEERect rc;
+    AEEFont fnt;
+    uint32  dwFlags;
+    boolean bDirty;
+} PosDetViewLine;
+
+typedef struct _PosDetView {
+    IDisplay      *pIDisplay;   // not owned
+    PosDetViewLine lines[PDV_MAX_LINES];
+    uint8          nLines;      // lines fitting on the screen
+    boolean        bClear;      // clear the screen before the next frame
+    boolean        bShown;      // the screen is ours, else draw nothing
+} PosDetView;
+
+void PosDetView_Init(PosDetView *pv, IDisplay *pIDisplay, int cxScreen,
+                     int cyScreen);
+void PosDetView_Printf(PosDetView *pv, int nLine, int nCol, AEEFont fnt,
+                       uint32 dwFlags, const char *pszFormat, ...);
+void PosDetView_VPrintf(PosDetView *pv, int nLine, int nCol, AEEFont fnt,
+                        uint32 dwFlags, const char *pszFormat, va_list args);
+void PosDetView_ClearFrom(PosDetView *pv, int nLine);
+void PosDetView_Show(PosDetView *pv, boolean bShown);
+void PosDetView_Update(PosDetView *pv);
+
+#endif /* ifndef POSDETVIEW_H */
@@ -1,70 +1,48 @@
 #include "RyanUtils.h"
 
 /*===========================================================================
-HELPER ROUTINES FOR DRAWING.
+HELPER ROUTINES FOR READING CONFIG.
 ===========================================================================*/
 
-void
-xDrawTextA(IDisplay *pd,AEEFont fnt, const char *pszText, int nChars,
-           int x, int y, const AEERect *prcBackground, uint32 dwFlags)
+static boolean
+IsBlank(char c)
 {
-    AECHAR wcBuf[80];
-
-    if (nChars < 0)
-        nChars = STRLEN(pszText);
-    nChars = MIN(nChars, ARRAYSIZE(wcBuf));
-
-    STR_TO_WSTR((char*)pszText, wcBuf, sizeof(wcBuf));
-
-    (void)IDISPLAY_DrawText(pd, fnt, wcBuf, nChars, x, y, prcBackground, dwFlags);
+    return ' ' == c || '\t' == c || '\r' == c;
 }
 
-void
-xDisplay(AEEApplet *pMe, int nLine, int nCol, AEEFont fnt, uint32 dwFlags,
-         const char *psz)
+/* NUL terminate p[0..nLen) after dropping trailing blanks. */
+static void
+TrimEnd(char *p, int nLen)
 {
-    AEEDeviceInfo di;
-    AEERect rc;
-    int nMaxLines;
-
-    ISHELL_GetDeviceInfo(pMe->m_pIShell, &di);
-    nMaxLines = (di.cyScreen / LINEHEIGHT) - 2;
-    if (nMaxLines < 1)
-        nMaxLines = 1;
-
-    rc.x = nCol;
-    rc.dx = di.cxScreen - nCol;
-
-    rc.y = nLine * LINEHEIGHT;
-    if( dwFlags & IDF_ALIGNVERT_MASK ) {
-        rc.dy = di.cyScreen - rc.y;
+    while (nLen > 0 && IsBlank(p[nLen - 1])) {
+        nLen--;
     }
-    else {
-        rc.dy = LINEHEIGHT;
-    }
-
-    xDrawTextA(pMe->m_pIDisplay, fnt, psz, -1, rc.x, rc.y, &rc, dwFlags);
-
-    IDISPLAY_Update(pMe->m_pIDisplay);
+    p[nLen] = 0;
 }
 
 /*=======================================================================
-Function: DistToSemi()
+Function: ParseConfig()
 
 Description:
-   Utility function that determines index of the first semicolon in the
-   input string.
+   Splits a config text into "key = value;" items in one pass and calls
+   pfnItem for each of them. Blank lines and lines starting with '#' are
+   skipped, anything after the ';' of a line is ignored.
 
 Prototype:
 
-   int DistToSemi(const char * pszStr);
+   int ParseConfig(char *pBuf, int nLen, PFNCONFIGITEM pfnItem,
+                   void *pUser);
 
 Parameters:
-   pszStr: [in]. String to check.
+   pBuf: [in/out]. Config text, need not be NUL terminated. Keys and values
+         are terminated in place, so pBuf must have room for nLen + 1 chars.
+   nLen: [in]. Chars in pBuf.
+   pfnItem: [in]. Called for each item.
+   pUser: [in]. Passed to pfnItem.
 
 Return Value:
 
-   The index of the first semicolon.
+   The number of lines that are neither items, blank nor comments.
 
 Comments:
    None
@@ -76,23 +54,173 @@ See Also:
    None
 =======================================================================*/
 int
-DistToSemi(const char *pszStr)
+ParseConfig(char *pBuf, int nLen, PFNCONFIGITEM pfnItem, void *pUser)
 {
-    int nCount = 0;
+    char *p = pBuf;
+    char *pEnd = pBuf + nLen;
+    char *pKey = NULL;
+    char *pVal = NULL;
+    char *pEol = NULL;
+    char *pEq = NULL;
+    char *pSemi = NULL;
+    int nLine = 0;
+    int nBad = 0;
+
+    *pEnd = 0;
+    while (p < pEnd) {
+        nLine++;
+
+        /* Find the end of the line, and '=' and ';' on the way. */
+        pEq = NULL;
+        pSemi = NULL;
+        for (pEol = p; pEol < pEnd && *pEol != '\n'; pEol++) {
+            if ('=' == *pEol && !pEq) {
+                pEq = pEol;
+            }
+            else if (';' == *pEol && !pSemi) {
+                pSemi = pEol;
+            }
+        }
 
-    if (!pszStr) {
-        return -1;
-    }
+        pKey = p;
+        while (pKey < pEol && IsBlank(*pKey)) {
+            pKey++;
+        }
+        p = pEol + 1;
 
-    while (*pszStr != 0) {
-        if (*pszStr == ';') {
-            return nCount;
+        if (pKey == pEol || '#' == *pKey) {
+            continue;
         }
-        else {
-            nCount++;
-            pszStr++;
+        if (!pEq || pEq == pKey || (pSemi && pSemi < pEq)) {
+            DBGPRINTF("config line %d: not key = value;", nLine);
+            nBad++;
+            continue;
+        }
+
+        pVal = pEq + 1;
+        while (pVal < pEol && IsBlank(*pVal)) {
+            pVal++;
         }
+        TrimEnd(pVal, (int)((pSemi ? pSemi : pEol) - pVal));
+        TrimEnd(pKey, (int)(pEq - pKey));
+
+        pfnItem(pUser, pKey, pVal, nLine);
     }
 
-    return -1;
+    return nBad;
+}
+
+/*===========================================================================
+HELPER ROUTINES FOR BUILDING STRINGS.
+
+These write each character once, with no intermediate buffers, no wide
+char conversion and no floating point. Fractional values are passed in
+fixed point, e.g. 31.2345678 as StrWriter_Fixed(pw, 312345678, 7).
+===========================================================================*/
+
+void
+StrWriter_Init(StrWriter *pw, char *pBuf, int nSize)
+{
+    pw->pBuf = pBuf;
+    pw->nSize = nSize;
+    pw->nLen = 0;
+    pw->bOverflow = FALSE;
+    if (nSize > 0) {
+        pBuf[0] = 0;
+    }
+}
+
+void
+StrWriter_Char(StrWriter *pw, char c)
+{
+    if (pw->nLen + 1 >= pw->nSize) {
+        pw->bOverflow = TRUE;
+        return;
+    }
+    pw->pBuf[pw->nLen++] = c;
+    pw->pBuf[pw->nLen] = 0;
+}
+
+void
+StrWriter_Str(StrWriter *pw, const char *psz)
+{
+    while (*psz) {
+        if (pw->nLen + 1 >= pw->nSize) {
+            pw->bOverflow = TRUE;
+            break;
+        }
+        pw->pBuf[pw->nLen++] = *psz++;
+    }
+    if (pw->nSize > 0) {
+        pw->pBuf[pw->nLen] = 0;
+    }
+}
+
+/* Decimal digits of n, at least nMinDigits of them with leading zeros. */
+void
+StrWriter_UInt(StrWriter *pw, uint32 n, int nMinDigits)
+{
+    char digits[10];
+    int i = 0;
+
+    do {
+        digits[i++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n > 0 && i < (int)sizeof(digits));
+
+    while (nMinDigits-- > i) {
+        StrWriter_Char(pw, '0');
+    }
+    while (i > 0) {
+        StrWriter_Char(pw, digits[--i]);
+    }
+}
+
+void
+StrWriter_Int(StrWriter *pw, int32 n)
+{
+    if (n < 0) {
+        StrWriter_Char(pw, '-');
+        StrWriter_UInt(pw, (uint32)0 - (uint32)n, 1);
+    }
+    else {
+        StrWriter_UInt(pw, (uint32)n, 1);
+    }
+}
+
+/* n / 10^nDecimals, with all nDecimals fractional digits. */
+void
+StrWriter_Fixed(StrWriter *pw, int32 n, int nDecimals)
+{
+    uint32 u = (n < 0) ? (uint32)0 - (uint32)n : (uint32)n;
+    uint32 scale = 1;
+    int i;
+
+    for (i = 0; i < nDecimals; i++) {
+        scale *= 10;
+    }
+
+    if (n < 0) {
+        StrWriter_Char(pw, '-');
+    }
+    StrWriter_UInt(pw, u / scale, 1);
+    if (nDecimals > 0) {
+        StrWriter_Char(pw, '.');
+        StrWriter_UInt(pw, u % scale, nDecimals);
+    }
+}
+
+/* Dotted quad of an IPv4 address held in network byte order. */
+void
+StrWriter_IPv4(StrWriter *pw, const void *pAddr)
+{
+    const byte *p = (const byte*)pAddr;
+
+    StrWriter_UInt(pw, p[0], 1);
+    StrWriter_Char(pw, '.');
+    StrWriter_UInt(pw, p[1], 1);
+    StrWriter_Char(pw, '.');
+    StrWriter_UInt(pw, p[2], 1);
+    StrWriter_Char(pw, '.');
+    StrWriter_UInt(pw, p[3], 1);
 }
@@ -2,19 +2,33 @@
 #define RYANUTILS_H
 
 #include "AEEStdLib.h"
-#include "AEEDisp.h"
-#include "AEEAppGen.h"
 
 #define LINEHEIGHT 16
 #define TOPLINE    0
 #define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
 
-void xDrawTextA(IDisplay * pd, AEEFont fnt, const char *pszText, int nChars,
-                int x,int y, const AEERect *prcBackground, uint32 dwFlags);
+/* Called by ParseConfig() for each "key = value;" line, with key and value
+ * NUL terminated and trimmed. nLine counts from 1. */
+typedef void (*PFNCONFIGITEM)(void *pUser, const char *pszKey,
+                              const char *pszVal, int nLine);
 
-void xDisplay(AEEApplet *pMe, int nLine, int nCol, AEEFont fnt, uint32 dwFlags,
-              const char *psz);
+int ParseConfig(char *pBuf, int nLen, PFNCONFIGITEM pfnItem, void *pUser);
 
-int DistToSemi(const char *pszStr);
+/* Append-only writer into a caller owned char buffer. The buffer is kept
+ * NUL terminated; what does not fit is dropped and bOverflow is set. */
+typedef struct _StrWriter {
+    char   *pBuf;
+    int     nSize;      // bytes in pBuf, including room for the NUL
+    int     nLen;       // chars written so far
+    boolean bOverflow;
+} StrWriter;
+
+void StrWriter_Init(StrWriter *pw, char *pBuf, int nSize);
+void StrWriter_Char(StrWriter *pw, char c);
+void StrWriter_Str(StrWriter *pw, const char *psz);
+void StrWriter_Int(StrWriter *pw, int32 n);
+void StrWriter_UInt(StrWriter *pw, uint32 n, int nMinDigits);
+void StrWriter_Fixed(StrWriter *pw, int32 n, int nDecimals);
+void StrWriter_IPv4(StrWriter *pw, const void *pAddr);
 
 #endif /* ifndef RYANUTILS_H */
@@ -0,0 +1,275 @@
+/*=============================================================================
+  FILE: HostFile.c
+
+  IFileMgr and IFile on plain files under the runtime root directory, which
+  stands in for the applet directory. See HostRuntime.h.
+  ============================================================================*/
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "HostRuntime.h"
+
+struct IFileMgr {
+    HostObject base;
+    int        nLastErr;
+};
+
+struct IFile {
+    HostObject base;
+    IFileMgr  *pMgr;
+    int        fd;
+    boolean    bAppend;     // every write goes to the end
+    boolean    bCorrupt;    // the file of HostFile_Corrupt()
+};
+
+/* See HostFile_Corrupt(). */
+static char   s_szCorruptFile[64];
+static uint32 s_nCorruptWrite;
+static uint32 s_nCorruptSeen;
+
+/* "fs:/~/name", "~/name" and "name" all are the applet's own "name". */
+static const char *
+HostFileMgr_Name(const char *pszFile)
+{
+    if (STRNCMP(pszFile, "fs:/~/", 6) == 0) {
+        return pszFile + 6;
+    }
+    if (STRNCMP(pszFile, "~/", 2) == 0) {
+        return pszFile + 2;
+    }
+    return pszFile;
+}
+
+static void
+HostFileMgr_Path(const char *pszFile, char *pszPath, int nSize)
+{
+    (void)snprintf(pszPath, (size_t)nSize, "%s/%s", HostRuntime_Root(),
+                   HostFileMgr_Name(pszFile));
+}
+
+static int
+HostFileMgr_MapErrno(int err)
+{
+    switch (err) {
+    case ENOENT:
+        return EFILENOEXISTS;
+    case EEXIST:
+        return EFILEEXISTS;
+    case ENOMEM:
+        return ENOMEMORY;
+    default:
+        return EFAILED;
+    }
+}
+
+static void
+HostFileMgr_Delete(void *po)
+{
+    free(po);
+}
+
+int
+HostFileMgr_New(void **ppo)
+{
+    IFileMgr *pm = (IFileMgr*)calloc(1, sizeof(IFileMgr));
+
+    if (NULL == pm) {
+        return ENOMEMORY;
+    }
+    pm->base.nRefs = 1;
+    pm->base.pfnDelete = HostFileMgr_Delete;
+    *ppo = pm;
+    return SUCCESS;
+}
+
+static void
+HostFile_Delete(void *po)
+{
+    IFile *pf = (IFile*)po;
+
+    (void)close(pf->fd);
+    free(pf);
+}
+
+IFile *
+HostFileMgr_OpenFile(IFileMgr *pm, const char *pszFile, OpenFileMode mode)
+{
+    char szPath[512];
+    IFile *pf = NULL;
+    int flags = O_RDWR;
+    int fd = -1;
+
+    switch (mode) {
+    case _OFM_READ:
+        flags = O_RDONLY;
+        break;
+    case _OFM_CREATE:
+        flags = O_RDWR | O_CREAT | O_EXCL;
+        break;
+    default:
+        break;
+    }
+
+    HostFileMgr_Path(pszFile, szPath, sizeof(szPath));
+    fd = open(szPath, flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        pm->nLastErr = HostFileMgr_MapErrno(errno);
+        return NULL;
+    }
+
+    pf = (IFile*)calloc(1, sizeof(IFile));
+    if (NULL == pf) {
+        (void)close(fd);
+        pm->nLastErr = ENOMEMORY;
+        return NULL;
+    }
+    pf->base.nRefs = 1;
+    pf->base.pfnDelete = HostFile_Delete;
+    pf->pMgr = pm;
+    pf->fd = fd;
+    pf->bAppend = (_OFM_APPEND == mode);
+    pf->bCorrupt = s_nCorruptWrite > 0
+        && STRCMP(HostFileMgr_Name(pszFile), s_szCorruptFile) == 0;
+    pm->nLastErr = SUCCESS;
+    return pf;
+}
+
+int
+HostFileMgr_Test(IFileMgr *pm, const char *pszFile)
+{
+    char szPath[512];
+
+    HostFileMgr_Path(pszFile, szPath, sizeof(szPath));
+    if (access(szPath, F_OK) != 0) {
+        pm->nLastErr = EFILENOEXISTS;
+        return EFILENOEXISTS;
+    }
+    return SUCCESS;
+}
+
+int
+HostFileMgr_Remove(IFileMgr *pm, const char *pszFile)
+{
+    char szPath[512];
+
+    HostFileMgr_Path(pszFile, szPath, sizeof(szPath));
+    if (unlink(szPath) != 0) {
+        pm->nLastErr = HostFileMgr_MapErrno(errno);
+        return pm->nLastErr;
+    }
+    return SUCCESS;
+}
+
+int
+HostFileMgr_Rename(IFileMgr *pm, const char *pszSrc, const char *pszDst)
+{
+    char szSrc[512];
+    char szDst[512];
+
+    HostFileMgr_Path(pszSrc, szSrc, sizeof(szSrc));
+    HostFileMgr_Path(pszDst, szDst, sizeof(szDst));
+    if (rename(szSrc, szDst) != 0) {
+        pm->nLastErr = HostFileMgr_MapErrno(errno);
+        return pm->nLastErr;
+    }
+    return SUCCESS;
+}
+
+int
+HostFileMgr_GetLastError(IFileMgr *pm)
+{
+    return pm->nLastErr;
+}
+
+int32
+HostFile_Read(IFile *pf, void *pDest, uint32 nWant)
+{
+    ssize_t n = read(pf->fd, pDest, nWant);
+
+    if (n < 0) {
+        pf->pMgr->nLastErr = HostFileMgr_MapErrno(errno);
+        return 0;
+    }
+    return (int32)n;
+}
+
+void
+HostFile_Corrupt(const char *pszFile, uint32 nWrite)
+{
+    STRLCPY(s_szCorruptFile, pszFile, sizeof(s_szCorruptFile));
+    s_nCorruptWrite = nWrite;
+    s_nCorruptSeen = 0;
+}
+
+uint32
+HostFile_Write(IFile *pf, const void *pSrc, uint32 nBytes)
+{
+    byte *pBad = NULL;
+    ssize_t n = 0;
+
+    if (pf->bAppend) {
+        (void)lseek(pf->fd, 0, SEEK_END);
+    }
+    if (pf->bCorrupt && nBytes > 0 && ++s_nCorruptSeen == s_nCorruptWrite) {
+        pBad = (byte*)malloc(nBytes);
+        if (pBad) {
+            MEMCPY(pBad, pSrc, nBytes);
+            pBad[nBytes - 1] ^= 0x01;
+            pSrc = pBad;
+        }
+    }
+    n = write(pf->fd, pSrc, nBytes);
+    if (n < 0) {
+        pf->pMgr->nLastErr = HostFileMgr_MapErrno(errno);
+        free(pBad);
+        return 0;
+    }
+    free(pBad);
+    HostRuntime_Stats()->nFileWrites++;
+    HostRuntime_Stats()->nFileBytes += (uint32)n;
+    return (uint32)n;
+}
+
+int
+HostFile_Seek(IFile *pf, FileSeekType seek, int32 pos)
+{
+    int whence = SEEK_SET;
+
+    if (_SEEK_END == seek) {
+        whence = SEEK_END;
+    }
+    else if (_SEEK_CURRENT == seek) {
+        whence = SEEK_CUR;
+    }
+    if (lseek(pf->fd, pos, whence) < 0) {
+        pf->pMgr->nLastErr = EFAILED;
+        return EFAILED;
+    }
+    return SUCCESS;
+}
+
+int
+HostFile_GetInfo(IFile *pf, AEEFileInfo *pInfo)
+{
+    struct stat st;
+
+    if (fstat(pf->fd, &st) != 0) {
+        return EFAILED;
+    }
+    MEMSET(pInfo, 0, sizeof(AEEFileInfo));
+    pInfo->dwCreationDate = (uint32)st.st_ctime;
+    pInfo->dwSize = (uint32)st.st_size;
+    return SUCCESS;
+}
+
+int
+HostFile_Truncate(IFile *pf, uint32 nPos)
+{
+    if (ftruncate(pf->fd, (off_t)nPos) != 0) {
+        pf->pMgr->nLastErr = EFAILED;
+        return EFAILED;
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,466 @@
+/*=============================================================================
+  FILE: HostNet.c
+
+  ISockPort on a real non-blocking BSD socket, and INetwork for a data
+  session the host runtime opens and closes at will. See HostRuntime.h.
+  ============================================================================*/
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "HostRuntime.h"
+
+#define HOST_MAX_NET_HANDLERS   8
+
+struct ISockPort {
+    HostObject   base;
+    int          fd;
+    int          nType;         // AEE_SOCKPORT_*
+    int          nLastErr;      // AEE_NET_*
+    boolean      bConnecting;
+    boolean      bConnected;
+    AEECallback *pcbRead;       // waiting to read
+    AEECallback *pcbWrite;      // waiting to write or connect
+};
+
+struct INetwork {
+    HostObject base;
+};
+
+typedef struct _HostNetHandler {
+    int             nEvent;
+    PFNNETWORKEVENT pfn;
+    void           *pData;
+} HostNetHandler;
+
+static int            s_nConnecting;
+static AEENetStatus   s_netStatus = AEE_NET_STATUS_OPEN;
+static HostNetHandler s_handlers[HOST_MAX_NET_HANDLERS];
+static int            s_nHandlers;
+
+static void HostSock_UpdateWatch(ISockPort *ps);
+
+/*===========================================================================
+ISOCKPORT.
+===========================================================================*/
+
+boolean
+HostSock_Connecting(void)
+{
+    return s_nConnecting > 0;
+}
+
+static void
+HostSock_SetConnecting(ISockPort *ps, boolean bConnecting)
+{
+    if (ps->bConnecting != bConnecting) {
+        s_nConnecting += bConnecting ? 1 : -1;
+        ps->bConnecting = bConnecting;
+    }
+}
+
+static int
+HostSock_MapErrno(int err)
+{
+    switch (err) {
+    case ECONNREFUSED:
+        return AEE_NET_ECONNREFUSED;
+    case ETIMEDOUT:
+        return AEE_NET_ETIMEDOUT;
+    case ECONNRESET:
+    case EPIPE:
+        return AEE_NET_ECONNRESET;
+    case ENOTCONN:
+        return AEE_NET_ENOTCONN;
+    case EISCONN:
+        return AEE_NET_EISCONN;
+    case EBADF:
+        return AEE_NET_EBADF;
+    case EAFNOSUPPORT:
+        return AEE_NET_EAFNOSUPPORT;
+    case ENOMEM:
+    case ENOBUFS:
+        return AEE_NET_ENOMEM;
+    default:
+        return AEE_NET_ERROR;
+    }
+}
+
+static void
+HostSock_ToSockAddr(const AEESockAddrStorage *pAddr, struct sockaddr_in *psa)
+{
+    MEMSET(psa, 0, sizeof(*psa));
+    psa->sin_family = AF_INET;
+    psa->sin_port = pAddr->inet.port;       // both in network order
+    psa->sin_addr.s_addr = pAddr->inet.addr;
+}
+
+/* Hand a waiting callback over to the shell, to run from the loop. */
+static void
+HostSock_Notify(AEECallback **ppcb)
+{
+    AEECallback *pcb = *ppcb;
+
+    *ppcb = NULL;
+    pcb->pfnCancel = NULL;
+    pcb->pCancelData = NULL;
+    HostShell_Resume(HostRuntime_Shell(), pcb);
+}
+
+static void
+HostSock_OnReady(void *pUser, int fd, short revents)
+{
+    ISockPort *ps = (ISockPort*)pUser;
+
+    if (ps->pcbRead && (revents & (POLLIN | POLLERR | POLLHUP))) {
+        HostSock_Notify(&ps->pcbRead);
+    }
+    if (ps->pcbWrite && (revents & (POLLOUT | POLLERR | POLLHUP))) {
+        HostSock_Notify(&ps->pcbWrite);
+    }
+    HostSock_UpdateWatch(ps);
+}
+
+static void
+HostSock_UpdateWatch(ISockPort *ps)
+{
+    short events = 0;
+
+    if (ps->fd < 0) {
+        return;
+    }
+    if (ps->pcbRead) {
+        events |= POLLIN;
+    }
+    if (ps->pcbWrite) {
+        events |= POLLOUT;
+    }
+    (void)HostRuntime_Watch(ps->fd, events, HostSock_OnReady, ps);
+}
+
+static void
+HostSock_CancelCb(AEECallback *pcb)
+{
+    ISockPort *ps = (ISockPort*)pcb->pCancelData;
+
+    if (ps->pcbRead == pcb) {
+        ps->pcbRead = NULL;
+    }
+    if (ps->pcbWrite == pcb) {
+        ps->pcbWrite = NULL;
+    }
+    pcb->pfnCancel = NULL;
+    pcb->pCancelData = NULL;
+    HostSock_UpdateWatch(ps);
+}
+
+static void
+HostSock_Wait(ISockPort *ps, AEECallback **ppcb, AEECallback *pcb)
+{
+    CALLBACK_Cancel(pcb);
+    if (*ppcb) {
+        CALLBACK_Cancel(*ppcb);
+    }
+
+    /* A closed socket is as ready as it will ever be. */
+    if (ps->fd < 0) {
+        HostShell_Resume(HostRuntime_Shell(), pcb);
+        return;
+    }
+
+    *ppcb = pcb;
+    pcb->pfnCancel = HostSock_CancelCb;
+    pcb->pCancelData = ps;
+    HostSock_UpdateWatch(ps);
+}
+
+static void
+HostSock_Delete(void *po)
+{
+    ISockPort *ps = (ISockPort*)po;
+
+    (void)HostSock_Close(ps);
+    free(ps);
+}
+
+int
+HostSock_New(void **ppo)
+{
+    ISockPort *ps = (ISockPort*)calloc(1, sizeof(ISockPort));
+
+    if (NULL == ps) {
+        return ENOMEMORY;
+    }
+    ps->base.nRefs = 1;
+    ps->base.pfnDelete = HostSock_Delete;
+    ps->fd = -1;
+    *ppo = ps;
+    return SUCCESS;
+}
+
+int
+HostSock_OpenEx(ISockPort *ps, uint16 wFamily, int nType, int nProto)
+{
+    if (ps->fd >= 0) {
+        return EALREADY;
+    }
+    if (AEE_AF_INET != wFamily) {
+        return AEE_NET_EAFNOSUPPORT;
+    }
+
+    ps->fd = socket(AF_INET, (AEE_SOCKPORT_DGRAM == nType ? SOCK_DGRAM
+                                                          : SOCK_STREAM)
+                             | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ps->fd < 0) {
+        return HostSock_MapErrno(errno);
+    }
+    ps->nType = nType;
+    ps->nLastErr = AEE_NET_SUCCESS;
+    ps->bConnected = FALSE;
+    return AEE_SUCCESS;
+}
+
+int
+HostSock_Connect(ISockPort *ps, const AEESockAddrStorage *pAddr)
+{
+    struct sockaddr_in sa;
+    int err = 0;
+
+    if (ps->bConnected) {
+        return AEE_NET_EISCONN;
+    }
+
+    HostSock_ToSockAddr(pAddr, &sa);
+    if (connect(ps->fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        err = errno;
+        if (EINPROGRESS == err || EALREADY == err) {
+            HostSock_SetConnecting(ps, TRUE);
+            return AEEPORT_WAIT;
+        }
+        if (EISCONN != err || !ps->bConnecting) {
+            HostSock_SetConnecting(ps, FALSE);
+            ps->nLastErr = HostSock_MapErrno(err);
+            return ps->nLastErr;
+        }
+    }
+
+    /* Connected now, or the connect under way completed. */
+    HostSock_SetConnecting(ps, FALSE);
+    ps->bConnected = TRUE;
+    HostRuntime_Stats()->nConnects++;
+    return AEE_SUCCESS;
+}
+
+int
+HostSock_Bind(ISockPort *ps, const AEESockAddrStorage *pAddr)
+{
+    struct sockaddr_in sa;
+    int one = 1;
+
+    HostSock_ToSockAddr(pAddr, &sa);
+    (void)setsockopt(ps->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(ps->fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        ps->nLastErr = HostSock_MapErrno(errno);
+        return ps->nLastErr;
+    }
+    return AEE_SUCCESS;
+}
+
+int32
+HostSock_Write(ISockPort *ps, const char *pcBuf, int32 cbBuf)
+{
+    ssize_t n = send(ps->fd, pcBuf, (size_t)cbBuf,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (n < 0) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+            return AEEPORT_WAIT;
+        }
+        ps->nLastErr = HostSock_MapErrno(errno);
+        return AEEPORT_ERROR;
+    }
+    HostRuntime_Stats()->nBytesSent += (uint32)n;
+    return (int32)n;
+}
+
+int32
+HostSock_Read(ISockPort *ps, char *pcBuf, int32 cbBuf)
+{
+    ssize_t n = recv(ps->fd, pcBuf, (size_t)cbBuf, MSG_DONTWAIT);
+
+    if (n < 0) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+            return AEEPORT_WAIT;
+        }
+        ps->nLastErr = HostSock_MapErrno(errno);
+        return AEEPORT_ERROR;
+    }
+    HostRuntime_Stats()->nBytesRcvd += (uint32)n;
+    return (int32)n;    // 0 is AEEPORT_CLOSED
+}
+
+void
+HostSock_Writeable(ISockPort *ps, AEECallback *pcb)
+{
+    HostSock_Wait(ps, &ps->pcbWrite, pcb);
+}
+
+void
+HostSock_Readable(ISockPort *ps, AEECallback *pcb)
+{
+    HostSock_Wait(ps, &ps->pcbRead, pcb);
+}
+
+int
+HostSock_GetLastError(ISockPort *ps)
+{
+    return ps->nLastErr;
+}
+
+int
+HostSock_Close(ISockPort *ps)
+{
+    if (ps->fd < 0) {
+        return AEE_SUCCESS;
+    }
+
+    if (ps->pcbRead) {
+        CALLBACK_Cancel(ps->pcbRead);
+    }
+    if (ps->pcbWrite) {
+        CALLBACK_Cancel(ps->pcbWrite);
+    }
+    (void)HostRuntime_Watch(ps->fd, 0, NULL, NULL);
+    HostSock_SetConnecting(ps, FALSE);
+    (void)close(ps->fd);
+    ps->fd = -1;
+    ps->bConnected = FALSE;
+    return AEE_SUCCESS;
+}
+
+/*===========================================================================
+INETWORK.
+===========================================================================*/
+
+static void
+HostNet_Delete(void *po)
+{
+    free(po);
+}
+
+int
+HostNet_New(void **ppo)
+{
+    INetwork *pn = (INetwork*)calloc(1, sizeof(INetwork));
+
+    if (NULL == pn) {
+        return ENOMEMORY;
+    }
+    pn->base.nRefs = 1;
+    pn->base.pfnDelete = HostNet_Delete;
+    *ppo = pn;
+    return SUCCESS;
+}
+
+int
+HostNet_OnEvent(INetwork *p, int nEvent, PFNNETWORKEVENT pfn,
+                void *pHandlerData, boolean bRegister)
+{
+    int i;
+
+    for (i = 0; i < s_nHandlers; i++) {
+        if (s_handlers[i].nEvent == nEvent && s_handlers[i].pfn == pfn
+            && s_handlers[i].pData == pHandlerData) {
+            break;
+        }
+    }
+
+    if (!bRegister) {
+        if (i < s_nHandlers) {
+            s_handlers[i] = s_handlers[--s_nHandlers];
+        }
+        return SUCCESS;
+    }
+    if (i == s_nHandlers) {
+        if (HOST_MAX_NET_HANDLERS == s_nHandlers) {
+            return ENOMEMORY;
+        }
+        s_nHandlers++;
+    }
+    s_handlers[i].nEvent = nEvent;
+    s_handlers[i].pfn = pfn;
+    s_handlers[i].pData = pHandlerData;
+    return SUCCESS;
+}
+
+void
+HostNet_SetStatus(AEENetStatus status)
+{
+    HostNetHandler handlers[HOST_MAX_NET_HANDLERS];
+    int nHandlers = s_nHandlers;
+    int i;
+
+    if (status == s_netStatus) {
+        return;
+    }
+    s_netStatus = status;
+
+    MEMCPY(handlers, s_handlers, nHandlers * sizeof(HostNetHandler));
+    for (i = 0; i < nHandlers; i++) {
+        if (NETWORK_EVENT_STATE == handlers[i].nEvent) {
+            handlers[i].pfn(handlers[i].pData, NETWORK_EVENT_STATE);
+        }
+    }
+}
+
+/* The data session has one address, the loopback one. */
+int
+HostNet_GetMyIPAddrs(INetwork *p, IPAddr *pAddrs, int *pnAddrs)
+{
+    if (pAddrs && *pnAddrs > 0) {
+        pAddrs[0].wFamily = AEE_AF_INET;
+        pAddrs[0].addr.v4 = htonl(INADDR_LOOPBACK);
+    }
+    *pnAddrs = 1;
+    return AEE_NET_SUCCESS;
+}
+
+int
+HostNet_NetStatus(INetwork *p, AEENetStatus *pStatus, AEENetStats *pStats)
+{
+    *pStatus = s_netStatus;
+    if (pStats) {
+        MEMSET(pStats, 0, sizeof(AEENetStats));
+        pStats->uBytesSent = HostRuntime_Stats()->nBytesSent;
+        pStats->uBytesRcvd = HostRuntime_Stats()->nBytesRcvd;
+    }
+    return AEE_NET_SUCCESS;
+}
+
+/*===========================================================================
+AEENET HELPERS.
+===========================================================================*/
+
+uint16
+HostShim_htons(uint16 w)
+{
+    return htons(w);
+}
+
+boolean
+HostShim_InetPton(int af, const char *src, void *dst)
+{
+    return AEE_AF_INET == af && inet_pton(AF_INET, src, dst) == 1;
+}
+
+const char *
+HostShim_InetNtop(int af, const void *src, char *dst, int size)
+{
+    if (AEE_AF_INET != af) {
+        return NULL;
+    }
+    return inet_ntop(AF_INET, src, dst, (socklen_t)size);
+}
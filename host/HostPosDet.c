@@ -0,0 +1,276 @@
+/*=============================================================================
+  FILE: HostPosDet.c
+
+  IPosDet answering GetGPSInfo from a fix source on the virtual clock, and
+  a scripted source driving round a circle. See HostRuntime.h.
+  ============================================================================*/
+#include "HostRuntime.h"
+
+#define HOST_PI             3.14159265358979323846
+#define HOST_M_PER_DEGREE   111320.0    // of latitude
+
+struct IPosDet {
+    HostObject   base;
+    AEEGPSConfig config;
+    AEEGPSInfo  *pgi;       // of the pending request
+    AEECallback *pcbApp;    // the pending request, NULL if none
+    AEECallback  cbAnswer;
+    HostGPSFix   fix;       // answer to the pending request
+};
+
+static PFNHOSTGPSNEXT s_pfnNext;
+static void          *s_pCtx;
+static boolean        s_bExhausted;
+static HostCircle     s_circle;
+static uint32        *s_pFixTimes;
+static uint32         s_nFixAlloc;
+
+void
+HostPosDet_SetSource(PFNHOSTGPSNEXT pfnNext, void *pCtx)
+{
+    s_pfnNext = pfnNext;
+    s_pCtx = pCtx;
+    s_bExhausted = FALSE;
+}
+
+/* TRUE once a request found the source dry. */
+boolean
+HostPosDet_Exhausted(void)
+{
+    return s_bExhausted;
+}
+
+const uint32 *
+HostPosDet_FixTimes(uint32 *pnFixes)
+{
+    *pnFixes = HostRuntime_Stats()->nGPSFixes;
+    return s_pFixTimes;
+}
+
+void
+HostPosDet_Term(void)
+{
+    free(s_pFixTimes);
+    s_pFixTimes = NULL;
+    s_nFixAlloc = 0;
+    s_pfnNext = NULL;
+}
+
+/* Count a fix the applet will take, as PosDetApp_CBGetGPSInfo_MultiReq()
+ * does, and note when it came. */
+static void
+HostPosDet_AddFix(const HostGPSFix *pFix)
+{
+    HostStats *pStats = HostRuntime_Stats();
+    uint32 *pNew = NULL;
+
+    if (AEEGPS_ERR_NO_ERR != pFix->status
+        && (AEEGPS_ERR_INFO_UNAVAIL != pFix->status || 0 == pFix->fValid)) {
+        return;
+    }
+    if (pStats->nGPSFixes == s_nFixAlloc) {
+        pNew = (uint32*)realloc(s_pFixTimes,
+                                (s_nFixAlloc + 1024) * sizeof(uint32));
+        if (NULL == pNew) {
+            return;
+        }
+        s_pFixTimes = pNew;
+        s_nFixAlloc += 1024;
+    }
+    s_pFixTimes[pStats->nGPSFixes++] = HostRuntime_Now();
+}
+
+static void
+HostPosDet_Delete(void *po)
+{
+    IPosDet *pp = (IPosDet*)po;
+
+    if (pp->pcbApp) {
+        CALLBACK_Cancel(pp->pcbApp);
+    }
+    free(pp);
+}
+
+int
+HostPosDet_New(void **ppo)
+{
+    IPosDet *pp = (IPosDet*)calloc(1, sizeof(IPosDet));
+
+    if (NULL == pp) {
+        return ENOMEMORY;
+    }
+    pp->base.nRefs = 1;
+    pp->base.pfnDelete = HostPosDet_Delete;
+    pp->config.mode = AEEGPS_MODE_ONE_SHOT;
+    pp->config.nInterval = 1;
+    pp->config.optim = AEEGPS_OPT_DEFAULT;
+    pp->config.qos = 127;
+
+    if (NULL == s_pfnNext) {
+        HostCircle_Init(&s_circle, 0);
+        HostPosDet_SetSource(HostCircle_Next, &s_circle);
+    }
+    *ppo = pp;
+    return SUCCESS;
+}
+
+int
+HostPosDet_GetGPSConfig(IPosDet *pp, AEEGPSConfig *pc)
+{
+    *pc = pp->config;
+    return SUCCESS;
+}
+
+int
+HostPosDet_SetGPSConfig(IPosDet *pp, AEEGPSConfig *pc)
+{
+    pp->config = *pc;
+    return SUCCESS;
+}
+
+static void
+HostPosDet_CancelCb(AEECallback *pcb)
+{
+    IPosDet *pp = (IPosDet*)pcb->pCancelData;
+
+    CALLBACK_Cancel(&pp->cbAnswer);
+    pp->pcbApp = NULL;
+    pcb->pfnCancel = NULL;
+    pcb->pCancelData = NULL;
+}
+
+/* Put the fix into AEEGPSInfo, in the units of the receiver. */
+static void
+HostPosDet_FillInfo(const HostGPSFix *pFix, AEEGPSInfo *pgi)
+{
+    double heading = FFLOOR(pFix->heading * 1024.0 / 360.0 + 0.5);
+
+    MEMSET(pgi, 0, sizeof(AEEGPSInfo));
+    pgi->dwTimeStamp = pFix->dwTime ? pFix->dwTime : GETTIMESECONDS();
+    pgi->status = pFix->status;
+    pgi->fValid = pFix->fValid;
+    pgi->dwLat = (int32)FFLOOR(pFix->lat * 33554432.0 / 180.0 + 0.5);
+    pgi->dwLon = (int32)FFLOOR(pFix->lon * 67108864.0 / 360.0 + 0.5);
+    pgi->wAltitude = (int16)FFLOOR(pFix->alt + 500.0 + 0.5);
+    pgi->wHeading = (uint16)((int32)heading & 1023);
+    pgi->wVelocityHor = (uint16)FFLOOR(pFix->speed * 4.0 + 0.5);
+    pgi->bVelocityVer = (int8)FFLOOR(pFix->vspeed * 2.0 + 0.5);
+    pgi->accuracy = AEEGPS_ACCURACY_LEVEL1;
+}
+
+static void
+HostPosDet_Answer(void *po)
+{
+    IPosDet *pp = (IPosDet*)po;
+    AEECallback *pcb = pp->pcbApp;
+
+    HostPosDet_FillInfo(&pp->fix, pp->pgi);
+    HostRuntime_Stats()->nGPSAnswers++;
+    HostPosDet_AddFix(&pp->fix);
+
+    pp->pcbApp = NULL;
+    pcb->pfnCancel = NULL;
+    pcb->pCancelData = NULL;
+    HostShell_Resume(HostRuntime_Shell(), pcb);
+}
+
+int
+HostPosDet_GetGPSInfo(IPosDet *pp, AEEGPSReq req, AEEGPSAccuracy acc,
+                      AEEGPSInfo *pgi, AEECallback *pcb)
+{
+    HostRuntime_Stats()->nGPSRequests++;
+
+    if (pp->pcbApp) {
+        return EALREADY;
+    }
+    MEMSET(&pp->fix, 0, sizeof(HostGPSFix));
+    if (!s_pfnNext(s_pCtx, &pp->config, &pp->fix)) {
+        s_bExhausted = TRUE;
+        return EFAILED;
+    }
+
+    CALLBACK_Cancel(pcb);
+    pp->pgi = pgi;
+    pp->pcbApp = pcb;
+    pcb->pfnCancel = HostPosDet_CancelCb;
+    pcb->pCancelData = pp;
+
+    if (!pp->fix.bNoAnswer) {
+        CALLBACK_Init(&pp->cbAnswer, HostPosDet_Answer, pp);
+        (void)ISHELL_SetTimerEx(HostRuntime_Shell(), (int32)pp->fix.nLatency,
+                                &pp->cbAnswer);
+    }
+    return SUCCESS;
+}
+
+int
+HostPosDet_ExtractPositionInfo(IPosDet *pp, AEEGPSInfo *pgi,
+                               AEEPositionInfoEx *ppie)
+{
+    ppie->fLatitude = (pgi->fValid & AEEGPS_VALID_LAT) != 0;
+    ppie->Latitude = pgi->dwLat * 180.0 / 33554432.0;
+    ppie->fLongitude = (pgi->fValid & AEEGPS_VALID_LON) != 0;
+    ppie->Longitude = pgi->dwLon * 360.0 / 67108864.0;
+    ppie->fAltitude = (pgi->fValid & AEEGPS_VALID_ALT) != 0;
+    ppie->nAltitude = pgi->wAltitude - 500;
+    ppie->fHeading = (pgi->fValid & AEEGPS_VALID_HEAD) != 0;
+    ppie->Heading = pgi->wHeading * 360.0 / 1024.0;
+    ppie->fHorVelocity = (pgi->fValid & AEEGPS_VALID_HVEL) != 0;
+    ppie->HorVelocity = pgi->wVelocityHor * 0.25;
+    ppie->fVerVelocity = (pgi->fValid & AEEGPS_VALID_VVEL) != 0;
+    ppie->VerVelocity = pgi->bVelocityVer * 0.5;
+    ppie->fHorUnc = FALSE;
+    return SUCCESS;
+}
+
+/*===========================================================================
+SCRIPTED SOURCE.
+===========================================================================*/
+
+void
+HostCircle_Init(HostCircle *pc, uint32 nFixes)
+{
+    MEMSET(pc, 0, sizeof(HostCircle));
+    pc->lat = 31.2304;
+    pc->lon = 121.4737;
+    pc->radius = 500.0;
+    pc->speed = 10.0;
+    pc->nTTFF = 8000;
+    pc->nFixes = nFixes;
+}
+
+boolean
+HostCircle_Next(void *pCtx, const AEEGPSConfig *pConfig, HostGPSFix *pFix)
+{
+    HostCircle *pc = (HostCircle*)pCtx;
+    uint32 nInterval = MAX(pConfig->nInterval, 1) * 1000;
+    double heading = 0;
+
+    if (pc->nFixes > 0 && pc->nGiven >= pc->nFixes) {
+        return FALSE;
+    }
+
+    if (0 == pc->nGiven) {
+        pFix->nLatency = pc->nTTFF;
+    }
+    else {
+        pFix->nLatency = nInterval;
+        pc->angle += pc->speed * (nInterval / 1000.0) / pc->radius;
+    }
+    pc->nGiven++;
+
+    /* Counterclockwise, east is x and north is y. */
+    pFix->status = AEEGPS_ERR_NO_ERR;
+    pFix->fValid = AEEGPS_VALID_LAT | AEEGPS_VALID_LON | AEEGPS_VALID_ALT
+                   | AEEGPS_VALID_HEAD | AEEGPS_VALID_HVEL
+                   | AEEGPS_VALID_VVEL;
+    pFix->lat = pc->lat + pc->radius * sin(pc->angle) / HOST_M_PER_DEGREE;
+    pFix->lon = pc->lon + pc->radius * cos(pc->angle)
+                / (HOST_M_PER_DEGREE * cos(pc->lat * HOST_PI / 180.0));
+    pFix->alt = 12.0;
+    heading = atan2(-sin(pc->angle), cos(pc->angle)) * 180.0 / HOST_PI;
+    pFix->heading = heading < 0 ? heading + 360.0 : heading;
+    pFix->speed = pc->speed;
+    pFix->vspeed = 0;
+    return TRUE;
+}
@@ -0,0 +1,464 @@
+/*=============================================================================
+  FILE: HostReplay.c
+
+  GPS receiver replaying NMEA or EHL traces. See HostReplay.h.
+  ============================================================================*/
+#include <time.h>
+
+#include "HostReplay.h"
+#include "PosDetCodec.h"
+
+#define HRP_MAX_FIELDS      24
+#define HRP_KNOT            0.514444    // m/s
+#define HRP_EHL_ZONE_SECS   (8 * 3600)  // the EHL time is GMT+8
+#define HRP_DAY_SECS        86400
+
+/* NMEA epoch being put together from the sentences of the same second. */
+typedef struct _HostNmeaEpoch {
+    boolean    bOpen;
+    char       szTime[16];  // hhmmss.ss as in the sentences
+    double     dDay;        // seconds of the day
+    HostGPSFix fix;
+    boolean    bFixed;      // a sentence said there was a fix
+    boolean    bNoFix;      // a sentence said there was none
+} HostNmeaEpoch;
+
+typedef struct _HostLoader {
+    HostReplay   *pr;
+    HostNmeaEpoch epoch;
+    double        dDate;    // GPS seconds of 00:00 of the last RMC date
+} HostLoader;
+
+void
+HostReplay_Init(HostReplay *pr)
+{
+    MEMSET(pr, 0, sizeof(HostReplay));
+}
+
+void
+HostReplay_Free(HostReplay *pr)
+{
+    free(pr->pFixes);
+    HostReplay_Init(pr);
+}
+
+boolean
+HostReplay_Inject(HostReplay *pr, uint32 nRequest, uint32 status)
+{
+    if (HRP_MAX_INJECT == pr->nInject || 0 == nRequest) {
+        return FALSE;
+    }
+    pr->inject[pr->nInject].nRequest = nRequest;
+    pr->inject[pr->nInject].status = status;
+    pr->nInject++;
+    return TRUE;
+}
+
+/* Append a fix. Fixes going back in time are dropped. */
+static int
+HostReplay_Add(HostReplay *pr, double dTime, const HostGPSFix *pFix)
+{
+    HostReplayFix *pNew = NULL;
+
+    if (pr->nFixes > 0 && dTime <= pr->pFixes[pr->nFixes - 1].dTime) {
+        pr->nSkipped++;
+        return SUCCESS;
+    }
+    if (pr->nFixes == pr->nAlloc) {
+        pNew = (HostReplayFix*)realloc(pr->pFixes, (pr->nAlloc + 1024)
+                                                   * sizeof(HostReplayFix));
+        if (NULL == pNew) {
+            return ENOMEMORY;
+        }
+        pr->pFixes = pNew;
+        pr->nAlloc += 1024;
+    }
+    pr->pFixes[pr->nFixes].dTime = dTime;
+    pr->pFixes[pr->nFixes].fix = *pFix;
+    pr->pFixes[pr->nFixes].fix.dwTime = (uint32)dTime;
+    pr->nFixes++;
+    return SUCCESS;
+}
+
+/* GPS seconds of 00:00:00 GMT of the date. */
+static double
+HostReplay_GPSDate(int nYear, int nMonth, int nDay)
+{
+    struct tm tm;
+
+    MEMSET(&tm, 0, sizeof(tm));
+    tm.tm_year = nYear - 1900;
+    tm.tm_mon = nMonth - 1;
+    tm.tm_mday = nDay;
+    return (double)timegm(&tm) - PDC_GPS_TO_UNIX_SECS;
+}
+
+/* Split psz at the commas, in place. Empty fields are kept. Returns the
+ * number of fields. */
+static int
+HostReplay_Split(char *psz, char **ppFields, int nMax)
+{
+    int n = 0;
+
+    ppFields[n++] = psz;
+    for (; *psz && n < nMax; psz++) {
+        if (',' == *psz) {
+            *psz = '\0';
+            ppFields[n++] = psz + 1;
+        }
+    }
+    return n;
+}
+
+/*===========================================================================
+NMEA.
+===========================================================================*/
+
+/* Check and strip the "*hh" checksum, if there is one. */
+static boolean
+HostReplay_NmeaChecksum(char *pszLine)
+{
+    char *p = pszLine + 1;      // past '$'
+    byte sum = 0;
+
+    for (; *p && '*' != *p; p++) {
+        sum ^= (byte)*p;
+    }
+    if ('\0' == *p) {
+        return TRUE;
+    }
+    *p = '\0';
+    return strtoul(p + 1, NULL, 16) == sum;
+}
+
+/* ddmm.mmmm, or dddmm.mmmm, and the hemisphere to degrees. */
+static boolean
+HostReplay_NmeaAngle(const char *pszValue, const char *pszHemi, double *pd)
+{
+    double v = 0;
+
+    if ('\0' == *pszValue || '\0' == *pszHemi) {
+        return FALSE;
+    }
+    v = atof(pszValue);
+    *pd = FFLOOR(v / 100.0) + fmod(v, 100.0) / 60.0;
+    if ('S' == *pszHemi || 'W' == *pszHemi) {
+        *pd = -*pd;
+    }
+    return TRUE;
+}
+
+/* The epoch is complete, add it. */
+static int
+HostReplay_NmeaFlush(HostLoader *pl)
+{
+    HostNmeaEpoch *pe = &pl->epoch;
+    double dTime = 0;
+
+    if (!pe->bOpen) {
+        return SUCCESS;
+    }
+    pe->bOpen = FALSE;
+
+    dTime = pl->dDate + pe->dDay;
+    if (pl->pr->nFixes > 0
+        && dTime < pl->pr->pFixes[pl->pr->nFixes - 1].dTime
+                   - HRP_DAY_SECS / 2) {
+        dTime += HRP_DAY_SECS;      // past midnight, no RMC yet
+    }
+
+    if (pe->bNoFix || !pe->bFixed) {
+        pe->fix.status = AEEGPS_ERR_INFO_UNAVAIL;
+        pe->fix.fValid = 0;
+    }
+    else {
+        pe->fix.status = AEEGPS_ERR_NO_ERR;
+    }
+    return HostReplay_Add(pl->pr, dTime, &pe->fix);
+}
+
+/* Start a new epoch if the sentence is of another second. */
+static int
+HostReplay_NmeaEpoch(HostLoader *pl, const char *pszTime)
+{
+    HostNmeaEpoch *pe = &pl->epoch;
+    double v = atof(pszTime);
+    int err = SUCCESS;
+
+    if (pe->bOpen && STRCMP(pe->szTime, pszTime) == 0) {
+        return SUCCESS;
+    }
+    err = HostReplay_NmeaFlush(pl);
+
+    MEMSET(pe, 0, sizeof(HostNmeaEpoch));
+    pe->bOpen = TRUE;
+    (void)HostShim_Strlcpy(pe->szTime, pszTime, sizeof(pe->szTime));
+    pe->dDay = FFLOOR(v / 10000.0) * 3600.0
+               + FFLOOR(fmod(v, 10000.0) / 100.0) * 60.0 + fmod(v, 100.0);
+    return err;
+}
+
+/* $xxRMC,time,status,lat,N,lon,E,knots,course,ddmmyy,... */
+static int
+HostReplay_NmeaRMC(HostLoader *pl, char **ppf, int n)
+{
+    HostNmeaEpoch *pe = &pl->epoch;
+    int nDate = 0;
+    int err = SUCCESS;
+
+    if (n < 10 || '\0' == *ppf[1]) {
+        return EFAILED;
+    }
+    err = HostReplay_NmeaEpoch(pl, ppf[1]);
+    if (*ppf[9]) {      // of this epoch, the one before may be of yesterday
+        nDate = atoi(ppf[9]);
+        pl->dDate = HostReplay_GPSDate(2000 + nDate % 100,
+                                       nDate / 100 % 100, nDate / 10000);
+    }
+
+    if ('A' != *ppf[2]) {
+        pe->bNoFix = TRUE;
+        return err;
+    }
+    pe->bFixed = TRUE;
+    if (HostReplay_NmeaAngle(ppf[3], ppf[4], &pe->fix.lat)
+        && HostReplay_NmeaAngle(ppf[5], ppf[6], &pe->fix.lon)) {
+        pe->fix.fValid |= AEEGPS_VALID_LAT | AEEGPS_VALID_LON;
+    }
+    if (*ppf[7]) {
+        pe->fix.speed = atof(ppf[7]) * HRP_KNOT;
+        pe->fix.fValid |= AEEGPS_VALID_HVEL;
+    }
+    if (*ppf[8]) {
+        pe->fix.heading = atof(ppf[8]);
+        pe->fix.fValid |= AEEGPS_VALID_HEAD;
+    }
+    return err;
+}
+
+/* $xxGGA,time,lat,N,lon,E,quality,sats,hdop,alt,M,... */
+static int
+HostReplay_NmeaGGA(HostLoader *pl, char **ppf, int n)
+{
+    HostNmeaEpoch *pe = &pl->epoch;
+    int err = SUCCESS;
+
+    if (n < 10 || '\0' == *ppf[1]) {
+        return EFAILED;
+    }
+    err = HostReplay_NmeaEpoch(pl, ppf[1]);
+
+    if ('\0' == *ppf[6] || '0' == *ppf[6]) {
+        pe->bNoFix = TRUE;
+        return err;
+    }
+    pe->bFixed = TRUE;
+    if (HostReplay_NmeaAngle(ppf[2], ppf[3], &pe->fix.lat)
+        && HostReplay_NmeaAngle(ppf[4], ppf[5], &pe->fix.lon)) {
+        pe->fix.fValid |= AEEGPS_VALID_LAT | AEEGPS_VALID_LON;
+    }
+    if (*ppf[9]) {
+        pe->fix.alt = atof(ppf[9]);
+        pe->fix.fValid |= AEEGPS_VALID_ALT;
+    }
+    return err;
+}
+
+static int
+HostReplay_Nmea(HostLoader *pl, char *pszLine)
+{
+    char *ppf[HRP_MAX_FIELDS];
+    int n = 0;
+
+    if (!HostReplay_NmeaChecksum(pszLine)) {
+        return EFAILED;
+    }
+    n = HostReplay_Split(pszLine, ppf, HRP_MAX_FIELDS);
+    if (STRLEN(ppf[0]) != 6) {
+        return EFAILED;
+    }
+    if (STRCMP(ppf[0] + 3, "RMC") == 0) {
+        return HostReplay_NmeaRMC(pl, ppf, n);
+    }
+    if (STRCMP(ppf[0] + 3, "GGA") == 0) {
+        return HostReplay_NmeaGGA(pl, ppf, n);
+    }
+    return SUCCESS;     // other sentences carry nothing we replay
+}
+
+/*===========================================================================
+EHL.
+===========================================================================*/
+
+/* {EHL,A,02,id,YYYY-MM-DD HH:MM:SS,lat,lon,alt,speed,heading,...,EHL}
+ * as made by PosDetApp_MakeReportStr(). The hour is of GMT+8 and may be
+ * past 23. */
+static int
+HostReplay_Ehl(HostLoader *pl, char *pszReport)
+{
+    char *ppf[HRP_MAX_FIELDS];
+    HostGPSFix fix;
+    int nYear, nMonth, nDay, nHour, nMin, nSec;
+    double dTime = 0;
+    int n = 0;
+
+    n = HostReplay_Split(pszReport, ppf, HRP_MAX_FIELDS);
+    if (n < 10
+        || sscanf(ppf[4], "%d-%d-%d %d:%d:%d", &nYear, &nMonth, &nDay,
+                  &nHour, &nMin, &nSec) != 6) {
+        return EFAILED;
+    }
+    dTime = HostReplay_GPSDate(nYear, nMonth, nDay)
+            + nHour * 3600.0 + nMin * 60.0 + nSec - HRP_EHL_ZONE_SECS;
+
+    MEMSET(&fix, 0, sizeof(fix));
+    fix.status = AEEGPS_ERR_NO_ERR;
+    if (*ppf[5] && *ppf[6]) {
+        fix.lat = atof(ppf[5]);
+        fix.lon = atof(ppf[6]);
+        fix.fValid |= AEEGPS_VALID_LAT | AEEGPS_VALID_LON;
+    }
+    if (*ppf[7]) {
+        fix.alt = atof(ppf[7]);
+        fix.fValid |= AEEGPS_VALID_ALT;
+    }
+    if (*ppf[8]) {
+        fix.speed = atof(ppf[8]);
+        fix.fValid |= AEEGPS_VALID_HVEL;
+    }
+    if (*ppf[9]) {
+        fix.heading = atof(ppf[9]);
+        fix.fValid |= AEEGPS_VALID_HEAD;
+    }
+    return HostReplay_Add(pl->pr, dTime, &fix);
+}
+
+/*===========================================================================
+LOADING AND REPLAYING.
+===========================================================================*/
+
+int
+HostReplay_Load(HostReplay *pr, const char *pszFile)
+{
+    HostLoader loader;
+    char szLine[512];
+    char *psz = NULL;
+    FILE *pf = NULL;
+    int err = SUCCESS;
+
+    pf = fopen(pszFile, "r");
+    if (NULL == pf) {
+        return EFILENOEXISTS;
+    }
+    MEMSET(&loader, 0, sizeof(loader));
+    loader.pr = pr;
+    loader.dDate = HOST_START_GPS_SECS;
+
+    while (SUCCESS == err && fgets(szLine, sizeof(szLine), pf)) {
+        szLine[strcspn(szLine, "\r\n")] = '\0';
+
+        if ('$' == szLine[0]) {
+            err = HostReplay_Nmea(&loader, szLine);
+        }
+        else if ((psz = STRSTR(szLine, "{EHL,")) != NULL) {
+            err = HostReplay_NmeaFlush(&loader);
+            if (SUCCESS == err) {
+                err = HostReplay_Ehl(&loader, psz);
+            }
+        }
+        else {
+            err = EFAILED;
+        }
+
+        if (EFAILED == err) {
+            pr->nSkipped++;
+            err = SUCCESS;
+        }
+    }
+    if (SUCCESS == err) {
+        err = HostReplay_NmeaFlush(&loader);
+    }
+    fclose(pf);
+    return err;
+}
+
+/* Fixes of the trace a receiver tracking at nInterval seconds would give
+ * in its first dSecs seconds, each at least nInterval after the one
+ * before, not counting the epochs without a fix. Injected errors are not
+ * taken into account. */
+uint32
+HostReplay_Due(const HostReplay *pr, uint32 nInterval, double dSecs)
+{
+    const HostReplayFix *pf = NULL;
+    double dLast = 0;
+    uint32 nDue = 0;
+    uint32 i;
+
+    for (i = 0; i < pr->nFixes; i++) {
+        pf = &pr->pFixes[i];
+        if (pf->dTime - pr->pFixes[0].dTime > dSecs) {
+            break;
+        }
+        if (i > 0 && pf->dTime < dLast + MAX(nInterval, 1)) {
+            continue;
+        }
+        dLast = pf->dTime;
+        if (AEEGPS_ERR_NO_ERR == pf->fix.status) {
+            nDue++;
+        }
+    }
+    return nDue;
+}
+
+boolean
+HostReplay_Next(void *pCtx, const AEEGPSConfig *pConfig, HostGPSFix *pFix)
+{
+    HostReplay *pr = (HostReplay*)pCtx;
+    const HostReplayFix *pNext = NULL;
+    double dNow = 0;
+    double dWant = 0;
+    uint32 i;
+
+    pr->nRequests++;
+    if (pr->nNext >= pr->nFixes) {
+        return FALSE;
+    }
+
+    if (!pr->bStarted) {
+        pr->bStarted = TRUE;
+        pr->dwStart = HostRuntime_Now();
+        pr->dLast = pr->pFixes[0].dTime - HRP_DAY_SECS;
+    }
+    dNow = pr->pFixes[0].dTime + (HostRuntime_Now() - pr->dwStart) / 1000.0;
+
+    dWant = dNow;
+    if (AEEGPS_MODE_ONE_SHOT != pConfig->mode
+        && pr->dLast + MAX(pConfig->nInterval, 1) > dWant) {
+        dWant = pr->dLast + MAX(pConfig->nInterval, 1);
+    }
+    while (pr->nNext < pr->nFixes && pr->pFixes[pr->nNext].dTime < dWant) {
+        pr->nNext++;
+    }
+    if (pr->nNext >= pr->nFixes) {
+        return FALSE;
+    }
+
+    pNext = &pr->pFixes[pr->nNext++];
+    *pFix = pNext->fix;
+    pFix->nLatency = (uint32)FFLOOR((pNext->dTime - dNow) * 1000.0 + 0.5);
+    pr->dLast = pNext->dTime;
+
+    for (i = 0; i < pr->nInject; i++) {
+        if (pr->inject[i].nRequest != pr->nRequests) {
+            continue;
+        }
+        if (HRP_NO_ANSWER == pr->inject[i].status) {
+            pFix->bNoAnswer = TRUE;
+        }
+        else {
+            pFix->status = pr->inject[i].status;
+            pFix->fValid = 0;
+        }
+    }
+    return TRUE;
+}
@@ -0,0 +1,62 @@
+#ifndef HOSTREPLAY_H
+#define HOSTREPLAY_H
+
+#include "HostRuntime.h"
+
+/*
+ * GPS receiver replaying a recorded trace, a fix source for HostPosDet.
+ *
+ * A trace is read from a file of NMEA sentences, $GPRMC and $GPGGA of
+ * the same second making one fix, or of "{EHL,...}" report lines such as
+ * the applet's own log0.txt. Other lines are skipped. The file may mix
+ * both.
+ *
+ * The trace runs on the virtual clock from the first request on. A request
+ * is answered with the first fix that is not in the past and, in the
+ * tracking modes, at least the tracking interval after the fix given
+ * before, when that fix is due. Gaps in the trace thus leave requests
+ * waiting, as a receiver losing the sky does. How fast the virtual clock
+ * goes is up to HostRuntime_SetPace(), the answers are the same at any
+ * speed.
+ *
+ * Errors are injected by request number, counting from 1: the request is
+ * answered with the status, or with HRP_NO_ANSWER never answered.
+ */
+
+#define HRP_MAX_INJECT      64
+#define HRP_NO_ANSWER       0xFFFFFFFFUL
+
+typedef struct _HostReplayFix {
+    double     dTime;       // GPS seconds
+    HostGPSFix fix;
+} HostReplayFix;
+
+typedef struct _HostInject {
+    uint32 nRequest;
+    uint32 status;          // AEEGPS_ERR_*, or HRP_NO_ANSWER
+} HostInject;
+
+typedef struct _HostReplay {
+    HostReplayFix *pFixes;
+    uint32         nFixes;
+    uint32         nAlloc;
+    uint32         nNext;       // next fix to give
+    uint32         nSkipped;    // lines not understood
+    uint32         nRequests;
+    boolean        bStarted;
+    uint32         dwStart;     // uptime ms of the first request
+    double         dLast;       // time of the last fix given, GPS seconds
+    HostInject     inject[HRP_MAX_INJECT];
+    uint32         nInject;
+} HostReplay;
+
+void    HostReplay_Init(HostReplay *pr);
+int     HostReplay_Load(HostReplay *pr, const char *pszFile);
+boolean HostReplay_Inject(HostReplay *pr, uint32 nRequest, uint32 status);
+void    HostReplay_Free(HostReplay *pr);
+boolean HostReplay_Next(void *pCtx, const AEEGPSConfig *pConfig,
+                        HostGPSFix *pFix);
+uint32  HostReplay_Due(const HostReplay *pr, uint32 nInterval,
+                       double dSecs);
+
+#endif /* ifndef HOSTREPLAY_H */
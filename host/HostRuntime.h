@@ -0,0 +1,150 @@
+#ifndef HOSTRUNTIME_H
+#define HOSTRUNTIME_H
+
+#include "brewshim.h"
+
+/*
+ * Host runtime behind the BREW shim, see inc/brewshim.h.
+ *
+ * Time is virtual: GETUPTIMEMS() only moves when HostRuntime_Run() has
+ * nothing left to do now and jumps to the next timer, so an hour of
+ * tracking runs in as long as its callbacks take, and the same inputs give
+ * the same run.
+ *
+ * Callbacks queued by ISHELL_Resume(), ISHELL_SetTimer[Ex]() and the
+ * stand-in interfaces are dispatched one at a time, in order of time,
+ * resumes before timers, then in the order they were queued.
+ *
+ * ISockPort is a real non-blocking socket, readiness is polled between two
+ * callbacks. Host side peers, e.g. HostServer, watch their own descriptors
+ * through HostRuntime_Watch() and run in the same loop.
+ */
+
+#define HOST_MAX_TIMERS     64
+#define HOST_MAX_WATCHES    16
+
+/* GPS time the virtual clock starts at, 2012-08-07 00:00:00 GMT. */
+#define HOST_START_GPS_SECS 1028332800UL
+
+typedef struct _HostStats {
+    uint32 nAllocs;         // MALLOC calls
+    uint32 nFrees;
+    uint32 nAllocBytes;     // bytes asked for, in total
+    uint32 nInUseBytes;     // bytes not freed yet
+    uint32 nDispatched;     // callbacks and timers run
+    uint32 nDrawText;
+    uint32 nDisplayUpdates;
+    uint32 nGPSRequests;
+    uint32 nGPSAnswers;
+    uint32 nGPSFixes;       // answers the applet takes for a fix
+    uint32 nConnects;       // ISockPort_Connect() succeeded
+    uint32 nBytesSent;      // by ISockPort_Write()
+    uint32 nBytesRcvd;      // by ISockPort_Read()
+    uint32 nFileWrites;     // IFILE_Write() calls
+    uint32 nFileBytes;      // bytes written to files
+} HostStats;
+
+typedef void (*PFNHOSTWATCH)(void *pUser, int fd, short revents);
+
+void       HostRuntime_Init(const char *pszRoot, boolean bVerbose);
+void       HostRuntime_Term(void);
+IShell    *HostRuntime_Shell(void);
+HostStats *HostRuntime_Stats(void);
+uint32     HostRuntime_Now(void);
+const char *HostRuntime_Root(void);
+boolean    HostRuntime_Verbose(void);
+
+/* Run callbacks until dwUntil ms of uptime, the applet closes or nothing is
+ * left to run. Returns FALSE once the applet closed. */
+boolean    HostRuntime_Run(uint32 dwUntil);
+
+/* Pace the virtual clock at dFactor times real time from now on, 1 for
+ * real time. 0, the default, lets it jump as fast as the callbacks run.
+ * Timers still run at their virtual time, a paced run only takes longer
+ * and gives loopback peers real time to answer in. */
+void       HostRuntime_SetPace(double dFactor);
+
+/* Call pfn from the loop once fd is ready for events, POLLIN and POLLOUT.
+ * Watching fd again changes the events, 0 stops watching it. */
+int        HostRuntime_Watch(int fd, short events, PFNHOSTWATCH pfn,
+                             void *pUser);
+
+/* Create the applet of clsID and send it EVT_APP_START, or
+ * EVT_APP_START_BACKGROUND. */
+int        HostRuntime_StartApplet(AEECLSID clsID, boolean bBackground);
+boolean    HostRuntime_SendEvent(AEEEvent evt, uint16 wParam, uint32 dwParam);
+void       HostRuntime_StopApplet(void);
+
+/*
+ * GPS receiver behind IPosDet. Each request takes the next fix of the
+ * source; the answer comes nLatency ms later, or never if bNoAnswer, so
+ * the applet times out.
+ */
+typedef struct _HostGPSFix {
+    uint32  nLatency;       // ms from the request to the answer
+    boolean bNoAnswer;      // leave the request unanswered
+    uint32  status;         // AEEGPS_ERR_*
+    uint32  dwTime;         // GPS seconds, 0 for the virtual clock
+    uint16  fValid;         // AEEGPS_VALID_* of the fields below
+    double  lat;            // degree
+    double  lon;            // degree
+    double  alt;            // metre
+    double  heading;        // degree
+    double  speed;          // m/s, horizontal
+    double  vspeed;         // m/s, vertical
+} HostGPSFix;
+
+/* Fill pFix with the fix for a request made under pConfig. Returns FALSE
+ * when the source has run dry, the request then fails. */
+typedef boolean (*PFNHOSTGPSNEXT)(void *pCtx, const AEEGPSConfig *pConfig,
+                                  HostGPSFix *pFix);
+
+void    HostPosDet_SetSource(PFNHOSTGPSNEXT pfnNext, void *pCtx);
+boolean HostPosDet_Exhausted(void);
+
+/* Uptime ms each of the nGPSFixes fixes was answered at, in order. */
+const uint32 *HostPosDet_FixTimes(uint32 *pnFixes);
+void    HostPosDet_Term(void);
+
+/* Vehicle going round a circle of radius metres at speed m/s, a fix every
+ * tracking interval, the first one after nTTFF ms. */
+typedef struct _HostCircle {
+    double lat;
+    double lon;
+    double radius;
+    double speed;
+    uint32 nTTFF;
+    uint32 nFixes;      // fixes to give, 0 for no end
+    uint32 nGiven;
+    double angle;       // radian, where the vehicle is
+} HostCircle;
+
+void    HostCircle_Init(HostCircle *pc, uint32 nFixes);
+boolean HostCircle_Next(void *pCtx, const AEEGPSConfig *pConfig,
+                        HostGPSFix *pFix);
+
+/* Flash going bad: the nWrite-th IFILE_Write() to the applet's pszFile,
+ * counted from 1, has a bit flipped in its last byte. */
+void    HostFile_Corrupt(const char *pszFile, uint32 nWrite);
+
+/*
+ * For the stand-ins: every interface object starts with a HostObject, so
+ * HostShim_Release() can release any of them.
+ */
+typedef struct _HostObject {
+    uint32 nRefs;
+    void (*pfnDelete)(void *po);
+} HostObject;
+
+int  HostPosDet_New(void **ppo);
+int  HostFileMgr_New(void **ppo);
+int  HostSock_New(void **ppo);
+int  HostNet_New(void **ppo);
+void HostShell_CancelCallback(AEECallback *pcb);
+boolean HostSock_Connecting(void);
+
+/* Data session behind INetwork. A new status is sent to the
+ * NETWORK_EVENT_STATE handlers. */
+void    HostNet_SetStatus(AEENetStatus status);
+
+#endif /* ifndef HOSTRUNTIME_H */
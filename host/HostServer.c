@@ -0,0 +1,325 @@
+/*=============================================================================
+  FILE: HostServer.c
+
+  Loopback report server for the host runtime. See HostServer.h.
+  ============================================================================*/
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "HostServer.h"
+#include "PosDetCodec.h"
+#include "PosDetStats.h"
+
+static uint32
+HostServer_GetBE32(const byte *p)
+{
+    return ((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8)
+           | p[3];
+}
+
+/* Note when the report that is nReports came in. */
+static void
+HostServer_AddArrival(HostServer *ps)
+{
+    uint32 *pNew = NULL;
+
+    if (ps->nReports >= ps->nArrivalAlloc) {
+        pNew = (uint32*)realloc(ps->pArrivals,
+                                (ps->nReports + 1024) * sizeof(uint32));
+        if (NULL == pNew) {
+            return;
+        }
+        ps->pArrivals = pNew;
+        ps->nArrivalAlloc = ps->nReports + 1024;
+    }
+    ps->pArrivals[ps->nReports] = HostRuntime_Now();
+}
+
+/* Take the report with sequence number dwSeq, of nLen bytes, returns TRUE
+ * if it was new and in sequence. */
+static boolean
+HostServer_TakeSeq(HostServer *ps, uint32 dwSeq, uint16 nLen)
+{
+    if (!ps->bHaveSeq) {
+        ps->bHaveSeq = TRUE;
+        ps->dwNextSeq = dwSeq;
+    }
+    if (dwSeq == ps->dwNextSeq) {
+        HostServer_AddArrival(ps);
+        ps->dwNextSeq++;
+        ps->nReports++;
+        if (0 == nLen) {
+            ps->nSkips++;
+        }
+        return TRUE;
+    }
+    if ((int32)(dwSeq - ps->dwNextSeq) < 0) {
+        ps->nDups++;
+    }
+    else {
+        ps->nGaps++;
+    }
+    return FALSE;
+}
+
+/* Take a report frame, returns TRUE if it was new and in sequence. */
+static boolean
+HostServer_OnReport(HostServer *ps, const byte *pPayload, uint16 nPayload)
+{
+    if (nPayload < 4) {
+        ps->nBadFrames++;
+        return FALSE;
+    }
+    return HostServer_TakeSeq(ps, HostServer_GetBE32(pPayload),
+                              (uint16)(nPayload - 4));
+}
+
+/* Take a batch frame, returns TRUE if any of its reports was new and in
+ * sequence. */
+static boolean
+HostServer_OnBatch(HostServer *ps, const byte *pPayload, uint16 nPayload)
+{
+    uint32 dwSeq = 0;
+    uint16 nOff = 4;
+    uint16 nLen = 0;
+    boolean bNew = FALSE;
+
+    if (nPayload < 5) {
+        ps->nBadFrames++;
+        return FALSE;
+    }
+    dwSeq = HostServer_GetBE32(pPayload);
+
+    while (nOff < nPayload) {
+        nLen = pPayload[nOff] & 0x7F;
+        if (pPayload[nOff++] & 0x80) {
+            if (nOff == nPayload) {
+                break;
+            }
+            nLen |= (uint16)(pPayload[nOff++] << 7);
+        }
+        if (nLen > nPayload - nOff) {
+            break;
+        }
+        nOff += nLen;
+        if (HostServer_TakeSeq(ps, dwSeq++, nLen)) {
+            bNew = TRUE;
+        }
+    }
+    if (nOff != nPayload) {
+        ps->nBadFrames++;
+    }
+    return bNew;
+}
+
+/* Handle the whole frames in pBuf. Returns the bytes used, and in *pbNew
+ * whether new reports came in. */
+static int
+HostServer_OnFrames(HostServer *ps, const byte *pBuf, int nLen,
+                    boolean *pbNew)
+{
+    const byte *pPayload = NULL;
+    uint16 nPayload = 0;
+    byte type = 0;
+    int nUsed = 0;
+    int n = 0;
+
+    while ((n = PosDetCodec_ParseFrame(pBuf + nUsed, nLen - nUsed, &type,
+                                       &pPayload, &nPayload)) > 0) {
+        nUsed += n;
+        switch (type) {
+        case PDC_FRAME_HELLO:
+            ps->nHellos++;
+            break;
+        case PDC_FRAME_REPORT:
+            if (HostServer_OnReport(ps, pPayload, nPayload)) {
+                *pbNew = TRUE;
+            }
+            break;
+        case PDC_FRAME_BATCH:
+            if (HostServer_OnBatch(ps, pPayload, nPayload)) {
+                *pbNew = TRUE;
+            }
+            break;
+        case PDC_FRAME_STATS:
+            if (nPayload > 0 && PDST_VERSION == pPayload[0]) {
+                ps->nStats++;
+            }
+            else {
+                ps->nBadFrames++;
+            }
+            break;
+        default:
+            ps->nBadFrames++;
+            break;
+        }
+    }
+    return nUsed;
+}
+
+/* ACK frame of the last report in sequence into pAck, returns its size. */
+static int
+HostServer_MakeAck(HostServer *ps, byte *pAck)
+{
+    uint32 dwSeq = ps->dwNextSeq - 1;
+
+    (void)PosDetCodec_PutFrameHdr(pAck, PDC_FRAME_ACK, 4);
+    pAck[PDC_FRAME_HDR_SIZE] = (byte)(dwSeq >> 24);
+    pAck[PDC_FRAME_HDR_SIZE + 1] = (byte)(dwSeq >> 16);
+    pAck[PDC_FRAME_HDR_SIZE + 2] = (byte)(dwSeq >> 8);
+    pAck[PDC_FRAME_HDR_SIZE + 3] = (byte)dwSeq;
+    ps->nAcks++;
+    return PDC_FRAME_HDR_SIZE + 4;
+}
+
+static void
+HostServer_CloseConn(HostServer *ps)
+{
+    if (ps->fdConn >= 0) {
+        (void)HostRuntime_Watch(ps->fdConn, 0, NULL, NULL);
+        (void)close(ps->fdConn);
+        ps->fdConn = -1;
+    }
+    ps->nLen = 0;
+}
+
+static void
+HostServer_OnConn(void *pUser, int fd, short revents)
+{
+    HostServer *ps = (HostServer*)pUser;
+    byte ack[PDC_FRAME_HDR_SIZE + 4];
+    boolean bNew = FALSE;
+    ssize_t n = 0;
+    int nUsed = 0;
+
+    n = recv(fd, ps->buf + ps->nLen, HSV_BUF_SIZE - ps->nLen, MSG_DONTWAIT);
+    if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+        return;
+    }
+    if (n <= 0) {
+        HostServer_CloseConn(ps);
+        return;
+    }
+    ps->nBytes += (uint32)n;
+    ps->nLen += (int)n;
+
+    nUsed = HostServer_OnFrames(ps, ps->buf, ps->nLen, &bNew);
+    MEMMOVE(ps->buf, ps->buf + nUsed, ps->nLen - nUsed);
+    ps->nLen -= nUsed;
+    if (HSV_BUF_SIZE == ps->nLen) {
+        ps->nBadFrames++;       // a frame larger than any the app sends
+        HostServer_CloseConn(ps);
+        return;
+    }
+
+    if (ps->bAck && bNew) {
+        (void)send(fd, ack, (size_t)HostServer_MakeAck(ps, ack),
+                   MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+}
+
+/* One client at a time, a new connection replaces the old one. */
+static void
+HostServer_OnAccept(void *pUser, int fd, short revents)
+{
+    HostServer *ps = (HostServer*)pUser;
+    int fdConn = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fdConn < 0) {
+        return;
+    }
+    HostServer_CloseConn(ps);
+    ps->fdConn = fdConn;
+    ps->nConns++;
+    (void)HostRuntime_Watch(fdConn, POLLIN, HostServer_OnConn, ps);
+}
+
+static void
+HostServer_OnDatagram(void *pUser, int fd, short revents)
+{
+    HostServer *ps = (HostServer*)pUser;
+    byte dgram[HSV_BUF_SIZE];
+    byte ack[PDC_FRAME_HDR_SIZE + 4];
+    struct sockaddr_in from;
+    socklen_t nFrom = sizeof(from);
+    boolean bNew = FALSE;
+    ssize_t n = 0;
+
+    n = recvfrom(fd, dgram, sizeof(dgram), MSG_DONTWAIT,
+                 (struct sockaddr*)&from, &nFrom);
+    if (n <= 0) {
+        return;
+    }
+    ps->nBytes += (uint32)n;
+
+    if (HostServer_OnFrames(ps, dgram, (int)n, &bNew) != n) {
+        ps->nBadFrames++;       // a frame never spans datagrams
+    }
+    if (ps->bAck && bNew) {
+        (void)sendto(fd, ack, (size_t)HostServer_MakeAck(ps, ack),
+                     MSG_DONTWAIT, (struct sockaddr*)&from, nFrom);
+    }
+}
+
+int
+HostServer_Start(HostServer *ps, boolean bAck)
+{
+    struct sockaddr_in sa;
+    socklen_t nLen = sizeof(sa);
+
+    MEMSET(ps, 0, sizeof(HostServer));
+    ps->fdConn = -1;
+    ps->fdUdp = -1;
+    ps->bAck = bAck;
+
+    ps->fdListen = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK
+                                   | SOCK_CLOEXEC, 0);
+    if (ps->fdListen < 0) {
+        return EFAILED;
+    }
+    MEMSET(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(ps->fdListen, (struct sockaddr*)&sa, sizeof(sa)) != 0
+        || listen(ps->fdListen, 4) != 0
+        || getsockname(ps->fdListen, (struct sockaddr*)&sa, &nLen) != 0) {
+        HostServer_Stop(ps);
+        return EFAILED;
+    }
+    ps->nPort = ntohs(sa.sin_port);
+
+    /* UDP on the same port number. */
+    ps->fdUdp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ps->fdUdp < 0
+        || bind(ps->fdUdp, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        HostServer_Stop(ps);
+        return EFAILED;
+    }
+
+    (void)HostRuntime_Watch(ps->fdListen, POLLIN, HostServer_OnAccept, ps);
+    (void)HostRuntime_Watch(ps->fdUdp, POLLIN, HostServer_OnDatagram, ps);
+    return SUCCESS;
+}
+
+void
+HostServer_Stop(HostServer *ps)
+{
+    HostServer_CloseConn(ps);
+    if (ps->fdListen >= 0) {
+        (void)HostRuntime_Watch(ps->fdListen, 0, NULL, NULL);
+        (void)close(ps->fdListen);
+        ps->fdListen = -1;
+    }
+    if (ps->fdUdp >= 0) {
+        (void)HostRuntime_Watch(ps->fdUdp, 0, NULL, NULL);
+        (void)close(ps->fdUdp);
+        ps->fdUdp = -1;
+    }
+    free(ps->pArrivals);
+    ps->pArrivals = NULL;
+    ps->nArrivalAlloc = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef HOSTSERVER_H
+#define HOSTSERVER_H
+
+#include "HostRuntime.h"
+
+/*
+ * Loopback server the applet reports to on the host, run in the same loop.
+ *
+ * It listens on 127.0.0.1 for TCP and UDP on the same port, reads the
+ * frames of PosDetCodec.h and, if bAck, answers each read holding new
+ * reports with an ACK of the last report in sequence. A report ahead of
+ * the sequence means one was lost and is left for the terminal to send
+ * again, as the real server does.
+ */
+
+#define HSV_BUF_SIZE        4096
+
+typedef struct _HostServer {
+    int     fdListen;
+    int     fdConn;             // the TCP connection, -1 if none
+    int     fdUdp;
+    uint16  nPort;              // host order
+    boolean bAck;
+    byte    buf[HSV_BUF_SIZE];  // frames read from fdConn
+    int     nLen;
+    boolean bHaveSeq;           // dwNextSeq is known
+    uint32  dwNextSeq;          // sequence number of the next report
+    uint32  nConns;             // TCP connections accepted
+    uint32  nHellos;
+    uint32  nReports;           // in sequence, each counted once
+    uint32  nSkips;             // of nReports, of no bytes, unreadable
+    uint32  nDups;              // sent again, already had them
+    uint32  nGaps;              // ahead of the sequence, dropped
+    uint32  nAcks;
+    uint32  nStats;             // stats frames of a known version
+    uint32  nBytes;             // read, TCP and UDP
+    uint32  nBadFrames;
+    uint32 *pArrivals;          // uptime ms each of the nReports came in
+    uint32  nArrivalAlloc;
+} HostServer;
+
+int  HostServer_Start(HostServer *ps, boolean bAck);
+void HostServer_Stop(HostServer *ps);
+
+#endif /* ifndef HOSTSERVER_H */
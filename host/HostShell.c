@@ -0,0 +1,738 @@
+/*=============================================================================
+  FILE: HostShell.c
+
+  IShell, IDisplay, the applet and the AEEStdLib helpers of the host
+  runtime, with the event loop driving them. See HostRuntime.h.
+  ============================================================================*/
+#include <poll.h>
+#include <time.h>
+
+#include "HostRuntime.h"
+
+typedef struct _HostTimer {
+    AEECallback *pcb;       // ISHELL_SetTimerEx() or ISHELL_Resume()
+    PFNTIMER     pfn;       // ISHELL_SetTimer()
+    void        *pUser;
+    uint32       dwWhen;    // uptime ms
+    uint32       nSeq;      // order queued in
+    boolean      bResume;
+} HostTimer;
+
+typedef struct _HostWatch {
+    int          fd;
+    short        events;
+    PFNHOSTWATCH pfn;
+    void        *pUser;
+} HostWatch;
+
+struct IShell {
+    HostObject base;
+};
+
+struct IDisplay {
+    HostObject base;
+};
+
+typedef struct _HostRuntime {
+    IShell     shell;
+    IDisplay   display;
+    uint32     dwNow;       // virtual uptime, ms
+    uint32     nSeq;
+    HostTimer  timers[HOST_MAX_TIMERS];
+    int        nTimers;
+    HostWatch  watches[HOST_MAX_WATCHES];
+    int        nWatches;
+    IApplet   *pApplet;
+    boolean    bCloseApplet;
+    uint32     dwRand;
+    boolean    bVerbose;
+    double     dPace;       // virtual ms per real ms, 0 for no pacing
+    uint32     dwPaceStart; // virtual and real time pacing started at
+    double     dPaceWall;
+    char       szRoot[256];
+    HostStats  stats;
+} HostRuntime;
+
+static HostRuntime s_rt;
+
+/* Real time given to a loopback peer to answer before the virtual clock
+ * jumps ahead, only taken while a connect is under way. */
+#define HOST_SETTLE_MS      20
+
+/* Longest real time waited at once for a paced clock to catch up, the
+ * watches are polled meanwhile. */
+#define HOST_PACE_MS        50
+
+/* MALLOC keeps the size in front of the block, for nInUseBytes. */
+#define HOST_ALLOC_HDR      16
+
+static void
+HostShell_NoDelete(void *po)
+{
+}
+
+/*===========================================================================
+RUNTIME.
+===========================================================================*/
+
+void
+HostRuntime_Init(const char *pszRoot, boolean bVerbose)
+{
+    MEMSET(&s_rt, 0, sizeof(s_rt));
+    s_rt.shell.base.nRefs = 1;
+    s_rt.shell.base.pfnDelete = HostShell_NoDelete;
+    s_rt.display.base.nRefs = 1;
+    s_rt.display.base.pfnDelete = HostShell_NoDelete;
+    s_rt.dwRand = 0x2545F491;
+    s_rt.bVerbose = bVerbose;
+    (void)HostShim_Strlcpy(s_rt.szRoot, pszRoot ? pszRoot : ".",
+                           sizeof(s_rt.szRoot));
+}
+
+void
+HostRuntime_Term(void)
+{
+    HostRuntime_StopApplet();
+    HostPosDet_Term();
+    s_rt.nTimers = 0;
+    s_rt.nWatches = 0;
+}
+
+IShell *
+HostRuntime_Shell(void)
+{
+    return &s_rt.shell;
+}
+
+HostStats *
+HostRuntime_Stats(void)
+{
+    return &s_rt.stats;
+}
+
+uint32
+HostRuntime_Now(void)
+{
+    return s_rt.dwNow;
+}
+
+const char *
+HostRuntime_Root(void)
+{
+    return s_rt.szRoot;
+}
+
+boolean
+HostRuntime_Verbose(void)
+{
+    return s_rt.bVerbose;
+}
+
+int
+HostRuntime_Watch(int fd, short events, PFNHOSTWATCH pfn, void *pUser)
+{
+    int i;
+
+    for (i = 0; i < s_rt.nWatches; i++) {
+        if (s_rt.watches[i].fd == fd) {
+            break;
+        }
+    }
+    if (0 == events) {
+        if (i < s_rt.nWatches) {
+            s_rt.watches[i] = s_rt.watches[--s_rt.nWatches];
+        }
+        return SUCCESS;
+    }
+    if (i == s_rt.nWatches) {
+        if (HOST_MAX_WATCHES == s_rt.nWatches) {
+            return ENOMEMORY;
+        }
+        s_rt.nWatches++;
+    }
+    s_rt.watches[i].fd = fd;
+    s_rt.watches[i].events = events;
+    s_rt.watches[i].pfn = pfn;
+    s_rt.watches[i].pUser = pUser;
+    return SUCCESS;
+}
+
+/* Poll the watched descriptors for up to nTimeout ms of real time and call
+ * the handlers of the ready ones. Returns how many were ready. */
+static int
+HostShell_Poll(int nTimeout)
+{
+    struct pollfd fds[HOST_MAX_WATCHES];
+    HostWatch watches[HOST_MAX_WATCHES];
+    int nWatches = s_rt.nWatches;
+    int nReady = 0;
+    int i;
+
+    if (nWatches <= 0) {
+        return 0;
+    }
+
+    /* Handlers may watch and unwatch, work on a copy. */
+    MEMCPY(watches, s_rt.watches, nWatches * sizeof(HostWatch));
+    for (i = 0; i < nWatches; i++) {
+        fds[i].fd = watches[i].fd;
+        fds[i].events = watches[i].events;
+        fds[i].revents = 0;
+    }
+
+    nReady = poll(fds, (nfds_t)nWatches, nTimeout);
+    if (nReady <= 0) {
+        return 0;
+    }
+    for (i = 0; i < nWatches; i++) {
+        if (fds[i].revents) {
+            watches[i].pfn(watches[i].pUser, fds[i].fd, fds[i].revents);
+        }
+    }
+    return nReady;
+}
+
+static double
+HostShell_WallMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void
+HostRuntime_SetPace(double dFactor)
+{
+    s_rt.dPace = dFactor > 0 ? dFactor : 0;
+    s_rt.dwPaceStart = s_rt.dwNow;
+    s_rt.dPaceWall = HostShell_WallMs();
+}
+
+/* Let the paced clock move towards dwNext. Returns FALSE once it is there,
+ * else TRUE after waiting a while for it. */
+static boolean
+HostShell_Pace(uint32 dwNext)
+{
+    double dPaced = s_rt.dwPaceStart
+                    + (HostShell_WallMs() - s_rt.dPaceWall) * s_rt.dPace;
+    double dWait = 0;
+
+    if (dPaced >= dwNext) {
+        return FALSE;
+    }
+    if ((uint32)dPaced > s_rt.dwNow) {
+        s_rt.dwNow = (uint32)dPaced;
+    }
+    dWait = FFLOOR((dwNext - dPaced) / s_rt.dPace) + 1;
+    (void)HostShell_Poll(dWait < HOST_PACE_MS ? (int)dWait : HOST_PACE_MS);
+    return TRUE;
+}
+
+/* Index of the timer to run next, or -1. */
+static int
+HostShell_NextTimer(void)
+{
+    const HostTimer *pt = NULL;
+    const HostTimer *pBest = NULL;
+    int iBest = -1;
+    int i;
+
+    for (i = 0; i < s_rt.nTimers; i++) {
+        pt = &s_rt.timers[i];
+        if (NULL == pBest || pt->dwWhen < pBest->dwWhen
+            || (pt->dwWhen == pBest->dwWhen
+                && (pt->bResume > pBest->bResume
+                    || (pt->bResume == pBest->bResume
+                        && pt->nSeq < pBest->nSeq)))) {
+            pBest = pt;
+            iBest = i;
+        }
+    }
+    return iBest;
+}
+
+static void
+HostShell_RemoveTimer(int i)
+{
+    s_rt.timers[i] = s_rt.timers[--s_rt.nTimers];
+}
+
+static void
+HostShell_Dispatch(int i)
+{
+    HostTimer t = s_rt.timers[i];
+
+    HostShell_RemoveTimer(i);
+    s_rt.stats.nDispatched++;
+
+    if (t.pcb) {
+        t.pcb->pfnCancel = NULL;
+        t.pcb->pCancelData = NULL;
+        if (t.pcb->pfnNotify) {
+            t.pcb->pfnNotify(t.pcb->pNotifyData);
+        }
+    }
+    else {
+        t.pfn(t.pUser);
+    }
+}
+
+boolean
+HostRuntime_Run(uint32 dwUntil)
+{
+    uint32 dwNext = 0;
+    boolean bLast = FALSE;
+    int i;
+
+    while (s_rt.pApplet) {
+        if (s_rt.bCloseApplet) {
+            HostRuntime_StopApplet();
+            return FALSE;
+        }
+
+        (void)HostShell_Poll(0);
+
+        i = HostShell_NextTimer();
+        if (i >= 0 && s_rt.timers[i].dwWhen <= s_rt.dwNow) {
+            HostShell_Dispatch(i);
+            continue;
+        }
+
+        /* Nothing to do now. A loopback connect completes in no time, but
+         * not always before the first poll. */
+        if (HostSock_Connecting() && HostShell_Poll(HOST_SETTLE_MS) > 0) {
+            continue;
+        }
+
+        bLast = (i < 0 || s_rt.timers[i].dwWhen > dwUntil);
+        dwNext = bLast ? dwUntil : s_rt.timers[i].dwWhen;
+        if (s_rt.dPace > 0 && HostShell_Pace(dwNext)) {
+            continue;
+        }
+        if (bLast) {
+            break;
+        }
+        s_rt.dwNow = dwNext;
+    }
+
+    if (s_rt.dwNow < dwUntil) {
+        s_rt.dwNow = dwUntil;
+    }
+    return NULL != s_rt.pApplet;
+}
+
+int
+HostRuntime_StartApplet(AEECLSID clsID, boolean bBackground)
+{
+    int err = 0;
+
+    err = AEEClsCreateInstance(clsID, &s_rt.shell, NULL,
+                               (void**)&s_rt.pApplet);
+    if (SUCCESS != err) {
+        s_rt.pApplet = NULL;
+        return err;
+    }
+    if (!HostRuntime_SendEvent(bBackground ? EVT_APP_START_BACKGROUND
+                                           : EVT_APP_START, 0, 0)) {
+        return EFAILED;
+    }
+    return SUCCESS;
+}
+
+boolean
+HostRuntime_SendEvent(AEEEvent evt, uint16 wParam, uint32 dwParam)
+{
+    AEEApplet *pa = (AEEApplet*)s_rt.pApplet;
+
+    if (NULL == pa) {
+        return FALSE;
+    }
+    return pa->pAppHandleEvent(pa, evt, wParam, dwParam);
+}
+
+void
+HostRuntime_StopApplet(void)
+{
+    IApplet *pApplet = s_rt.pApplet;
+
+    if (NULL == pApplet) {
+        return;
+    }
+    (void)HostRuntime_SendEvent(EVT_APP_STOP, 0, 0);
+    s_rt.pApplet = NULL;
+    s_rt.bCloseApplet = FALSE;
+    (void)IAPPLET_Release(pApplet);
+}
+
+/*===========================================================================
+ISHELL.
+===========================================================================*/
+
+int
+HostShell_CreateInstance(IShell *p, AEECLSID cls, void **ppo)
+{
+    *ppo = NULL;
+
+    switch (cls) {
+    case AEECLSID_POSDET:
+        return HostPosDet_New(ppo);
+    case AEECLSID_FILEMGR:
+        return HostFileMgr_New(ppo);
+    case AEECLSID_SockPort:
+        return HostSock_New(ppo);
+    case AEECLSID_Network:
+        return HostNet_New(ppo);
+    default:
+        return EBADCLASS;
+    }
+}
+
+void
+HostShell_GetDeviceInfo(IShell *p, AEEDeviceInfo *pdi)
+{
+    pdi->cxScreen = 176;
+    pdi->cyScreen = 220;
+    pdi->cxAltScreen = 0;
+    pdi->cyAltScreen = 0;
+    pdi->cxScrollBar = 4;
+    pdi->wEncoding = 0;
+    pdi->nColorDepth = 16;
+    pdi->dwRAM = 4 * 1024 * 1024;
+}
+
+static int
+HostShell_AddTimer(int32 dwMSecs, AEECallback *pcb, PFNTIMER pfn,
+                   void *pUser, boolean bResume)
+{
+    HostTimer *pt = NULL;
+
+    if (HOST_MAX_TIMERS == s_rt.nTimers) {
+        DBGPRINTF("host: out of timers");
+        return ENOMEMORY;
+    }
+
+    pt = &s_rt.timers[s_rt.nTimers++];
+    pt->pcb = pcb;
+    pt->pfn = pfn;
+    pt->pUser = pUser;
+    pt->dwWhen = s_rt.dwNow + (uint32)MAX(dwMSecs, 0);
+    pt->nSeq = s_rt.nSeq++;
+    pt->bResume = bResume;
+
+    if (pcb) {
+        pcb->pfnCancel = HostShell_CancelCallback;
+        pcb->pCancelData = &s_rt.shell;
+    }
+    return SUCCESS;
+}
+
+void
+HostShell_CancelCallback(AEECallback *pcb)
+{
+    int i;
+
+    for (i = 0; i < s_rt.nTimers; i++) {
+        if (s_rt.timers[i].pcb == pcb) {
+            HostShell_RemoveTimer(i);
+            break;
+        }
+    }
+    pcb->pfnCancel = NULL;
+    pcb->pCancelData = NULL;
+}
+
+int
+HostShell_SetTimer(IShell *p, int32 dwMSecs, PFNTIMER pfn, void *pUser)
+{
+    (void)HostShell_CancelTimer(p, pfn, pUser);
+    return HostShell_AddTimer(dwMSecs, NULL, pfn, pUser, FALSE);
+}
+
+int
+HostShell_SetTimerEx(IShell *p, int32 dwMSecs, AEECallback *pcb)
+{
+    CALLBACK_Cancel(pcb);
+    return HostShell_AddTimer(dwMSecs, pcb, NULL, NULL, FALSE);
+}
+
+/* Cancel the timers of pfn and pUser, or all those of pUser if pfn is
+ * NULL. */
+int
+HostShell_CancelTimer(IShell *p, PFNTIMER pfn, void *pUser)
+{
+    int i = 0;
+
+    while (i < s_rt.nTimers) {
+        if (NULL == s_rt.timers[i].pcb && s_rt.timers[i].pUser == pUser
+            && (NULL == pfn || s_rt.timers[i].pfn == pfn)) {
+            HostShell_RemoveTimer(i);
+        }
+        else {
+            i++;
+        }
+    }
+    return SUCCESS;
+}
+
+void
+HostShell_Resume(IShell *p, AEECallback *pcb)
+{
+    CALLBACK_Cancel(pcb);
+    (void)HostShell_AddTimer(0, pcb, NULL, NULL, TRUE);
+}
+
+int
+HostShell_CloseApplet(IShell *p, boolean bReturnToIdle)
+{
+    s_rt.bCloseApplet = TRUE;
+    return SUCCESS;
+}
+
+int
+HostShell_StartBackgroundApplet(IShell *p, AEECLSID cls,
+                                const char *pszArgs)
+{
+    return SUCCESS;
+}
+
+uint32
+HostShim_Release(void *po)
+{
+    HostObject *pObj = (HostObject*)po;
+
+    if (--pObj->nRefs > 0) {
+        return pObj->nRefs;
+    }
+    pObj->pfnDelete(po);
+    return 0;
+}
+
+/*===========================================================================
+APPLET.
+===========================================================================*/
+
+boolean
+AEEApplet_New(int16 nIn, AEECLSID clsID, IShell *pIShell, IModule *pIModule,
+              IApplet **ppobj, AEEHANDLER pAppHandleEvent,
+              PFNFREEAPPDATA pFreeAppData)
+{
+    AEEApplet *pa = NULL;
+
+    *ppobj = NULL;
+    if (nIn < (int16)sizeof(AEEApplet)) {
+        return FALSE;
+    }
+    pa = (AEEApplet*)MALLOC(nIn);
+    if (NULL == pa) {
+        return FALSE;
+    }
+
+    pa->m_nRefs = 1;
+    pa->clsID = clsID;
+    pa->m_pIShell = pIShell;
+    pa->m_pIModule = pIModule;
+    pa->m_pIDisplay = &s_rt.display;
+    pa->pAppHandleEvent = pAppHandleEvent;
+    pa->pFreeAppData = pFreeAppData;
+    *ppobj = (IApplet*)pa;
+    return TRUE;
+}
+
+uint32
+HostApplet_Release(IApplet *p)
+{
+    AEEApplet *pa = (AEEApplet*)p;
+
+    if (--pa->m_nRefs > 0) {
+        return pa->m_nRefs;
+    }
+    if (pa->pFreeAppData) {
+        pa->pFreeAppData(pa);
+    }
+    FREE(pa);
+    return 0;
+}
+
+/*===========================================================================
+IDISPLAY. Nothing is drawn, the calls are only counted.
+===========================================================================*/
+
+int
+HostDisplay_DrawText(IDisplay *p, AEEFont fnt, const AECHAR *pcText,
+                     int nChars, int x, int y, const AEERect *prc,
+                     uint32 dwFlags)
+{
+    s_rt.stats.nDrawText++;
+    return SUCCESS;
+}
+
+void
+HostDisplay_ClearScreen(IDisplay *p)
+{
+}
+
+void
+HostDisplay_EraseRect(IDisplay *p, const AEERect *prc)
+{
+}
+
+void
+HostDisplay_Update(IDisplay *p)
+{
+    s_rt.stats.nDisplayUpdates++;
+}
+
+/*===========================================================================
+AEESTDLIB.
+===========================================================================*/
+
+/* Zeroed, as the BREW heap hands it out. */
+void *
+HostShim_Malloc(uint32 dwSize)
+{
+    byte *p = (byte*)calloc(1, HOST_ALLOC_HDR + dwSize);
+
+    if (NULL == p) {
+        return NULL;
+    }
+    *(uint32*)p = dwSize;
+    s_rt.stats.nAllocs++;
+    s_rt.stats.nAllocBytes += dwSize;
+    s_rt.stats.nInUseBytes += dwSize;
+    return p + HOST_ALLOC_HDR;
+}
+
+void
+HostShim_Free(void *p)
+{
+    byte *pBlock = NULL;
+
+    if (NULL == p) {
+        return;
+    }
+    pBlock = (byte*)p - HOST_ALLOC_HDR;
+    s_rt.stats.nFrees++;
+    s_rt.stats.nInUseBytes -= *(uint32*)pBlock;
+    free(pBlock);
+}
+
+uint32
+HostShim_GetUpTimeMS(void)
+{
+    return s_rt.dwNow;
+}
+
+uint32
+HostShim_GetTimeSeconds(void)
+{
+    return HOST_START_GPS_SECS + s_rt.dwNow / 1000;
+}
+
+/* xorshift32, the same sequence on every run. */
+void
+HostShim_GetRand(byte *pDest, int nSize)
+{
+    uint32 x = s_rt.dwRand;
+
+    while (nSize-- > 0) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *pDest++ = (byte)x;
+    }
+    s_rt.dwRand = x;
+}
+
+void
+HostShim_DbgPrintf(const char *szFormat, ...)
+{
+    va_list args;
+
+    if (!s_rt.bVerbose) {
+        return;
+    }
+    fprintf(stderr, "%6u.%03u ", (unsigned)(s_rt.dwNow / 1000),
+            (unsigned)(s_rt.dwNow % 1000));
+    va_start(args, szFormat);
+    vfprintf(stderr, szFormat, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+int
+HostShim_Strlcpy(char *pDst, const char *pSrc, int nSize)
+{
+    int nLen = (int)strlen(pSrc);
+
+    if (nSize > 0) {
+        int n = MIN(nLen, nSize - 1);
+        MEMCPY(pDst, pSrc, n);
+        pDst[n] = 0;
+    }
+    return nLen;
+}
+
+boolean
+HostShim_FloatToWStr(double v, AECHAR *pszDest, int nSize)
+{
+    char szBuf[32];
+
+    (void)snprintf(szBuf, sizeof(szBuf), "%f", v);
+    (void)HostShim_StrToWStr(szBuf, pszDest, nSize);
+    return TRUE;
+}
+
+/* nSize is in bytes, as in BREW. */
+AECHAR *
+HostShim_StrToWStr(const char *pszIn, AECHAR *pDest, int nSize)
+{
+    int nMax = nSize / (int)sizeof(AECHAR) - 1;
+    int i;
+
+    if (nMax < 0) {
+        return pDest;
+    }
+    for (i = 0; i < nMax && pszIn[i]; i++) {
+        pDest[i] = (AECHAR)(byte)pszIn[i];
+    }
+    pDest[i] = 0;
+    return pDest;
+}
+
+char *
+HostShim_WStrToStr(const AECHAR *pIn, char *pszDest, int nSize)
+{
+    int i;
+
+    if (nSize <= 0) {
+        return pszDest;
+    }
+    for (i = 0; i < nSize - 1 && pIn[i]; i++) {
+        pszDest[i] = (char)pIn[i];
+    }
+    pszDest[i] = 0;
+    return pszDest;
+}
+
+/* dwSecs counts GPS seconds, 0 for now. */
+void
+HostShim_GetJulianDate(uint32 dwSecs, JulianType *pDate)
+{
+    time_t t;
+    struct tm tm;
+
+    if (0 == dwSecs) {
+        dwSecs = HostShim_GetTimeSeconds();
+    }
+    t = (time_t)dwSecs + 315964800;
+    (void)gmtime_r(&t, &tm);
+
+    pDate->wYear = (uint16)(tm.tm_year + 1900);
+    pDate->wMonth = (uint16)(tm.tm_mon + 1);
+    pDate->wDay = (uint16)tm.tm_mday;
+    pDate->wHour = (uint16)tm.tm_hour;
+    pDate->wMinute = (uint16)tm.tm_min;
+    pDate->wSecond = (uint16)tm.tm_sec;
+    pDate->wWeekDay = (uint16)((tm.tm_wday + 6) % 7); // 0 is Monday
+}
@@ -0,0 +1,321 @@
+/*=============================================================================
+  FILE: PosDetBench.c
+
+  Microbenchmarks of the report and config paths of the applet, on fixed
+  inputs, printed as JSON to compare releases with:
+
+    {"suite": "posdetbench", "arch": ..., "compiler": ...,
+     "benchmarks": [{"name": ..., "iterations": ..., "ns_per_op": ...,
+                     "allocs_per_op": ..., "bytes_per_op": ...}, ...]}
+
+  Allocations are the applet's MALLOC calls, the BREW heap, not those of
+  the host stand-ins. ns_per_op is the best of a few rounds.
+
+  PosDetApp.c is built into this file, not linked, to reach its static
+  functions.
+  ============================================================================*/
+#include <ftw.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../PosDetApp.c"
+#include "HostRuntime.h"
+
+#define PDB_ROUNDS          5
+#define PDB_DEFAULT_MS      200     // per round
+
+/* config.txt the config benchmarks read, the settings of
+ * config_example.txt. Kept here so that it only changes on purpose. */
+static const char s_szConfig[] =
+    "GPS_OPTIMIZATION_MODE = 0;\n"
+    "GPS_QOS = 127;\n"
+    "GPS_SERVER_TYPE = 0;\n"
+    "server-ip = 127.0.0.1;\n"
+    "server-port = 1212;\n"
+    "server-list = 127.0.0.1:1212;\n"
+    "connect-max-try = 2;\n"
+    "connect-timeout = 10;\n"
+    "primary-return = 600;\n"
+    "transport = 0;\n"
+    "udp-max-lost = 3;\n"
+    "dormant-hold = 300;\n"
+    "gps-interval = 5;\n"
+    "gps-interval-min = 0;\n"
+    "gps-interval-max = 0;\n"
+    "gps-mode = 4;\n"
+    "local-port = 10001;\n"
+    "batch-size = 1;\n"
+    "batch-age = 60;\n"
+    "report-encoding = 0;\n"
+    "keyframe-interval = 30;\n"
+    "simplify-tolerance = 0;\n"
+    "simplify-max-gap = 120;\n"
+    "log-files = 4;\n"
+    "log-file-size = 64;\n"
+    "reconnect-base = 1000;\n"
+    "reconnect-cap = 300000;\n"
+    "reconnect-multiplier = 200;\n"
+    "reconnect-jitter = 50;\n"
+    "ack-timeout = 30;\n"
+    "stats-interval = 900;\n"
+    "\n"
+    "# comment lines are skipped\n";
+
+/* The fix every report benchmark formats. */
+static const PosDetFix s_fix = {
+    1344300000,         // 2012-08-07 00:40:00 GMT
+    312304123,          // 31.2304123
+    1214737456,         // 121.4737456
+    12,
+    1250,               // 12.50 m/s
+    4641,               // 46.41 degree
+    PDC_HAS_POS | PDC_HAS_ALT | PDC_HAS_SPEED | PDC_HAS_HEADING
+};
+
+typedef struct _BenchCtx {
+    PosDetApp *pMe;
+    char       szBuf[REPORT_STR_BUF_SIZE];
+    char       szConfig[sizeof(s_szConfig)];   // ParseConfig() writes in it
+    int        nSink;   // keeps results alive
+} BenchCtx;
+
+typedef void (*PFNBENCH)(BenchCtx *pc);
+
+typedef struct _Bench {
+    const char *pszName;
+    PFNBENCH    pfn;
+} Bench;
+
+static void
+PosDetBench_MakeReportStr(BenchCtx *pc)
+{
+    PosDetApp_MakeReportStr(pc->pMe, &s_fix);
+    pc->nSink += pc->pMe->nReportLen;
+}
+
+/* The numbers of a report as the applet writes them now, fixed point. */
+static void
+PosDetBench_FixedToStr(BenchCtx *pc)
+{
+    StrWriter w;
+
+    StrWriter_Init(&w, pc->szBuf, sizeof(pc->szBuf));
+    StrWriter_Fixed(&w, s_fix.nLat, 7);
+    StrWriter_Char(&w, ',');
+    StrWriter_Fixed(&w, s_fix.nLon, 7);
+    StrWriter_Char(&w, ',');
+    StrWriter_Fixed(&w, s_fix.wSpeed, 2);
+    StrWriter_Char(&w, ',');
+    StrWriter_Fixed(&w, s_fix.wHeading, 2);
+    pc->nSink += w.nLen;
+}
+
+/* The same numbers the way reports used to be made, FLOATTOWSTR() and
+ * WSTR_TO_STR() for each, kept as the baseline. */
+static void
+PosDetBench_FloatToWStr(BenchCtx *pc)
+{
+    static const double values[] = {
+        31.2304123, 121.4737456, 12.50, 46.41
+    };
+    AECHAR wsz[32];
+    int nLen = 0;
+    int i;
+
+    for (i = 0; i < (int)ARRAYSIZE(values); i++) {
+        (void)FLOATTOWSTR(values[i], wsz, sizeof(wsz));
+        (void)WSTR_TO_STR(wsz, pc->szBuf + nLen, sizeof(pc->szBuf) - nLen);
+        nLen += STRLEN(pc->szBuf + nLen);
+        pc->szBuf[nLen++] = ',';
+    }
+    pc->nSink += nLen;
+}
+
+static void
+PosDetBench_ReadUserConfig(BenchCtx *pc)
+{
+    pc->nSink += PosDetApp_ReadUserConfig(pc->pMe);
+}
+
+/* ReadUserConfig() without the file, ParseConfig() and the setters. */
+static void
+PosDetBench_ParseConfig(BenchCtx *pc)
+{
+    MEMCPY(pc->szConfig, s_szConfig, sizeof(s_szConfig));
+    pc->nSink += ParseConfig(pc->szConfig, sizeof(s_szConfig) - 1,
+                             PosDetApp_OnConfigItem, pc->pMe);
+}
+
+static const Bench s_benches[] = {
+    { "make_report_str",   PosDetBench_MakeReportStr },
+    { "fixed_to_str",      PosDetBench_FixedToStr },
+    { "floattowstr",       PosDetBench_FloatToWStr },
+    { "read_user_config",  PosDetBench_ReadUserConfig },
+    { "parse_config",      PosDetBench_ParseConfig }
+};
+
+static double
+PosDetBench_WallNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Run pb for about nMs per round and print its JSON object. */
+static void
+PosDetBench_Run(const Bench *pb, BenchCtx *pc, uint32 nMs, boolean bFirst)
+{
+    HostStats *pStats = HostRuntime_Stats();
+    uint32 nIters = 1;
+    uint32 nAllocs = 0;
+    uint32 nBytes = 0;
+    uint32 i;
+    double dBest = 0;
+    double dStart = 0;
+    double d = 0;
+    int nRound;
+
+    /* Warm up, and find how many iterations take nMs. */
+    for (;;) {
+        dStart = PosDetBench_WallNs();
+        for (i = 0; i < nIters; i++) {
+            pb->pfn(pc);
+        }
+        d = PosDetBench_WallNs() - dStart;
+        if (d >= nMs * 1e6 || nIters >= 0x40000000) {
+            break;
+        }
+        nIters = d < nMs * 1e5 ? nIters * 10
+                               : (uint32)(nIters * (nMs * 1.1e6 / d));
+    }
+
+    for (nRound = 0; nRound < PDB_ROUNDS; nRound++) {
+        nAllocs = pStats->nAllocs;
+        nBytes = pStats->nAllocBytes;
+        dStart = PosDetBench_WallNs();
+        for (i = 0; i < nIters; i++) {
+            pb->pfn(pc);
+        }
+        d = (PosDetBench_WallNs() - dStart) / nIters;
+        nAllocs = pStats->nAllocs - nAllocs;
+        nBytes = pStats->nAllocBytes - nBytes;
+        if (0 == nRound || d < dBest) {
+            dBest = d;
+        }
+    }
+
+    printf("%s    {\"name\": \"%s\", \"iterations\": %u, "
+           "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+           "\"bytes_per_op\": %.1f}",
+           bFirst ? "" : ",\n", pb->pszName, (unsigned)nIters, dBest,
+           (double)nAllocs / nIters, (double)nBytes / nIters);
+}
+
+static const char *
+PosDetBench_Arch(void)
+{
+#if defined(__aarch64__)
+    return "aarch64";
+#elif defined(__arm__)
+    return "arm";
+#elif defined(__x86_64__)
+    return "x86_64";
+#elif defined(__i386__)
+    return "i386";
+#else
+    return "unknown";
+#endif
+}
+
+static int
+PosDetBench_RemoveEntry(const char *pszPath, const struct stat *pst,
+                        int flag, struct FTW *pftw)
+{
+    return remove(pszPath);
+}
+
+static boolean
+PosDetBench_WriteConfig(void)
+{
+    char szPath[512];
+    FILE *pf = NULL;
+
+    (void)snprintf(szPath, sizeof(szPath), "%s/" SPD_CONFIG_FILE,
+                   HostRuntime_Root());
+    pf = fopen(szPath, "w");
+    if (NULL == pf) {
+        return FALSE;
+    }
+    fputs(s_szConfig, pf);
+    return fclose(pf) == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    BenchCtx ctx;
+    IApplet *pApplet = NULL;
+    char szTmp[] = "/tmp/posdetbench.XXXXXX";
+    const char *pszFilter = NULL;
+    const char *pszRoot = NULL;
+    uint32 nMs = PDB_DEFAULT_MS;
+    boolean bFirst = TRUE;
+    int c;
+    int i;
+
+    while ((c = getopt(argc, argv, "t:f:")) != -1) {
+        switch (c) {
+        case 't': nMs = (uint32)atoi(optarg); break;
+        case 'f': pszFilter = optarg; break;
+        default:
+            fprintf(stderr,
+                    "usage: posdetbench [-t ms] [-f name]\n"
+                    "  -t ms     time per round, default %d\n"
+                    "  -f name   only the benchmarks with name in theirs\n",
+                    PDB_DEFAULT_MS);
+            return 2;
+        }
+    }
+
+    pszRoot = mkdtemp(szTmp);
+    if (NULL == pszRoot) {
+        perror("mkdtemp");
+        return 2;
+    }
+    HostRuntime_Init(pszRoot, FALSE);
+    if (!PosDetBench_WriteConfig()
+        || AEEClsCreateInstance(AEECLSID_CPOSDETAPP, HostRuntime_Shell(),
+                                NULL, (void**)&pApplet) != SUCCESS) {
+        fprintf(stderr, "posdetbench: can't create the applet\n");
+        return 2;
+    }
+
+    MEMSET(&ctx, 0, sizeof(ctx));
+    ctx.pMe = (PosDetApp*)pApplet;
+    if (ctx.pMe->nConfigErrors > 0) {
+        fprintf(stderr, "posdetbench: %d errors in the config\n",
+                ctx.pMe->nConfigErrors);
+        return 2;
+    }
+    PosDetApp_ProcessNetEvtIP(ctx.pMe);     // the local IP of the reports
+
+    printf("{\"suite\": \"posdetbench\", \"arch\": \"%s\", "
+           "\"compiler\": \"%s\",\n \"benchmarks\": [\n",
+           PosDetBench_Arch(), __VERSION__);
+    for (i = 0; i < (int)ARRAYSIZE(s_benches); i++) {
+        if (pszFilter && NULL == STRSTR(s_benches[i].pszName, pszFilter)) {
+            continue;
+        }
+        PosDetBench_Run(&s_benches[i], &ctx, nMs, bFirst);
+        bFirst = FALSE;
+    }
+    printf("\n]}\n");
+
+    (void)IAPPLET_Release(pApplet);
+    HostRuntime_Term();
+    (void)nftw(pszRoot, PosDetBench_RemoveEntry, 8, FTW_DEPTH | FTW_PHYS);
+    return ctx.nSink == 0x7FFFFFFF;
+}
@@ -0,0 +1,184 @@
+/*=============================================================================
+  FILE: PosDetCodecCheck.c
+
+  Runs fixes through PosDetCodec_EncodeDelta() and back through a reader
+  of the delta stream as PosDetCodec.h describes it, the way the server
+  reads it, and fails if a fix comes back changed. The tracks cross the
+  antimeridian and the north of the heading circle both ways.
+  ============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "PosDetCodec.h"
+
+#define PCC_TERMINAL_ID     "13800000000"
+#define PCC_FIXES           40
+#define PCC_DELTA_BYTES     12      // a delta across the wrap stays small
+
+/* Reader of a delta stream. */
+typedef struct _DeltaReader {
+    PosDetFix last;
+    int32     nLastDt;
+} DeltaReader;
+
+static const byte *
+GetZigZag(const byte *p, int32 *pv)
+{
+    uint32 u = 0;
+    int nShift = 0;
+
+    do {
+        u |= (uint32)(*p & 0x7F) << nShift;
+        nShift += 7;
+    } while (*p++ & 0x80);
+    *pv = (int32)(u >> 1) ^ -(int32)(u & 1);
+    return p;
+}
+
+static boolean
+DeltaReader_Read(DeltaReader *pr, const byte *pBuf, int nLen,
+                 PosDetFix *pFix)
+{
+    byte bin[PDC_BINARY_SIZE];
+    const byte *p = pBuf + 1;
+    int64 lon = 0;
+    int32 d = 0;
+    int nIdLen = 0;
+
+    if (PDC_MAGIC_KEY == pBuf[0]) {
+        nIdLen = pBuf[2];
+        bin[0] = PDC_MAGIC_BINARY;
+        bin[1] = pBuf[1];
+        MEMCPY(bin + 2, pBuf + 3 + nIdLen, PDC_BINARY_SIZE - 2);
+        if (3 + nIdLen + PDC_BINARY_SIZE - 2 != nLen
+            || PosDetCodec_DecodeBinary(bin, sizeof(bin), pFix) != SUCCESS) {
+            return FALSE;
+        }
+        pr->last = *pFix;
+        pr->nLastDt = 0;
+        return TRUE;
+    }
+    if ((pBuf[0] & PDC_DELTA_TAG_MASK) != PDC_DELTA_TAG) {
+        return FALSE;
+    }
+
+    *pFix = pr->last;
+    if (pBuf[0] & PDC_DELTA_TIME) {
+        p = GetZigZag(p, &d);
+        pr->nLastDt += d;
+    }
+    pFix->dwTime += pr->nLastDt;
+    if (pBuf[0] & PDC_DELTA_LAT) {
+        p = GetZigZag(p, &d);
+        pFix->nLat += d;
+    }
+    if (pBuf[0] & PDC_DELTA_LON) {
+        p = GetZigZag(p, &d);
+        lon = (int64)pFix->nLon + d;
+        if (lon > (int64)PDC_LON_HALF_TURN) {
+            lon -= PDC_LON_TURN;
+        }
+        else if (lon <= -(int64)PDC_LON_HALF_TURN) {
+            lon += PDC_LON_TURN;    // -180 is 180, as the tracks have it
+        }
+        pFix->nLon = (int32)lon;
+    }
+    if (pBuf[0] & PDC_DELTA_ALT) {
+        p = GetZigZag(p, &d);
+        pFix->nAlt = (int16)(pFix->nAlt + d);
+    }
+    if (pBuf[0] & PDC_DELTA_SPEED) {
+        p = GetZigZag(p, &d);
+        pFix->wSpeed = (uint16)(pFix->wSpeed + d);
+    }
+    if (pBuf[0] & PDC_DELTA_HEADING) {
+        p = GetZigZag(p, &d);
+        pFix->wHeading = (uint16)((pFix->wHeading + d + 36000) % 36000);
+    }
+    pr->last = *pFix;
+    return p - pBuf == nLen;
+}
+
+static boolean
+PosDetCodecCheck_Equal(const PosDetFix *p1, const PosDetFix *p2)
+{
+    return p1->dwTime == p2->dwTime && p1->nLat == p2->nLat
+        && p1->nLon == p2->nLon && p1->nAlt == p2->nAlt
+        && p1->wSpeed == p2->wSpeed && p1->wHeading == p2->wHeading
+        && p1->flags == p2->flags;
+}
+
+/* Send a track starting at nLon, moving by nStep a fix, and read it back.
+ * Returns the number of fixes that came back changed. */
+static int
+PosDetCodecCheck_Track(int32 nLon, int32 nStep, int32 nHeadingStep)
+{
+    PosDetDeltaCtx ctx;
+    DeltaReader reader;
+    PosDetFix fix;
+    PosDetFix back;
+    byte buf[PDC_KEY_MAX_SIZE];
+    int64 lon = nLon;
+    int nBad = 0;
+    int n = 0;
+    int i;
+
+    PosDetCodec_ResetDelta(&ctx, 0);
+    MEMSET(&reader, 0, sizeof(reader));
+    MEMSET(&fix, 0, sizeof(fix));
+    fix.dwTime = 1344300000;
+    fix.nLat = -165000000;      // -16.5, Fiji
+    fix.nAlt = 12;
+    fix.wSpeed = 1250;
+    fix.wHeading = 35950;
+    fix.flags = PDC_HAS_POS | PDC_HAS_ALT | PDC_HAS_SPEED | PDC_HAS_HEADING;
+
+    for (i = 0; i < PCC_FIXES; i++) {
+        fix.nLon = (int32)lon;
+        n = PosDetCodec_EncodeDelta(&ctx, &fix, PCC_TERMINAL_ID, buf,
+                                    sizeof(buf));
+        if (n <= 0 || !DeltaReader_Read(&reader, buf, n, &back)
+            || !PosDetCodecCheck_Equal(&fix, &back)
+            || (i > 0 && n > PCC_DELTA_BYTES)) {
+            fprintf(stderr, "posdetcodeccheck: fix %d at %d, step %d: "
+                    "%d bytes, back at %d\n", i, (int)fix.nLon, (int)nStep,
+                    n, (int)back.nLon);
+            nBad++;
+        }
+
+        fix.dwTime += 5;
+        fix.nLat += 100;
+        fix.wHeading = (uint16)((fix.wHeading + nHeadingStep + 36000)
+                                % 36000);
+        lon += nStep;
+        if (lon > (int64)PDC_LON_HALF_TURN) {
+            lon -= PDC_LON_TURN;
+        }
+        else if (lon <= -(int64)PDC_LON_HALF_TURN) {
+            lon += PDC_LON_TURN;
+        }
+    }
+    return nBad;
+}
+
+int
+main(void)
+{
+    int nBad = 0;
+
+    /* Eastward and westward over the antimeridian, 0.0005 degree a fix. */
+    nBad += PosDetCodecCheck_Track(1799900000, 5000, 10);
+    nBad += PosDetCodecCheck_Track(-1799900000, -5000, -10);
+    /* Landing on 180 and -180 exactly. */
+    nBad += PosDetCodecCheck_Track(1799900000, 10000, 0);
+    nBad += PosDetCodecCheck_Track(-1799900000, -10000, 0);
+    /* Away from it, as before. */
+    nBad += PosDetCodecCheck_Track(1214737456, 5000, 10);
+
+    if (nBad > 0) {
+        fprintf(stderr, "posdetcodeccheck: FAILED, %d fixes changed\n", nBad);
+        return 1;
+    }
+    printf("posdetcodeccheck: %d fixes ok\n", 5 * PCC_FIXES);
+    return 0;
+}
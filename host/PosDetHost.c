@@ -0,0 +1,464 @@
+/*=============================================================================
+  FILE: PosDetHost.c
+
+  Runs the unmodified applet on Linux: the host runtime stands in for BREW,
+  HostCircle, or HostReplay with -g, for the GPS receiver and HostServer
+  for the report server. The applet tracks for -d seconds of virtual time,
+  or until the trace ends, then stops, and what it did is printed.
+
+  The exit status is 1 if fixes went missing on the way to the server, or
+  the receiver gave far fewer fixes than the interval asks for, so the run
+  can gate a build.
+  ============================================================================*/
+#include <ftw.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "HostRuntime.h"
+#include "HostServer.h"
+#include "HostReplay.h"
+#include "CPosDetApp.h"
+#include "RyanUtils.h"
+
+/* Virtual time left after the trace ended for the last reports to go. */
+#define PDH_DRAIN_MS        10000
+
+/* Share of the fixes due at the tracking interval that may be late or
+ * lost, in percent, e.g. to the first one and to an interval change. */
+#define PDH_FIX_SLACK       10
+
+typedef struct _HostErrName {
+    const char *pszName;
+    uint32      status;
+} HostErrName;
+
+static const HostErrName s_errNames[] = {
+    { "general",     AEEGPS_ERR_GENERAL_FAILURE },
+    { "timeout",     AEEGPS_ERR_TIMEOUT },
+    { "accuracy",    AEEGPS_ERR_ACCURACY_UNAVAIL },
+    { "unavail",     AEEGPS_ERR_INFO_UNAVAIL },
+    { "privacy",     AEEGPS_ERR_PRIVACY_REFUSED },
+    { "unreachable", AEEGPS_ERR_SRV_UNREACHABLE },
+    { "link",        AEEGPS_ERR_LINK_FAILED },
+    { "rejected",    AEEGPS_ERR_REJECTED },
+    { "resources",   AEEGPS_ERR_OUTOF_RESOURCES },
+    { "busy",        AEEGPS_ERR_RECEIVER_BUSY },
+    { "stale",       AEEGPS_ERR_STALE_BS_INFO },
+    { "noanswer",    HRP_NO_ANSWER }
+};
+
+typedef struct _HostOptions {
+    uint32      nDuration;      // seconds of virtual time
+    uint32      nInterval;      // gps-interval
+    uint32      nIntervalMax;   // gps-interval-max if more, adaptive
+    uint32      nEncoding;      // report-encoding
+    uint32      nBatch;         // batch-size
+    uint32      nTransport;     // transport
+    uint32      nAckTimeout;    // ack-timeout, 0 for a server without ACKs
+    uint32      nFixes;         // 0 for as many as the duration takes
+    boolean     bDuration;      // -d given
+    const char *pszTrace;       // replay this, not HostCircle
+    double      dSpeed;         // times real time, 0 for no pacing
+    const char *pszInject[HRP_MAX_INJECT];
+    uint32      nInject;
+    const char *pszRoot;
+    const char *pszConfig;      // more config.txt lines
+    uint32      nCorrupt;       // write to the queue file to corrupt
+    boolean     bVerbose;
+} HostOptions;
+
+static void
+PosDetHost_Usage(void)
+{
+    fprintf(stderr,
+            "usage: posdethost [options]\n"
+            "  -d secs   virtual time to run, default 3600, or the whole\n"
+            "            trace with -g\n"
+            "  -i secs   gps-interval, default 5\n"
+            "  -i min:max  adaptive interval, gps-interval-min and max\n"
+            "  -e n      report-encoding, 0 ascii, 1 binary, 2 delta\n"
+            "  -b n      batch-size, default 1\n"
+            "  -t n      transport, 0 TCP, 1 UDP\n"
+            "  -a secs   ack-timeout, 0 for a server sending no ACK\n"
+            "  -f n      fixes the receiver gives, default no end\n"
+            "  -g file   replay an NMEA or EHL trace\n"
+            "  -s x      run at x times real time, default as fast as can be\n"
+            "  -x n:err  answer GPS request n with err, a number or one of\n"
+            "            general timeout accuracy unavail privacy\n"
+            "            unreachable link rejected resources busy stale,\n"
+            "            or noanswer, with -g\n"
+            "  -r dir    applet directory, default a new temporary one\n"
+            "  -c file   config lines to add to config.txt\n"
+            "  -k n      flip a bit in the n-th write to the report queue,\n"
+            "            an odd n > 1 is a report\n"
+            "  -v        print DBGPRINTF output\n");
+}
+
+static boolean
+PosDetHost_ParseArgs(int argc, char **argv, HostOptions *po)
+{
+    int c;
+
+    MEMSET(po, 0, sizeof(HostOptions));
+    po->nDuration = 3600;
+    po->nInterval = 5;
+    po->nBatch = DEFAULT_BATCH_SIZE;
+    po->nAckTimeout = DEFAULT_ACK_TIMEOUT;
+
+    while ((c = getopt(argc, argv, "d:i:e:b:t:a:f:g:s:x:r:c:k:v")) != -1) {
+        switch (c) {
+        case 'd':
+            po->nDuration = (uint32)atoi(optarg);
+            po->bDuration = TRUE;
+            break;
+        case 'i':
+            po->nInterval = (uint32)atoi(optarg);
+            if (STRCHR(optarg, ':')) {
+                po->nIntervalMax = (uint32)atoi(STRCHR(optarg, ':') + 1);
+            }
+            break;
+        case 'e': po->nEncoding = (uint32)atoi(optarg); break;
+        case 'b': po->nBatch = (uint32)atoi(optarg); break;
+        case 't': po->nTransport = (uint32)atoi(optarg); break;
+        case 'a': po->nAckTimeout = (uint32)atoi(optarg); break;
+        case 'f': po->nFixes = (uint32)atoi(optarg); break;
+        case 'g': po->pszTrace = optarg; break;
+        case 's': po->dSpeed = atof(optarg); break;
+        case 'x':
+            if (HRP_MAX_INJECT == po->nInject) {
+                return FALSE;
+            }
+            po->pszInject[po->nInject++] = optarg;
+            break;
+        case 'r': po->pszRoot = optarg; break;
+        case 'c': po->pszConfig = optarg; break;
+        case 'k': po->nCorrupt = (uint32)atoi(optarg); break;
+        case 'v': po->bVerbose = TRUE; break;
+        default:
+            return FALSE;
+        }
+    }
+    return optind == argc;
+}
+
+/* "n:err" of -x into the replay. */
+static boolean
+PosDetHost_Inject(HostReplay *pr, const char *pszInject)
+{
+    const char *pszErr = STRCHR(pszInject, ':');
+    uint32 status = 0;
+    int i;
+
+    if (NULL == pszErr) {
+        return FALSE;
+    }
+    pszErr++;
+    for (i = 0; i < (int)ARRAYSIZE(s_errNames); i++) {
+        if (STRCMP(pszErr, s_errNames[i].pszName) == 0) {
+            break;
+        }
+    }
+    if (i < (int)ARRAYSIZE(s_errNames)) {
+        status = s_errNames[i].status;
+    }
+    else if (*pszErr >= '0' && *pszErr <= '9') {
+        status = (uint32)strtoul(pszErr, NULL, 0);
+    }
+    else {
+        return FALSE;
+    }
+    return HostReplay_Inject(pr, (uint32)atoi(pszInject), status);
+}
+
+/* Write config.txt for the options, pointing the applet to the server. */
+static boolean
+PosDetHost_WriteConfig(const HostOptions *po, uint16 nPort)
+{
+    char szPath[512];
+    char szLine[256];
+    FILE *pf = NULL;
+    FILE *pExtra = NULL;
+
+    (void)snprintf(szPath, sizeof(szPath), "%s/" SPD_CONFIG_FILE,
+                   HostRuntime_Root());
+    pf = fopen(szPath, "w");
+    if (NULL == pf) {
+        return FALSE;
+    }
+    fprintf(pf, "server-ip = 127.0.0.1;\n");
+    fprintf(pf, "server-port = %u;\n", nPort);
+    fprintf(pf, "gps-interval = %u;\n", (unsigned)po->nInterval);
+    if (po->nIntervalMax > po->nInterval) {
+        fprintf(pf, "gps-interval-min = %u;\n", (unsigned)po->nInterval);
+        fprintf(pf, "gps-interval-max = %u;\n", (unsigned)po->nIntervalMax);
+    }
+    fprintf(pf, "report-encoding = %u;\n", (unsigned)po->nEncoding);
+    fprintf(pf, "batch-size = %u;\n", (unsigned)po->nBatch);
+    fprintf(pf, "transport = %u;\n", (unsigned)po->nTransport);
+    fprintf(pf, "ack-timeout = %u;\n", (unsigned)po->nAckTimeout);
+
+    if (po->pszConfig) {
+        pExtra = fopen(po->pszConfig, "r");
+        if (NULL == pExtra) {
+            fclose(pf);
+            return FALSE;
+        }
+        while (fgets(szLine, sizeof(szLine), pExtra)) {
+            fputs(szLine, pf);
+        }
+        fclose(pExtra);
+    }
+    return fclose(pf) == 0;
+}
+
+static int
+PosDetHost_RemoveEntry(const char *pszPath, const struct stat *pst, int flag,
+                       struct FTW *pftw)
+{
+    return remove(pszPath);
+}
+
+/* Fixes due that an injected error may cost: an unanswered request waits
+ * out its timeout, the interval and GPSREQ_TIMEOUT_MIN, then the retry. */
+static uint32
+PosDetHost_InjectCost(const HostOptions *po)
+{
+    uint32 nInterval = MAX(po->nInterval, 1) * 1000;
+
+    return (nInterval + GPSREQ_TIMEOUT_MIN + GPSREQ_DELAY_MIN) / nInterval
+           + 1;
+}
+
+static int
+PosDetHost_CompareU32(const void *p1, const void *p2)
+{
+    uint32 a = *(const uint32*)p1;
+    uint32 b = *(const uint32*)p2;
+
+    return a < b ? -1 : a > b;
+}
+
+/* How long fixes took from the receiver to the server. Fix n is report n
+ * as long as the applet drops none, see simplify-tolerance. */
+static void
+PosDetHost_PrintDelays(const HostServer *ps)
+{
+    const uint32 *pFixTimes = NULL;
+    uint32 *pDelays = NULL;
+    uint32 nFixes = 0;
+    uint32 n = 0;
+    uint32 i;
+    double dSum = 0;
+
+    pFixTimes = HostPosDet_FixTimes(&nFixes);
+    n = MIN(nFixes, ps->nReports);
+    if (0 == n || NULL == ps->pArrivals) {
+        return;
+    }
+    pDelays = (uint32*)malloc(n * sizeof(uint32));
+    if (NULL == pDelays) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        pDelays[i] = ps->pArrivals[i] - pFixTimes[i];
+        dSum += pDelays[i];
+    }
+    qsort(pDelays, n, sizeof(uint32), PosDetHost_CompareU32);
+
+    printf("fix_to_server_ms mean %.0f p50 %u p95 %u max %u\n", dSum / n,
+           (unsigned)pDelays[n / 2], (unsigned)pDelays[n * 95 / 100],
+           (unsigned)pDelays[n - 1]);
+    free(pDelays);
+}
+
+static double
+PosDetHost_WallMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+    HostOptions opt;
+    HostServer server;
+    HostCircle circle;
+    HostReplay replay;
+    HostStats *pStats = NULL;
+    char szTmp[] = "/tmp/posdethost.XXXXXX";
+    const char *pszRoot = NULL;
+    double dStart = 0;
+    double dWall = 0;
+    uint32 dwEnd = 0;
+    uint32 nMissing = 0;
+    uint32 nDue = 0;
+    uint32 nUnanswered = 0;
+    uint32 i;
+    int err = 0;
+
+    if (!PosDetHost_ParseArgs(argc, argv, &opt)) {
+        PosDetHost_Usage();
+        return 2;
+    }
+
+    pszRoot = opt.pszRoot;
+    if (NULL == pszRoot) {
+        pszRoot = mkdtemp(szTmp);
+        if (NULL == pszRoot) {
+            perror("mkdtemp");
+            return 2;
+        }
+    }
+
+    HostRuntime_Init(pszRoot, opt.bVerbose);
+    if (opt.nCorrupt > 0) {
+        HostFile_Corrupt(SPD_QUEUE_FILE, opt.nCorrupt);
+    }
+    if (HostServer_Start(&server, opt.nAckTimeout > 0) != SUCCESS) {
+        fprintf(stderr, "posdethost: can't start the server\n");
+        return 2;
+    }
+    if (!PosDetHost_WriteConfig(&opt, server.nPort)) {
+        fprintf(stderr, "posdethost: can't write %s/" SPD_CONFIG_FILE "\n",
+                pszRoot);
+        return 2;
+    }
+
+    HostReplay_Init(&replay);
+    if (opt.pszTrace) {
+        if (HostReplay_Load(&replay, opt.pszTrace) != SUCCESS
+            || 0 == replay.nFixes) {
+            fprintf(stderr, "posdethost: no fixes in %s\n", opt.pszTrace);
+            return 2;
+        }
+        for (i = 0; i < opt.nInject; i++) {
+            if (!PosDetHost_Inject(&replay, opt.pszInject[i])) {
+                fprintf(stderr, "posdethost: bad -x %s\n", opt.pszInject[i]);
+                return 2;
+            }
+        }
+        HostPosDet_SetSource(HostReplay_Next, &replay);
+    }
+    else {
+        HostCircle_Init(&circle, opt.nFixes);
+        HostPosDet_SetSource(HostCircle_Next, &circle);
+    }
+
+    dStart = PosDetHost_WallMs();
+    HostRuntime_SetPace(opt.dSpeed);
+    err = HostRuntime_StartApplet(AEECLSID_CPOSDETAPP, TRUE);
+    if (SUCCESS != err) {
+        fprintf(stderr, "posdethost: the applet failed to start, err %d\n",
+                err);
+        return 2;
+    }
+
+    /* A trace runs to its end, a second at a time, unless -d says
+     * otherwise. */
+    dwEnd = opt.nDuration * 1000;
+    if (opt.pszTrace && !opt.bDuration) {
+        dwEnd = (uint32)((replay.pFixes[replay.nFixes - 1].dTime
+                          - replay.pFixes[0].dTime) * 1000.0) + 1000;
+    }
+    while (HostRuntime_Now() < dwEnd && !HostPosDet_Exhausted()
+           && HostRuntime_Run(MIN(HostRuntime_Now() + 1000, dwEnd))) {
+    }
+    if (opt.pszTrace && HostPosDet_Exhausted()) {
+        (void)HostRuntime_Run(HostRuntime_Now() + PDH_DRAIN_MS);
+    }
+    HostRuntime_StopApplet();
+    dWall = PosDetHost_WallMs() - dStart;
+
+    /* Every fix must have reached the server, but for a batch still
+     * waiting to fill up when the applet stopped. */
+    pStats = HostRuntime_Stats();
+    if (pStats->nGPSFixes > server.nReports + opt.nBatch) {
+        nMissing = pStats->nGPSFixes - server.nReports;
+    }
+
+    /* The receiver must have given about a fix per interval, the longest
+     * one if adaptive, and answered every request but the last. Not so
+     * with -f, or -c lines which may change the interval. */
+    if (NULL == opt.pszTrace && 0 == opt.nFixes && NULL == opt.pszConfig) {
+        nDue = HostRuntime_Now() / 1000
+               / MAX(MAX(opt.nInterval, opt.nIntervalMax), 1);
+        nDue -= nDue * PDH_FIX_SLACK / 100;
+        if (pStats->nGPSRequests > pStats->nGPSAnswers + 1) {
+            nUnanswered = pStats->nGPSRequests - pStats->nGPSAnswers;
+        }
+    }
+
+    /* A trace must come through whole, but for the fixes due while an
+     * injected error or an unanswered request is retried. */
+    if (opt.pszTrace) {
+        nDue = HostReplay_Due(&replay, MAX(opt.nInterval, opt.nIntervalMax),
+                              dwEnd / 1000.0);
+        nDue -= MIN(nDue, opt.nInject * PosDetHost_InjectCost(&opt));
+    }
+
+    printf("virtual_s        %u\n", (unsigned)(HostRuntime_Now() / 1000));
+    printf("wall_ms          %.1f\n", dWall);
+    printf("callbacks        %u\n", (unsigned)pStats->nDispatched);
+    printf("gps_requests     %u\n", (unsigned)pStats->nGPSRequests);
+    printf("gps_answers      %u\n", (unsigned)pStats->nGPSAnswers);
+    printf("gps_fixes        %u\n", (unsigned)pStats->nGPSFixes);
+    if (nDue > 0) {
+        printf("gps_fixes_due    %u\n", (unsigned)nDue);
+    }
+    if (opt.pszTrace) {
+        printf("trace_fixes      %u\n", (unsigned)replay.nFixes);
+        printf("trace_skipped    %u\n", (unsigned)replay.nSkipped);
+    }
+    printf("connects         %u\n", (unsigned)pStats->nConnects);
+    printf("bytes_sent       %u\n", (unsigned)pStats->nBytesSent);
+    printf("reports_rcvd     %u\n", (unsigned)server.nReports);
+    printf("reports_skip     %u\n", (unsigned)server.nSkips);
+    printf("reports_dup      %u\n", (unsigned)server.nDups);
+    printf("reports_gap      %u\n", (unsigned)server.nGaps);
+    printf("acks             %u\n", (unsigned)server.nAcks);
+    printf("stats_frames     %u\n", (unsigned)server.nStats);
+    printf("bad_frames       %u\n", (unsigned)server.nBadFrames);
+    printf("mallocs          %u\n", (unsigned)pStats->nAllocs);
+    printf("malloc_bytes     %u\n", (unsigned)pStats->nAllocBytes);
+    printf("leaked_bytes     %u\n", (unsigned)pStats->nInUseBytes);
+    printf("file_writes      %u\n", (unsigned)pStats->nFileWrites);
+    printf("file_bytes       %u\n", (unsigned)pStats->nFileBytes);
+    printf("display_updates  %u\n", (unsigned)pStats->nDisplayUpdates);
+    if (dWall > 0) {
+        printf("fixes_per_s      %.0f\n", pStats->nGPSFixes * 1000.0 / dWall);
+    }
+    PosDetHost_PrintDelays(&server);
+
+    HostServer_Stop(&server);
+    HostReplay_Free(&replay);
+    HostRuntime_Term();
+    if (NULL == opt.pszRoot) {
+        (void)nftw(pszRoot, PosDetHost_RemoveEntry, 8, FTW_DEPTH | FTW_PHYS);
+    }
+
+    if (nMissing > 0 || 0 == server.nReports || server.nBadFrames > 0
+        || pStats->nInUseBytes > 0) {
+        fprintf(stderr, "posdethost: FAILED, %u fixes missing\n",
+                (unsigned)nMissing);
+        return 1;
+    }
+    /* A report the applet can't read back must still take its sequence
+     * number, or the server waits for it and the ACKs stop. */
+    if (server.nGaps > 0 || (opt.nCorrupt > 0 && 0 == server.nSkips)) {
+        fprintf(stderr, "posdethost: FAILED, %u gaps in the sequence, %u "
+                "unreadable reports skipped\n", (unsigned)server.nGaps,
+                (unsigned)server.nSkips);
+        return 1;
+    }
+    if (pStats->nGPSFixes < nDue || nUnanswered > 0) {
+        fprintf(stderr, "posdethost: FAILED, %u of %u fixes due, %u GPS "
+                "requests unanswered\n", (unsigned)pStats->nGPSFixes,
+                (unsigned)nDue, (unsigned)nUnanswered);
+        return 1;
+    }
+    return 0;
+}
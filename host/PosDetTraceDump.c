@@ -0,0 +1,184 @@
+/*=============================================================================
+  FILE: PosDetTraceDump.c
+
+  Prints a trace.bin written by PosDetTrace_Dump(), one event a line:
+
+    2012-08-07 23:58:04.120  uptime 41120  +20  conn_wait  server 0
+
+  The time of day is GMT, taken back from the time of the dump. Events this
+  build does not know are printed with their id and arguments.
+  ============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "PosDetCodec.h"
+#include "PosDetTrace.h"
+#include "RyanUtils.h"
+
+typedef struct _TraceEvent {
+    uint32      dwEvent;
+    const char *pszName;
+    const char *pszFormat;  // of arg 1 and arg 2, may use either or none
+    boolean     bSplit;     // arg 2 is PDT_SPLIT(), a third value follows
+} TraceEvent;
+
+static const TraceEvent s_events[] = {
+    { PDT_EV_GPS_REQ,         "gps_req",         "request %u, accuracy %u" },
+    { PDT_EV_GPS_REQ_FAIL,    "gps_req_fail",    "err %d" },
+    { PDT_EV_GPS_ERR,         "gps_err",         "status 0x%x, after %u ms" },
+    { PDT_EV_CONN_WAIT,       "conn_wait",       "server %u" },
+    { PDT_EV_CONN_TIMEDOUT,   "conn_timedout",   "server %u" },
+    { PDT_EV_CONN_REFUSED,    "conn_refused",    "server %u" },
+    { PDT_EV_CONN_ISCONN,     "conn_isconn",     "server %u" },
+    { PDT_EV_CONN_FATAL,      "conn_fatal",      "err 0x%x, server %u" },
+    { PDT_EV_CONN_INPROGRESS, "conn_inprogress", "server %u" },
+    { PDT_EV_CONN_ERR,        "conn_err",        "err 0x%x, server %u" },
+    { PDT_EV_CONNECTED,       "connected",       "server %u, after %u ms" },
+    { PDT_EV_IP_ERR,          "ip_err",          "err 0x%x" },
+    { PDT_EV_IP_ADDRS,        "ip_addrs",        "%u addresses" },
+    { PDT_EV_IP_NOMEM,        "ip_nomem",        "%u addresses" },
+    { PDT_EV_GPS_ADAPT,       "gps_adapt",
+      "timeout %u ms, retry %u ms, accuracy %u", TRUE },
+    { PDT_EV_NET_IP,          "net_ip",          "event %u" },
+    { PDT_EV_NET_STATE,       "net_state",       "event %u" },
+    { PDT_EV_NET_STATUS,      "net_status",      "status %u" },
+    { PDT_EV_CONN_BAD,        "conn_bad",        "server %u" },
+    { PDT_EV_CONN_NOW,        "conn_now",        "server %u" },
+    { PDT_EV_CONN_DEADLINE,   "conn_deadline",   "server %u" },
+    { PDT_EV_CONN_PRIMARY,    "conn_primary",    "from server %u" },
+    { PDT_EV_CONN_CLOSE,      "conn_close",      "err 0x%x, reopened %u" },
+    { PDT_EV_CONN_RETRY,      "conn_retry",
+      "in %u ms, failure %u, server %u", TRUE },
+    { PDT_EV_BIND_WAIT,       "bind_wait",       "port %u" },
+    { PDT_EV_BIND_ERR,        "bind_err",        "err 0x%x, port %u" },
+    { PDT_EV_GPS_TIMEOUT,     "gps_timeout",     "after %u ms" },
+    { PDT_EV_SOCK_WRITE_ERR,  "sock_write_err",  "err 0x%x, %u bytes sent" },
+    { PDT_EV_SOCK_READ_ERR,   "sock_read_err",   "err 0x%x" },
+    { PDT_EV_SOCK_CLOSED,     "sock_closed",     "server %u" },
+    { PDT_EV_ACK_TIMEOUT,     "ack_timeout",
+      "%u reports, %u datagrams lost" },
+    { PDT_EV_UDP_FALLBACK,    "udp_fallback",    "%u datagrams lost" }
+};
+
+static uint32
+GetU16(const byte *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8);
+}
+
+static uint32
+GetU32(const byte *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16)
+        | ((uint32)p[3] << 24);
+}
+
+static const TraceEvent *
+PosDetTraceDump_Find(uint32 dwEvent)
+{
+    int i;
+
+    for (i = 0; i < (int)ARRAYSIZE(s_events); i++) {
+        if (s_events[i].dwEvent == dwEvent) {
+            return &s_events[i];
+        }
+    }
+    return NULL;
+}
+
+/* "YYYY-MM-DD HH:MM:SS.mmm" of dMs, GPS ms, GMT. */
+static void
+PosDetTraceDump_Date(double dMs, char *pszBuf, size_t nSize)
+{
+    time_t t = (time_t)(dMs / 1000) + PDC_GPS_TO_UNIX_SECS;
+    struct tm tm;
+    size_t n;
+
+    gmtime_r(&t, &tm);
+    n = strftime(pszBuf, nSize, "%Y-%m-%d %H:%M:%S", &tm);
+    (void)snprintf(pszBuf + n, nSize - n, ".%03d",
+                   (int)(dMs - (double)(t - PDC_GPS_TO_UNIX_SECS) * 1000));
+}
+
+int
+main(int argc, char **argv)
+{
+    byte hdr[PDT_HDR_SIZE];
+    byte rec[PDT_RECORD_SIZE];
+    const TraceEvent *pe = NULL;
+    char szDate[32];
+    char szText[128];
+    FILE *pf = NULL;
+    uint32 nRecs, nLost, dwDumpTime, dwDumpSecs, nRecSize;
+    uint32 dwTime, dwEvent, dwArg1, dwArg2;
+    uint32 dwArg3 = 0;
+    uint32 dwPrev = 0;
+    uint32 i;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: posdettrace trace.bin\n");
+        return 2;
+    }
+    pf = fopen(argv[1], "rb");
+    if (NULL == pf) {
+        perror(argv[1]);
+        return 2;
+    }
+    if (fread(hdr, sizeof(hdr), 1, pf) != 1
+        || MEMCMP(hdr, "PDTR", 4) != 0 || GetU16(hdr + 4) != PDT_VERSION) {
+        fprintf(stderr, "posdettrace: %s is not a trace of version %d\n",
+                argv[1], PDT_VERSION);
+        return 2;
+    }
+    nRecSize = GetU16(hdr + 6);
+    nRecs = GetU32(hdr + 8);
+    nLost = GetU32(hdr + 12);
+    dwDumpTime = GetU32(hdr + 16);
+    dwDumpSecs = GetU32(hdr + 20);
+    if (nRecSize < PDT_RECORD_SIZE) {
+        fprintf(stderr, "posdettrace: records of %u bytes\n",
+                (unsigned)nRecSize);
+        return 2;
+    }
+
+    printf("# %u events, %u before them lost, dumped at uptime %u\n",
+           (unsigned)nRecs, (unsigned)nLost, (unsigned)dwDumpTime);
+    for (i = 0; i < nRecs; i++) {
+        if (fread(rec, PDT_RECORD_SIZE, 1, pf) != 1
+            || fseek(pf, nRecSize - PDT_RECORD_SIZE, SEEK_CUR) != 0) {
+            fprintf(stderr, "posdettrace: %s ends after %u events\n",
+                    argv[1], (unsigned)i);
+            return 1;
+        }
+        dwTime = GetU32(rec);
+        dwEvent = GetU32(rec + 4);
+        dwArg1 = GetU32(rec + 8);
+        dwArg2 = GetU32(rec + 12);
+
+        PosDetTraceDump_Date(dwDumpSecs * 1000.0
+                             - (double)(dwDumpTime - dwTime),
+                             szDate, sizeof(szDate));
+        pe = PosDetTraceDump_Find(dwEvent);
+        if (pe) {
+            if (pe->bSplit) {
+                dwArg3 = dwArg2 >> 24;
+                dwArg2 &= 0xFFFFFF;
+            }
+            (void)snprintf(szText, sizeof(szText), pe->pszFormat,
+                           (unsigned)dwArg1, (unsigned)dwArg2,
+                           (unsigned)dwArg3);
+            printf("%s  uptime %u  +%u  %s  %s\n", szDate, (unsigned)dwTime,
+                   (unsigned)(i > 0 ? dwTime - dwPrev : 0), pe->pszName,
+                   szText);
+        }
+        else {
+            printf("%s  uptime %u  +%u  event_%u  %u %u\n", szDate,
+                   (unsigned)dwTime, (unsigned)(i > 0 ? dwTime - dwPrev : 0),
+                   (unsigned)dwEvent, (unsigned)dwArg1, (unsigned)dwArg2);
+        }
+        dwPrev = dwTime;
+    }
+    fclose(pf);
+    return 0;
+}
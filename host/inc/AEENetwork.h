@@ -0,0 +1,2 @@
+/* Host build: see brewshim.h. */
+#include "brewshim.h"
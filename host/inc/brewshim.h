@@ -0,0 +1,617 @@
+/*=============================================================================
+  FILE: brewshim.h
+
+  Host-side stand-ins for the subset of the BREW MP SDK used by PosDetApp.
+  Every AEE header the applet includes resolves to this file when building
+  for Linux, so that PosDetApp.c compiles unmodified against plain libc.
+  ============================================================================*/
+#ifndef BREWSHIM_H
+#define BREWSHIM_H
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/*-----------------------------------------------------------------------------
+  AEEStdDef.h / AEEError.h
+  ----------------------------------------------------------------------------*/
+typedef uint8_t   uint8;
+typedef uint16_t  uint16;
+typedef uint32_t  uint32;
+typedef uint64_t  uint64;
+typedef int8_t    int8;
+typedef int16_t   int16;
+typedef int32_t   int32;
+typedef int64_t   int64;
+typedef uint8_t   byte;
+typedef uint8     boolean;
+typedef uint16    AECHAR;
+typedef uint32    AEECLSID;
+typedef uint32    AEEEvent;
+typedef int       AEEFont;
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+#define MAX_UINT32          0xFFFFFFFFu
+#define MAX_UINT16          0xFFFF
+#define FPOS(type, field)   offsetof(type, field)
+#define FSIZ(type, field)   sizeof(((type*)0)->field)
+
+#define SUCCESS             0
+#define EFAILED             1
+#define ENOMEMORY           2
+#define EBADCLASS           10
+#define EBADSTATE           13
+#define EBADPARM            14
+#define EUNSUPPORTED        20
+#define EPRIVLEVEL          21
+#ifndef EALREADY                /* the host runtime takes errno's */
+#define EALREADY            26
+#endif
+#define ENEEDMORE           35
+#define EFILEEXISTS         0x100
+#define EFILENOEXISTS       0x101
+#define EFILEEOF            0x10A
+#define AEE_SUCCESS         SUCCESS
+#define AEE_EFAILED         EFAILED
+
+#ifndef MIN
+#define MIN(a, b)           ((a) < (b) ? (a) : (b))
+#define MAX(a, b)           ((a) > (b) ? (a) : (b))
+#endif
+
+/*-----------------------------------------------------------------------------
+  AEEStdLib.h
+  ----------------------------------------------------------------------------*/
+void  *HostShim_Malloc(uint32 dwSize);
+void   HostShim_Free(void *p);
+uint32 HostShim_GetUpTimeMS(void);
+uint32 HostShim_GetTimeSeconds(void);
+void   HostShim_GetRand(byte *pDest, int nSize);
+void   HostShim_DbgPrintf(const char *szFormat, ...);
+
+#define MALLOC(n)           HostShim_Malloc((uint32)(n))
+#define FREE(p)             HostShim_Free(p)
+#define FREEIF(p)           do { if (p) { HostShim_Free((void*)(p)); \
+                                          (p) = NULL; } } while (0)
+#define MEMSET              memset
+#define MEMCPY              memcpy
+#define MEMMOVE             memmove
+#define MEMCMP              memcmp
+#define ZEROAT(p)           memset((p), 0, sizeof(*(p)))
+#define STRLEN(s)           ((int)strlen(s))
+#define STRCPY              strcpy
+#define STRCMP              strcmp
+#define STRNCMP             strncmp
+#define STRCHR              strchr
+#define STRSTR              strstr
+#define STRLCPY(d, s, n)    HostShim_Strlcpy((d), (s), (n))
+#define STRTOUL(s, pp, b)   strtoul((s), (pp), (b))
+#define ATOI                atoi
+#define SNPRINTF            snprintf
+#define VSNPRINTF           vsnprintf
+#define DBGPRINTF           HostShim_DbgPrintf
+#define GETUPTIMEMS()       HostShim_GetUpTimeMS()
+#define GETTIMESECONDS()    HostShim_GetTimeSeconds()
+#define GETRAND(p, n)       HostShim_GetRand((byte*)(p), (n))
+
+int HostShim_Strlcpy(char *pDst, const char *pSrc, int nSize);
+
+/* Floating point helpers. The target toolchains forbid bare double
+ * arithmetic in applets, so the applet goes through these macros. */
+#define FADD(a, b)          ((double)(a) + (double)(b))
+#define FSUB(a, b)          ((double)(a) - (double)(b))
+#define FMUL(a, b)          ((double)(a) * (double)(b))
+#define FDIV(a, b)          ((double)(a) / (double)(b))
+#define FABS(a)             fabs((double)(a))
+#define FSQRT(a)            sqrt((double)(a))
+#define FFLOOR(a)           floor((double)(a))
+#define FCEIL(a)            ceil((double)(a))
+#define FCMP_L(a, b)        ((double)(a) < (double)(b))
+#define FCMP_LE(a, b)       ((double)(a) <= (double)(b))
+#define FCMP_G(a, b)        ((double)(a) > (double)(b))
+#define FCMP_GE(a, b)       ((double)(a) >= (double)(b))
+#define FCMP_E(a, b)        ((double)(a) == (double)(b))
+#define FLTTOINT(a)         ((int32)(double)(a))
+#define FASSIGN_INT(n)      ((double)(n))
+
+boolean HostShim_FloatToWStr(double v, AECHAR *pszDest, int nSize);
+AECHAR *HostShim_StrToWStr(const char *pszIn, AECHAR *pDest, int nSize);
+char   *HostShim_WStrToStr(const AECHAR *pIn, char *pszDest, int nSize);
+
+#define FLOATTOWSTR(v, p, n)    HostShim_FloatToWStr((v), (p), (n))
+#define STR_TO_WSTR(s, p, n)    HostShim_StrToWStr((s), (p), (n))
+#define WSTR_TO_STR(w, p, n)    HostShim_WStrToStr((w), (p), (n))
+
+typedef struct {
+    uint16 wYear;
+    uint16 wMonth;
+    uint16 wDay;
+    uint16 wHour;
+    uint16 wMinute;
+    uint16 wSecond;
+    uint16 wWeekDay;
+} JulianType;
+
+void HostShim_GetJulianDate(uint32 dwSecs, JulianType *pDate);
+#define GETJULIANDATE(s, p)     HostShim_GetJulianDate((s), (p))
+
+/*-----------------------------------------------------------------------------
+  AEE.h: callbacks, interfaces, classes, events
+  ----------------------------------------------------------------------------*/
+typedef void (*PFNNOTIFY)(void *pData);
+struct _AEECallback;
+typedef void (*PFNCBCANCEL)(struct _AEECallback *pcb);
+
+typedef struct _AEECallback {
+    struct _AEECallback *pNext;
+    void                *pmc;
+    PFNCBCANCEL          pfnCancel;
+    void                *pCancelData;
+    PFNNOTIFY            pfnNotify;
+    void                *pNotifyData;
+    void                *pReserved;
+} AEECallback;
+
+#define CALLBACK_Init(pcb, pfn, pv) \
+    do { (pcb)->pfnNotify = (PFNNOTIFY)(pfn); \
+         (pcb)->pNotifyData = (pv); } while (0)
+#define CALLBACK_Cancel(pcb) \
+    do { if ((pcb)->pfnCancel) (pcb)->pfnCancel(pcb); } while (0)
+#define CALLBACK_IsQueued(pcb)  ((pcb)->pfnCancel != NULL)
+
+#define AEECLSID_SHELL          0x01001001
+#define AEECLSID_POSDET         0x01001002
+#define AEECLSID_FILEMGR        0x01001003
+#define AEECLSID_SockPort       0x01001004
+#define AEECLSID_Network        0x01001005
+
+#define EVT_APP_START               0x0000
+#define EVT_APP_STOP                0x0001
+#define EVT_APP_SUSPEND             0x0002
+#define EVT_APP_RESUME              0x0003
+#define EVT_APP_CONFIG              0x0004
+#define EVT_APP_HIDDEN_CONFIG       0x0005
+#define EVT_APP_BROWSE_URL          0x0006
+#define EVT_APP_BROWSE_FILE         0x0007
+#define EVT_APP_MESSAGE             0x0008
+#define EVT_APP_START_BACKGROUND    0x000E
+#define EVT_KEY                     0x0100
+#define EVT_FLIP                    0x0501
+#define EVT_KEYGUARD                0x0502
+#define EVT_NOTIFY                  0x0700
+
+#define NMASK_SHELL_INIT            0x0001
+
+typedef struct {
+    AEECLSID  cls;
+    void     *pcxt;
+    uint32    dwMask;
+    void     *pData;
+    int       st;
+} AEENotify;
+
+typedef struct {
+    uint16 wStructSize;
+    uint16 cxScreen;
+    uint16 cyScreen;
+    uint16 cxAltScreen;
+    uint16 cyAltScreen;
+    uint16 cxScrollBar;
+    uint16 wEncoding;
+    uint16 wMenuTextScroll;
+    uint16 nColorDepth;
+    uint16 wMenuImageDelay;
+    uint32 dwRAM;
+} AEEDeviceInfo;
+
+typedef struct {
+    int16 x, y, dx, dy;
+} AEERect;
+
+/* Every interface is an opaque host object. */
+typedef struct IShell    IShell;
+typedef struct IModule   IModule;
+typedef struct IApplet   IApplet;
+typedef struct IDisplay  IDisplay;
+typedef struct IPosDet   IPosDet;
+typedef struct IFileMgr  IFileMgr;
+typedef struct IFile     IFile;
+typedef struct ISockPort ISockPort;
+typedef struct INetwork  INetwork;
+
+typedef void (*PFNTIMER)(void *pUser);
+
+int     HostShell_CreateInstance(IShell *p, AEECLSID cls, void **ppo);
+void    HostShell_GetDeviceInfo(IShell *p, AEEDeviceInfo *pdi);
+int     HostShell_SetTimer(IShell *p, int32 dwMSecs, PFNTIMER pfn,
+                           void *pUser);
+int     HostShell_SetTimerEx(IShell *p, int32 dwMSecs, AEECallback *pcb);
+int     HostShell_CancelTimer(IShell *p, PFNTIMER pfn, void *pUser);
+void    HostShell_Resume(IShell *p, AEECallback *pcb);
+int     HostShell_CloseApplet(IShell *p, boolean bReturnToIdle);
+int     HostShell_StartBackgroundApplet(IShell *p, AEECLSID cls,
+                                        const char *pszArgs);
+
+#define ISHELL_CreateInstance(p, c, pp)     HostShell_CreateInstance((p), (c), (pp))
+#define ISHELL_GetDeviceInfo(p, pdi)        HostShell_GetDeviceInfo((p), (pdi))
+#define ISHELL_SetTimer(p, ms, pfn, pu)     HostShell_SetTimer((p), (ms), (PFNTIMER)(pfn), (pu))
+#define ISHELL_SetTimerEx(p, ms, pcb)       HostShell_SetTimerEx((p), (ms), (pcb))
+#define ISHELL_CancelTimer(p, pfn, pu)      HostShell_CancelTimer((p), (PFNTIMER)(pfn), (pu))
+#define ISHELL_Resume(p, pcb)               HostShell_Resume((p), (pcb))
+#define ISHELL_CloseApplet(p, b)            HostShell_CloseApplet((p), (b))
+#define ISHELL_StartBackgroundApplet(p, c, a) \
+    HostShell_StartBackgroundApplet((p), (c), (a))
+
+uint32 HostShim_Release(void *po);
+#define IQI_RELEASEIF(p)    do { if (p) { (void)HostShim_Release(p); \
+                                          (p) = NULL; } } while (0)
+
+/*-----------------------------------------------------------------------------
+  AEEAppGen.h / AEEModGen.h
+  ----------------------------------------------------------------------------*/
+typedef boolean (*AEEHANDLER)(void *pData, AEEEvent evt, uint16 wParam,
+                              uint32 dwParam);
+typedef void (*PFNFREEAPPDATA)(void *pData);
+
+typedef struct _AEEApplet {
+    IApplet       *pvt;
+    uint32         m_nRefs;
+    AEECLSID       clsID;
+    IShell        *m_pIShell;
+    IModule       *m_pIModule;
+    IDisplay      *m_pIDisplay;
+    AEEHANDLER     pAppHandleEvent;
+    PFNFREEAPPDATA pFreeAppData;
+} AEEApplet;
+
+boolean AEEApplet_New(int16 nIn, AEECLSID clsID, IShell *pIShell,
+                      IModule *pIModule, IApplet **ppobj,
+                      AEEHANDLER pAppHandleEvent,
+                      PFNFREEAPPDATA pFreeAppData);
+uint32  HostApplet_Release(IApplet *p);
+#define IAPPLET_Release(p)  HostApplet_Release(p)
+
+int AEEClsCreateInstance(AEECLSID ClsId, IShell *pIShell, IModule *po,
+                         void **ppObj);
+
+/*-----------------------------------------------------------------------------
+  AEEDisp.h
+  ----------------------------------------------------------------------------*/
+#define AEE_FONT_NORMAL     0x8001
+#define AEE_FONT_BOLD       0x8002
+#define AEE_FONT_LARGE      0x8003
+
+#define IDF_ALIGN_NONE      0x00000000
+#define IDF_ALIGN_LEFT      0x00000001
+#define IDF_ALIGN_RIGHT     0x00000002
+#define IDF_ALIGN_CENTER    0x00000004
+#define IDF_ALIGN_TOP       0x00000010
+#define IDF_ALIGN_BOTTOM    0x00000020
+#define IDF_ALIGN_MIDDLE    0x00000040
+#define IDF_ALIGNVERT_MASK  0x00000070
+#define IDF_RECT_FILL       0x00000400
+#define IDF_TEXT_TRANSPARENT 0x00001000
+
+int  HostDisplay_DrawText(IDisplay *p, AEEFont fnt, const AECHAR *pcText,
+                          int nChars, int x, int y, const AEERect *prc,
+                          uint32 dwFlags);
+void HostDisplay_ClearScreen(IDisplay *p);
+void HostDisplay_EraseRect(IDisplay *p, const AEERect *prc);
+void HostDisplay_Update(IDisplay *p);
+
+#define IDISPLAY_DrawText(p, f, t, n, x, y, r, fl) \
+    HostDisplay_DrawText((p), (f), (t), (n), (x), (y), (r), (fl))
+#define IDISPLAY_ClearScreen(p)     HostDisplay_ClearScreen(p)
+#define IDISPLAY_EraseRect(p, r)    HostDisplay_EraseRect((p), (r))
+#define IDISPLAY_Update(p)          HostDisplay_Update(p)
+
+/*-----------------------------------------------------------------------------
+  AEEFile.h
+  ----------------------------------------------------------------------------*/
+typedef enum {
+    _OFM_READ      = 0x0001,
+    _OFM_READWRITE = 0x0002,
+    _OFM_CREATE    = 0x0004,
+    _OFM_APPEND    = 0x0008
+} OpenFileMode;
+
+typedef enum {
+    _SEEK_START,
+    _SEEK_END,
+    _SEEK_CURRENT
+} FileSeekType;
+
+typedef struct {
+    char   attrib;
+    uint32 dwCreationDate;
+    uint32 dwSize;
+    char   szName[64];
+} AEEFileInfo;
+
+IFile *HostFileMgr_OpenFile(IFileMgr *p, const char *pszFile,
+                            OpenFileMode mode);
+int    HostFileMgr_Test(IFileMgr *p, const char *pszFile);
+int    HostFileMgr_Remove(IFileMgr *p, const char *pszFile);
+int    HostFileMgr_Rename(IFileMgr *p, const char *pszSrc,
+                          const char *pszDst);
+int    HostFileMgr_GetLastError(IFileMgr *p);
+int32  HostFile_Read(IFile *p, void *pDest, uint32 nWant);
+uint32 HostFile_Write(IFile *p, const void *pSrc, uint32 nBytes);
+int    HostFile_Seek(IFile *p, FileSeekType seek, int32 pos);
+int    HostFile_GetInfo(IFile *p, AEEFileInfo *pInfo);
+int    HostFile_Truncate(IFile *p, uint32 nPos);
+
+#define IFILEMGR_OpenFile(p, f, m)      HostFileMgr_OpenFile((p), (f), (m))
+#define IFILEMGR_Test(p, f)             HostFileMgr_Test((p), (f))
+#define IFILEMGR_Remove(p, f)           HostFileMgr_Remove((p), (f))
+#define IFILEMGR_Rename(p, s, d)        HostFileMgr_Rename((p), (s), (d))
+#define IFILEMGR_GetLastError(p)        HostFileMgr_GetLastError(p)
+#define IFILEMGR_Release(p)             HostShim_Release(p)
+#define IFILE_Read(p, b, n)             HostFile_Read((p), (b), (n))
+#define IFILE_Write(p, b, n)            HostFile_Write((p), (b), (n))
+#define IFILE_Seek(p, s, o)             HostFile_Seek((p), (s), (o))
+#define IFILE_GetInfo(p, i)             HostFile_GetInfo((p), (i))
+#define IFILE_Truncate(p, n)            HostFile_Truncate((p), (n))
+#define IFILE_Release(p)                HostShim_Release(p)
+
+/*-----------------------------------------------------------------------------
+  AEEPosDet.h
+  ----------------------------------------------------------------------------*/
+typedef uint8  AEEGPSMode;
+typedef uint16 AEEGPSOpt;
+typedef uint8  AEEGPSQos;
+typedef uint32 AEEGPSSvrType;
+typedef uint32 AEEGPSReq;
+typedef uint32 AEEGPSAccuracy;
+
+#define AEEGPS_MODE_ONE_SHOT            1
+#define AEEGPS_MODE_DLOAD_FIRST         2
+#define AEEGPS_MODE_TRACK_LOCAL         4
+#define AEEGPS_MODE_TRACK_NETWORK       8
+#define AEEGPS_MODE_TRACK_OPTIMAL       9
+#define AEEGPS_MODE_TRACK_STANDALONE    10
+
+#define AEEGPS_OPT_NONE                 0
+#define AEEGPS_OPT_SPEED                1
+#define AEEGPS_OPT_ACCURACY             2
+#define AEEGPS_OPT_PAYLOAD              3
+#define AEEGPS_OPT_DEFAULT              AEEGPS_OPT_SPEED
+
+#define AEEGPS_SERVER_DEFAULT           0
+#define AEEGPS_SERVER_IP                1
+#define AEEGPS_SERVER_DBURST            2
+
+#define AEEGPS_GETINFO_LOCATION         0x0001
+#define AEEGPS_GETINFO_ALTITUDE         0x0002
+#define AEEGPS_GETINFO_VELOCITY         0x0004
+
+#define AEEGPS_ACCURACY_LEVEL1          1
+#define AEEGPS_ACCURACY_LEVEL2          2
+#define AEEGPS_ACCURACY_LEVEL3          3
+#define AEEGPS_ACCURACY_LEVEL4          4
+#define AEEGPS_ACCURACY_LEVEL5          5
+#define AEEGPS_ACCURACY_LEVEL6          6
+
+#define AEEGPS_ERR_NO_ERR               0
+#define AEEGPS_ERR_BASE                 0x0200
+#define AEEGPS_ERR_GENERAL_FAILURE      (AEEGPS_ERR_BASE + 1)
+#define AEEGPS_ERR_TIMEOUT              (AEEGPS_ERR_BASE + 2)
+#define AEEGPS_ERR_ACCURACY_UNAVAIL     (AEEGPS_ERR_BASE + 3)
+#define AEEGPS_ERR_INFO_UNAVAIL         (AEEGPS_ERR_BASE + 4)
+#define AEEGPS_ERR_PRIVACY_REFUSED      (AEEGPS_ERR_BASE + 5)
+#define AEEGPS_ERR_SRV_UNREACHABLE      (AEEGPS_ERR_BASE + 6)
+#define AEEGPS_ERR_LINK_FAILED          (AEEGPS_ERR_BASE + 7)
+#define AEEGPS_ERR_REJECTED             (AEEGPS_ERR_BASE + 8)
+#define AEEGPS_ERR_OUTOF_RESOURCES      (AEEGPS_ERR_BASE + 9)
+#define AEEGPS_ERR_RECEIVER_BUSY        (AEEGPS_ERR_BASE + 10)
+#define AEEGPS_ERR_STALE_BS_INFO        (AEEGPS_ERR_BASE + 11)
+
+#define AEEGPS_VALID_LAT                0x0001
+#define AEEGPS_VALID_LON                0x0002
+#define AEEGPS_VALID_ALT                0x0004
+#define AEEGPS_VALID_HEAD               0x0008
+#define AEEGPS_VALID_HVEL               0x0010
+#define AEEGPS_VALID_VVEL               0x0020
+#define AEEGPS_VALID_HUNC               0x0040
+
+typedef uint32 INAddr;
+typedef uint16 INPort;
+
+typedef struct {
+    INAddr addr;
+    INPort port;
+} AEEGPSIPSvr;
+
+typedef struct {
+    AEEGPSSvrType svrType;
+    union {
+        AEEGPSIPSvr ipsvr;
+    } svr;
+} AEEGPSServer;
+
+typedef struct {
+    AEEGPSMode   mode;
+    uint16       nFixes;
+    uint16       nInterval;
+    AEEGPSOpt    optim;
+    AEEGPSQos    qos;
+    AEEGPSServer server;
+} AEEGPSConfig;
+
+typedef struct {
+    uint32  dwTimeStamp;     /* seconds since 1980-01-06 00:00:00 GMT */
+    uint32  status;
+    int32   dwLat;
+    int32   dwLon;
+    int16   wAltitude;
+    uint16  wHeading;
+    uint16  wVelocityHor;
+    int8    bVelocityVer;
+    uint8   accuracy;
+    uint16  fValid;
+    uint8   bHorUnc;
+    uint8   bHorUncAngle;
+    uint8   bHorUncPerp;
+    uint8   bVerUnc;
+    uint32  method;
+} AEEGPSInfo;
+
+typedef struct {
+    uint32  dwSize;
+    boolean fLatitude;
+    double  Latitude;
+    boolean fLongitude;
+    double  Longitude;
+    boolean fAltitude;
+    int32   nAltitude;
+    boolean fHeading;
+    double  Heading;
+    boolean fHorVelocity;
+    double  HorVelocity;
+    boolean fVerVelocity;
+    double  VerVelocity;
+    boolean fHorUnc;
+    double  HorUnc;
+} AEEPositionInfoEx;
+
+int HostPosDet_GetGPSConfig(IPosDet *p, AEEGPSConfig *pc);
+int HostPosDet_SetGPSConfig(IPosDet *p, AEEGPSConfig *pc);
+int HostPosDet_GetGPSInfo(IPosDet *p, AEEGPSReq req, AEEGPSAccuracy acc,
+                          AEEGPSInfo *pgi, AEECallback *pcb);
+int HostPosDet_ExtractPositionInfo(IPosDet *p, AEEGPSInfo *pgi,
+                                   AEEPositionInfoEx *ppie);
+
+#define IPOSDET_GetGPSConfig(p, c)          HostPosDet_GetGPSConfig((p), (c))
+#define IPOSDET_SetGPSConfig(p, c)          HostPosDet_SetGPSConfig((p), (c))
+#define IPOSDET_GetGPSInfo(p, r, a, i, cb)  HostPosDet_GetGPSInfo((p), (r), (a), (i), (cb))
+#define IPOSDET_ExtractPositionInfo(p, i, x) \
+    HostPosDet_ExtractPositionInfo((p), (i), (x))
+
+/*-----------------------------------------------------------------------------
+  AEENet.h / AEESockPort.h / AEENetwork.h
+  ----------------------------------------------------------------------------*/
+#define AEE_AF_INET             2
+#define AEE_INADDR_ANY          0
+#define AEE_INET_ADDRSTRLEN     16
+#define AEE_SOCKPORT_STREAM     1
+#define AEE_SOCKPORT_DGRAM      2
+
+#define AEEPORT_CLOSED          0
+#define AEEPORT_ERROR           (-1)
+#define AEEPORT_WAIT            (-2)
+
+#define AEE_NET_SUCCESS         0
+#define AEE_NET_ERROR           (-1)
+#define AEE_NET_EBADF           0x202
+#define AEE_NET_EAFNOSUPPORT    0x204
+#define AEE_NET_EWOULDBLOCK     0x206
+#define AEE_NET_EINPROGRESS     0x208
+#define AEE_NET_EISCONN         0x20A
+#define AEE_NET_ECONNREFUSED    0x20B
+#define AEE_NET_ETIMEDOUT       0x20C
+#define AEE_NET_ECONNRESET      0x20D
+#define AEE_NET_ENOTCONN        0x20E
+#define AEE_NET_EOPNOTSUPP      0x210
+#define AEE_NET_ENOMEM          0x212
+
+typedef struct {
+    uint16 wFamily;
+    INPort port;
+    INAddr addr;
+} AEESockAddrInet;
+
+typedef union {
+    uint16          wFamily;
+    AEESockAddrInet inet;
+    uint8           raw[28];
+} AEESockAddrStorage;
+
+typedef struct {
+    uint16 wFamily;
+    union {
+        INAddr v4;
+        uint8  v6[16];
+    } addr;
+} IPAddr;
+
+uint16 HostShim_htons(uint16 w);
+#define AEE_htons(w)    HostShim_htons(w)
+#define AEE_ntohs(w)    HostShim_htons(w)
+#define HTONS(w)        HostShim_htons(w)
+#define NTOHS(w)        HostShim_htons(w)
+
+boolean HostShim_InetPton(int af, const char *src, void *dst);
+const char *HostShim_InetNtop(int af, const void *src, char *dst, int size);
+#define INET_PTON(af, s, d)         HostShim_InetPton((af), (s), (d))
+#define INET_NTOP(af, s, d, n)      HostShim_InetNtop((af), (s), (d), (n))
+
+typedef void (*PFNNOTIFYEX)(void *pData);
+
+int   HostSock_OpenEx(ISockPort *p, uint16 wFamily, int nType, int nProto);
+int   HostSock_Connect(ISockPort *p, const AEESockAddrStorage *pAddr);
+int   HostSock_Bind(ISockPort *p, const AEESockAddrStorage *pAddr);
+int32 HostSock_Write(ISockPort *p, const char *pcBuf, int32 cbBuf);
+int32 HostSock_Read(ISockPort *p, char *pcBuf, int32 cbBuf);
+void  HostSock_Writeable(ISockPort *p, AEECallback *pcb);
+void  HostSock_Readable(ISockPort *p, AEECallback *pcb);
+int   HostSock_GetLastError(ISockPort *p);
+int   HostSock_Close(ISockPort *p);
+
+#define ISockPort_OpenEx(p, f, t, pr)   HostSock_OpenEx((p), (f), (t), (pr))
+#define ISockPort_Connect(p, a)         HostSock_Connect((p), (a))
+#define ISockPort_Bind(p, a)            HostSock_Bind((p), (a))
+#define ISockPort_Write(p, b, n)        HostSock_Write((p), (const char*)(b), (n))
+#define ISockPort_Read(p, b, n)         HostSock_Read((p), (char*)(b), (n))
+#define ISockPort_Writeable(p, cb)      HostSock_Writeable((p), (cb))
+#define ISockPort_Readable(p, cb)       HostSock_Readable((p), (cb))
+#define ISockPort_WriteableEx(p, cb, pfn, pv) \
+    do { CALLBACK_Cancel(cb); CALLBACK_Init((cb), (pfn), (pv)); \
+         HostSock_Writeable((p), (cb)); } while (0)
+#define ISockPort_ReadableEx(p, cb, pfn, pv) \
+    do { CALLBACK_Cancel(cb); CALLBACK_Init((cb), (pfn), (pv)); \
+         HostSock_Readable((p), (cb)); } while (0)
+#define ISockPort_GetLastError(p)       HostSock_GetLastError(p)
+#define ISockPort_Close(p)              HostSock_Close(p)
+#define ISockPort_Release(p)            HostShim_Release(p)
+
+typedef int AEENetStatus;
+typedef struct {
+    uint32 dwOpenTime;
+    uint32 dwActiveOpenTime;
+    uint32 uBytesSent;
+    uint32 uBytesRcvd;
+} AEENetStats;
+
+#define AEE_NET_STATUS_INVALID_STATE    0
+#define AEE_NET_STATUS_OPENING          1
+#define AEE_NET_STATUS_OPEN             2
+#define AEE_NET_STATUS_CLOSING          3
+#define AEE_NET_STATUS_CLOSED           4
+#define AEE_NET_STATUS_SLEEPING         5
+#define AEE_NET_STATUS_ASLEEP           6
+#define AEE_NET_STATUS_WAKING           7
+
+#define NETWORK_EVENT_STATE     1
+#define NETWORK_EVENT_IP        2
+
+typedef void (*PFNNETWORKEVENT)(void *pHandlerData, int nEvent);
+
+int HostNet_OnEvent(INetwork *p, int nEvent, PFNNETWORKEVENT pfn,
+                    void *pHandlerData, boolean bRegister);
+int HostNet_GetMyIPAddrs(INetwork *p, IPAddr *pAddrs, int *pnAddrs);
+int HostNet_NetStatus(INetwork *p, AEENetStatus *pStatus,
+                      AEENetStats *pStats);
+
+#define INetwork_OnEvent(p, e, f, d, b)     HostNet_OnEvent((p), (e), (f), (d), (b))
+#define INetwork_GetMyIPAddrs(p, a, n)      HostNet_GetMyIPAddrs((p), (a), (n))
+#define INetwork_NetStatus(p, s, st)        HostNet_NetStatus((p), (s), (st))
+
+#endif /* BREWSHIM_H */
@@ -20,7 +20,17 @@ BUILD_BREWMODS = posdetapp
 posdetapp_C_SRCS = AEEAppGen \
 	AEEModGen \
 	PosDetApp \
-	RyanUtils
+	RyanUtils \
+	PosDetQueue \
+	PosDetCodec \
+	PosDetSimplify \
+	PosDetLog \
+	PosDetBackoff \
+	PosDetServers \
+	PosDetLatency \
+	PosDetView \
+	PosDetStats \
+	PosDetTrace
 
 # specifies the cif files to be compiled
 posdetapp_CIFS = posdetapp